@@ -0,0 +1,389 @@
+/*
+Benchmark suite run by `make bench`: the strings.c primitives at several input sizes,
+the transform_* geometry functions, loading preset scripts, end to end preset renders,
+the size and cost of the output forms and the sustained frame rate of animations.
+Every case prints one JSON object per line, so that runs can be diffed or fed to a script.
+Allocations are counted by wrapping malloc(), calloc() and realloc() at link time
+(-Wl,--wrap=...), so this file must be linked the way the makefile does.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "../include/strings.h"
+#include "../include/geometry.h"
+#include "../include/presets.h"
+#include "../include/rng.h"
+#include "../include/script.h"
+#include "../include/utils.h"
+
+// a case is repeated until one round takes at least this long, the best of ROUNDS is reported.
+#define MIN_ROUND_NS 50e6
+#define ROUNDS 5
+#define OUT_PATH "target/bench.svg"
+#define OUT_SVGZ_PATH "target/bench.svgz"
+#define SCRIPT_PATH "assets/bubbles.wks"
+#define SCRIPT_CACHE "target/bench-cache"
+#define FRAMES_DIR "target/bench-frames"
+#define ANIMATION_FRAMES 120
+
+typedef void (*BenchOp)(void* arg);
+
+static uint64_t allocs;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+void* __wrap_malloc(size_t size) {
+    __atomic_add_fetch(&allocs, 1, __ATOMIC_RELAXED);
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    __atomic_add_fetch(&allocs, 1, __ATOMIC_RELAXED);
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    __atomic_add_fetch(&allocs, 1, __ATOMIC_RELAXED);
+    return __real_realloc(ptr, size);
+}
+
+static double now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+typedef struct Measure {
+    double ns_per_op;
+    uint64_t allocs_per_op; // counted over a single warm op.
+} Measure;
+
+static Measure measure(BenchOp op, void* arg) {
+    op(arg); // warm up caches, arenas and preset templates.
+
+    uint64_t before = __atomic_load_n(&allocs, __ATOMIC_RELAXED);
+    op(arg);
+    Measure m = {0, __atomic_load_n(&allocs, __ATOMIC_RELAXED) - before};
+
+    uint64_t iterations = 1;
+    double elapsed;
+    for (;;) {
+        elapsed = now_ns();
+        for (uint64_t i = 0; i < iterations; i++) op(arg);
+        elapsed = now_ns() - elapsed;
+        if (elapsed >= MIN_ROUND_NS) break;
+        iterations *= 2;
+    }
+
+    double best = elapsed;
+    for (int r = 1; r < ROUNDS; r++) {
+        elapsed = now_ns();
+        for (uint64_t i = 0; i < iterations; i++) op(arg);
+        elapsed = now_ns() - elapsed;
+        if (elapsed < best) best = elapsed;
+    }
+    m.ns_per_op = best / iterations;
+    return m;
+}
+
+// ### strings ###
+
+#define KEY STR_LIT("$theme")
+
+typedef struct StringCase {
+    String str;
+    uint64_t size;
+} StringCase;
+
+// Text of `size` bytes with KEY about every 64 bytes, like a preset template.
+static String make_text(Rng* rng, uint64_t size) {
+    String s = {malloc(size + 1), size};
+    for (uint64_t i = 0; i < size; i++) s.str[i] = 'a' + rng_next(rng) % 26;
+    for (uint64_t i = 0; i + KEY.length <= size; i += 56 + rng_next(rng) % 16) memcpy(s.str + i, KEY.str, KEY.length);
+    s.str[size] = '\0';
+    return s;
+}
+
+// Replacing the key by itself keeps the input the same for every op but does all the work.
+static void op_replace_all(void* arg) {
+    StringCase* c = arg;
+    str_replace_all(&c->str, KEY, KEY);
+}
+
+static void op_replace_next(void* arg) {
+    StringCase* c = arg;
+    for (int64_t at = 0; (at = str_replace_next(&c->str, at, KEY, KEY)) != -1;);
+}
+
+static void op_key_frequency(void* arg) {
+    StringCase* c = arg;
+    volatile uint64_t count = str_key_frequency(str_view(c->str), KEY);
+    (void)count;
+}
+
+static void op_compose(void* arg) {
+    StringCase* c = arg;
+    String s = str_compose("<svg width=\"%d\" height=\"%d\">%s</svg>", 1920, 1080, c->str.str);
+    str_release(&s);
+}
+
+static void bench_strings(Rng* rng) {
+    const uint64_t sizes[] = {1 << 10, 1 << 16, 1 << 20};
+    const struct {const char* name; BenchOp op;} cases[] = {
+        {"str_replace_all", op_replace_all},
+        {"str_replace_next", op_replace_next},
+        {"str_key_frequency", op_key_frequency},
+        {"str_compose", op_compose},
+    };
+
+    for (uint32_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+        StringCase c = {make_text(rng, sizes[k]), sizes[k]};
+        for (uint32_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+            Measure m = measure(cases[i].op, &c);
+            printf("{\"bench\":\"%s\",\"bytes\":%lu,\"ns_per_op\":%.1f,\"bytes_per_sec\":%.0f,\"allocs_per_op\":%lu}\n",
+                    cases[i].name, c.size, m.ns_per_op, c.size / m.ns_per_op * 1e9, m.allocs_per_op);
+        }
+        str_release(&c.str);
+    }
+}
+
+// ### geometry ###
+
+typedef struct GeometryCase {
+    int (*mats)[3][6];
+    float* angles;
+    ShapeBatch batch;
+    uint32_t count;
+    int8_t shrink; // transform_scale alternates between growing and shrinking to stay in range.
+} GeometryCase;
+
+static void op_centroid(void* arg) {
+    GeometryCase* c = arg;
+    volatile float sum = 0;
+    for (uint32_t s = 0; s < c->count; s++) sum += get_centroid(3, 6, c->mats[s]).x;
+}
+
+static void op_rotate(void* arg) {
+    GeometryCase* c = arg;
+    for (uint32_t s = 0; s < c->count; s++) transform_rotate(3, 6, c->mats[s], c->angles[s]);
+}
+
+static void op_scale(void* arg) {
+    GeometryCase* c = arg;
+    const double factor = c->shrink ? 0.8 : 1.25;
+    for (uint32_t s = 0; s < c->count; s++) transform_scale(3, 6, c->mats[s], factor);
+    c->shrink = !c->shrink;
+}
+
+static void op_batch_transform(void* arg) {
+    GeometryCase* c = arg;
+    geom_batch_transform(&c->batch);
+}
+
+static void bench_geometry(Rng* rng) {
+    const uint32_t sizes[] = {1000, 100000};
+    const struct {const char* name; BenchOp op;} cases[] = {
+        {"get_centroid", op_centroid},
+        {"transform_rotate", op_rotate},
+        {"transform_scale", op_scale},
+        {"geom_batch_transform", op_batch_transform},
+    };
+
+    for (uint32_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+        GeometryCase c = {malloc(sizes[k] * sizeof(*c.mats)), malloc(sizes[k] * sizeof(float)), {0}, sizes[k], 0};
+        geom_batch_init(&c.batch, 9, c.count);
+        for (uint32_t s = 0; s < c.count; s++) {
+            geom_batch_push(&c.batch);
+            for (int p = 0; p < 9; p++) {
+                c.mats[s][p / 3][(p % 3) * 2] = GEOM_X(&c.batch, s, p) = rand_range(rng, 0, 1920);
+                c.mats[s][p / 3][(p % 3) * 2 + 1] = GEOM_Y(&c.batch, s, p) = rand_range(rng, 0, 1080);
+            }
+            c.angles[s] = c.batch.angle[s] = rand_range(rng, 0, 360);
+        }
+
+        for (uint32_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+            Measure m = measure(cases[i].op, &c);
+            printf("{\"bench\":\"%s\",\"shapes\":%u,\"ns_per_op\":%.1f,\"ns_per_shape\":%.2f,\"shapes_per_sec\":%.0f,\"allocs_per_op\":%lu}\n",
+                    cases[i].name, c.count, m.ns_per_op, m.ns_per_op / c.count, c.count / m.ns_per_op * 1e9, m.allocs_per_op);
+        }
+        geom_batch_free(&c.batch);
+        free(c.angles);
+        free(c.mats);
+    }
+}
+
+// ### scripts ###
+
+// Both read the script; without a cache it is compiled, which is what a launch
+// pays the first time, with one the bytecode is read back, which is what later launches pay.
+static void op_script_uncached(void* arg) {
+    (void)arg;
+    Script s;
+    if (script_load(&s, SCRIPT_PATH, NULL) == 0) script_free(&s);
+}
+
+static void op_script_cached(void* arg) {
+    (void)arg;
+    Script s;
+    if (script_load(&s, SCRIPT_PATH, SCRIPT_CACHE) == 0) script_free(&s);
+}
+
+static void bench_scripts() {
+    String source = {0};
+    if (read_file_content(SCRIPT_PATH, &source) != 0) return;
+    const struct {const char* name; BenchOp op;} cases[] = {
+        {"script_load_uncached", op_script_uncached},
+        {"script_load_cached", op_script_cached}, // the warm up op fills the cache.
+    };
+    for (uint32_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        Measure m = measure(cases[i].op, NULL);
+        printf("{\"bench\":\"%s\",\"bytes\":%lu,\"ns_per_op\":%.1f,\"allocs_per_op\":%lu}\n",
+                cases[i].name, source.length, m.ns_per_op, m.allocs_per_op);
+    }
+    str_release(&source);
+}
+
+// ### renders ###
+
+typedef struct RenderCase {
+    PresetRender render;
+    RenderParams params;
+} RenderCase;
+
+static void op_render(void* arg) {
+    RenderCase* c = arg;
+    c->render(&c->params);
+}
+
+typedef struct SizesCase {
+    RenderParams params;
+    const RenderSize* sizes;
+    uint16_t count;
+} SizesCase;
+
+static void op_render_sizes(void* arg) {
+    SizesCase* c = arg;
+    triogons_sizes(&c->params, c->sizes, c->count);
+}
+
+// Size and shape count of what the last render wrote.
+static void inspect_output(uint64_t* bytes, uint64_t* shapes) {
+    String svg = {0};
+    *bytes = *shapes = 0;
+    if (read_file_content(OUT_PATH, &svg) != 0) return;
+    *bytes = svg.length;
+    *shapes = str_key_frequency(str_view(svg), STR_LIT("<path")) + str_key_frequency(str_view(svg), STR_LIT("<circle"));
+    str_release(&svg);
+}
+
+static void bench_render(const char* name, PresetRender render, const char* script, uint16_t width, uint16_t height, uint32_t density) {
+    RenderCase c = {render, {width, height, Lumos, 42, density, NULL, OUT_PATH, script}};
+    Measure m = measure(op_render, &c);
+
+    uint64_t bytes, shapes;
+    inspect_output(&bytes, &shapes);
+    printf("{\"bench\":\"%s\",\"width\":%u,\"height\":%u,\"density\":%u,\"ns_per_op\":%.0f,"
+            "\"shapes_per_sec\":%.0f,\"bytes_per_sec\":%.0f,\"output_bytes\":%lu,\"allocs_per_render\":%lu}\n",
+            name, width, height, density, m.ns_per_op,
+            shapes / m.ns_per_op * 1e9, bytes / m.ns_per_op * 1e9, bytes, m.allocs_per_op);
+}
+
+static void bench_renders() {
+    const struct {uint16_t width, height;} sizes[] = {{1280, 720}, {1920, 1080}, {3840, 2160}};
+    const uint32_t densities[] = {100, 1000, 10000};
+
+    for (uint32_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+        for (uint32_t d = 0; d < sizeof(densities) / sizeof(densities[0]); d++) {
+            bench_render("triogons", triogons, NULL, sizes[k].width, sizes[k].height, densities[d]);
+            bench_render("bubbles.wks", scripted, SCRIPT_PATH, sizes[k].width, sizes[k].height, densities[d]);
+        }
+    }
+    // the sizes of a mixed fleet, from one set of shapes.
+    const RenderSize fleet[] = {{1366, 768, OUT_PATH}, {1920, 1080, OUT_PATH}, {2560, 1440, OUT_PATH}, {3440, 1440, OUT_PATH}, {3840, 2160, OUT_PATH}};
+    for (uint32_t d = 0; d < sizeof(densities) / sizeof(densities[0]); d++) {
+        SizesCase c = {{0, 0, Lumos, 42, densities[d], NULL, NULL, NULL}, fleet, sizeof(fleet) / sizeof(fleet[0])};
+        Measure m = measure(op_render_sizes, &c);
+        printf("{\"bench\":\"triogons_sizes\",\"sizes\":%u,\"density\":%u,\"ns_per_op\":%.0f,\"ns_per_size\":%.0f,\"allocs_per_render\":%lu}\n",
+                c.count, densities[d], m.ns_per_op, m.ns_per_op / c.count, m.allocs_per_op);
+    }
+    // sample has a fixed layout, so size and density do not apply.
+    bench_render("sample", sample, NULL, 1920, 1080, 0);
+    unlink(OUT_PATH);
+}
+
+// ### output forms ###
+
+// Renders triogons at 1080p in the verbose form, the compact one and the compact one
+// gzipped, with the bytes each writes.
+static void bench_output_forms() {
+    const uint32_t densities[] = {1000, 10000};
+    const struct {const char* name; int8_t compact; const char* path;} forms[] = {
+        {"triogons_verbose", 0, OUT_PATH}, {"triogons_compact", 1, OUT_PATH}, {"triogons_compact_svgz", 1, OUT_SVGZ_PATH}
+    };
+    for (uint32_t d = 0; d < sizeof(densities) / sizeof(densities[0]); d++) {
+        for (uint32_t f = 0; f < sizeof(forms) / sizeof(forms[0]); f++) {
+            RenderCase c = {triogons, {1920, 1080, Lumos, 42, densities[d], NULL, forms[f].path, NULL, forms[f].compact}};
+            Measure m = measure(op_render, &c);
+            struct stat st;
+            const uint64_t bytes = (stat(forms[f].path, &st) == 0) ? (uint64_t)st.st_size : 0;
+            printf("{\"bench\":\"%s\",\"width\":1920,\"height\":1080,\"density\":%u,\"ns_per_op\":%.0f,"
+                    "\"output_bytes\":%lu,\"allocs_per_render\":%lu}\n",
+                    forms[f].name, densities[d], m.ns_per_op, bytes, m.allocs_per_op);
+        }
+    }
+    unlink(OUT_PATH);
+    unlink(OUT_SVGZ_PATH);
+}
+
+// ### animation ###
+
+// Animates drifting triogons at 1080p, one file per frame or a single SMIL document.
+static void bench_animation(uint32_t density, int smil) {
+    const RenderParams params = {1920, 1080, Lumos, 42, density, NULL, smil ? OUT_PATH : FRAMES_DIR "/" ANIMATION_FRAME_KEY ".svg", NULL};
+    const Animation animation = {ANIMATION_FRAMES, 30};
+    AnimationReport report;
+    uint64_t before = __atomic_load_n(&allocs, __ATOMIC_RELAXED);
+    if (triogons_animate(&params, &animation, &report) != 0) return;
+    uint64_t allocated = __atomic_load_n(&allocs, __ATOMIC_RELAXED) - before;
+
+    printf("{\"bench\":\"%s\",\"width\":1920,\"height\":1080,\"density\":%u,\"frames\":%u,\"frames_per_sec\":%.1f,"
+            "\"ns_per_frame\":%.0f,\"reformatted\":%.3f,\"allocs_per_frame\":%.1f}\n",
+            smil ? "triogons_animate_smil" : "triogons_animate", density, report.frames, report.frames / report.seconds,
+            report.seconds * 1e9 / report.frames, (double)report.reformatted / report.shapes, (double)allocated / report.frames);
+
+    for (uint32_t f = 0; !smil && f < ANIMATION_FRAMES; f++) {
+        char path[64];
+        snprintf(path, sizeof(path), FRAMES_DIR "/%04u.svg", f);
+        unlink(path);
+    }
+    rmdir(FRAMES_DIR);
+}
+
+static void bench_animations() {
+    const uint32_t densities[] = {100, 1000, 10000};
+    for (uint32_t d = 0; d < sizeof(densities) / sizeof(densities[0]); d++) {
+        bench_animation(densities[d], 0);
+        bench_animation(densities[d], 1);
+    }
+    unlink(OUT_PATH);
+}
+
+int main() {
+    Rng rng;
+    rng_seed(&rng, 1);
+    // print each result as soon as it is measured, even when piped.
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    bench_strings(&rng);
+    bench_geometry(&rng);
+    bench_scripts();
+    bench_renders();
+    bench_output_forms();
+    bench_animations();
+    return 0;
+}
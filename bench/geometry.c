@@ -0,0 +1,61 @@
+/*
+Microbenchmark of the shape transforms: the per matrix transform_rotate() +
+transform_scale() pair against one geom_batch_transform() pass over a batch.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../include/geometry.h"
+#include "../include/rng.h"
+#include "../include/utils.h"
+
+static double now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main() {
+    const uint32_t sizes[] = {1000, 10000, 100000, 1000000};
+    const int rounds = 5;
+    Rng rng;
+    rng_seed(&rng, 1);
+
+    for (uint32_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+        uint32_t n = sizes[k];
+        int (*mats)[3][6] = malloc(n * sizeof(*mats));
+        ShapeBatch batch;
+        geom_batch_init(&batch, 9, n);
+        for (uint32_t s = 0; s < n; s++) {
+            geom_batch_push(&batch);
+            for (int p = 0; p < 9; p++) {
+                mats[s][p / 3][(p % 3) * 2] = GEOM_X(&batch, s, p) = rand_range(&rng, 0, 1920);
+                mats[s][p / 3][(p % 3) * 2 + 1] = GEOM_Y(&batch, s, p) = rand_range(&rng, 0, 1080);
+            }
+            batch.angle[s] = rand_range(&rng, 0, 360);
+            batch.scale[s] = rand_range(&rng, 1, 2);
+        }
+
+        double best_scalar = 1e30, best_batch = 1e30;
+        for (int r = 0; r < rounds; r++) {
+            double t = now_ns();
+            for (uint32_t s = 0; s < n; s++) {
+                transform_rotate(3, 6, mats[s], batch.angle[s]);
+                transform_scale(3, 6, mats[s], batch.scale[s]);
+            }
+            t = now_ns() - t;
+            if (t < best_scalar) best_scalar = t;
+
+            t = now_ns();
+            geom_batch_transform(&batch);
+            t = now_ns() - t;
+            if (t < best_batch) best_batch = t;
+        }
+
+        printf("{\"shapes\":%u,\"transform_ns_per_shape\":%.2f,\"batch_ns_per_shape\":%.2f,\"speedup\":%.1f}\n",
+                n, best_scalar / n, best_batch / n, best_scalar / best_batch);
+        geom_batch_free(&batch);
+        free(mats);
+    }
+    return 0;
+}
@@ -0,0 +1,43 @@
+/*
+A bump allocator for short lived allocations.
+Everything allocated during one render is released at once with arena_reset(),
+and the blocks are kept for the next render, so a steady state render does not
+call malloc at all.
+*/
+
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <stdint.h>
+
+typedef struct ArenaBlock {
+    struct ArenaBlock* next;
+    uint64_t size;
+    uint64_t used;
+    _Alignas(16) char data[];
+} ArenaBlock;
+
+typedef struct Arena {
+    ArenaBlock* head;
+    ArenaBlock* current;
+    uint64_t block_size; // size of the first block; 0 picks a default.
+    void* last;          // most recent allocation, the only one that can grow in place.
+} Arena;
+
+// Returns size bytes from the arena, 16 byte aligned; NULL on failure.
+void* arena_alloc(Arena* arena, uint64_t size);
+
+// Resizes an allocation of the arena. The most recent allocation grows in place,
+// others are copied and their old space is reclaimed only by arena_reset().
+void* arena_realloc(Arena* arena, void* ptr, uint64_t old_size, uint64_t new_size);
+
+// Returns 1 if ptr points into one of the arena's blocks; 0 otherwise.
+int8_t arena_owns(const Arena* arena, const void* ptr);
+
+// Releases every allocation in O(1) and keeps the blocks for reuse.
+void arena_reset(Arena* arena);
+
+// Returns the blocks to the system and resets the arena's fields.
+void arena_free(Arena* arena);
+
+#endif
@@ -0,0 +1,86 @@
+/*
+Batch rendering of a job matrix: every preset x theme x size x seed combination
+is rendered once, on a thread pool, into a path built from an output pattern.
+Presets are compiled once and shared by the jobs, so a batch pays for start up
+and preset parsing only once whatever its size. Presets that can render several sizes
+at once render every size of a theme and seed in one job, from one geometry pass.
+With a cache, jobs rendered before by any process are copied from it instead.
+*/
+
+#ifndef __BATCH_H__
+#define __BATCH_H__
+
+#include <stdint.h>
+#include "presets.h"
+#include "template.h"
+
+typedef struct Pool Pool;
+
+// A preset that batches can refer to by name.
+typedef struct BatchPreset {
+    const char* name;
+    PresetRender render;
+    const char* script; // handed to render in RenderParams.script; NULL for built-in presets.
+    PresetRenderSizes render_sizes; // optional, renders all the sizes of a job at once.
+    PresetContent content; // what renders are cached by, see preset_render_cached().
+} BatchPreset;
+
+typedef struct BatchSize {
+    uint16_t width;
+    uint16_t height;
+} BatchSize;
+
+typedef struct Batch {
+    const BatchPreset** presets;
+    uint16_t preset_count;
+    Theme* themes;
+    uint16_t theme_count;
+    BatchSize* sizes;
+    uint16_t size_count;
+    uint64_t* seeds;
+    uint32_t seed_count;
+    uint32_t density;  // 0 lets the presets pick.
+    int8_t compact;    // see RenderParams.compact.
+    const Rgba* accents; // see RenderParams.accents.
+    uint8_t accent_count;
+    Template out;      // output path, see BATCH_OUT_KEYS.
+    Cache* cache;      // optional, shared by the jobs.
+} Batch;
+
+// placeholders of the output pattern, eg. "wallpapers/{theme}/{preset}-{width}x{height}-{seed}.svg".
+#define BATCH_OUT_KEYS {STR_LIT("{preset}"), STR_LIT("{theme}"), STR_LIT("{width}"), STR_LIT("{height}"), STR_LIT("{seed}")}
+#define BATCH_OUT_DEFAULT "{preset}-{theme}-{width}x{height}-{seed}.svg"
+
+typedef struct BatchReport {
+    uint64_t jobs;
+    uint64_t failed;
+    double seconds;
+} BatchReport;
+
+// Each list is comma separated and appends to the batch.
+// Returns 0 on success and -1 on a malformed list or memory allocation failure.
+
+// Preset names, looked up in registry.
+int8_t batch_add_presets(Batch* b, const char* list, const BatchPreset registry[], uint16_t registry_count);
+// "lumos" or "noir".
+int8_t batch_add_themes(Batch* b, const char* list);
+// WIDTHxHEIGHT, eg. "1920x1080,2560x1440".
+int8_t batch_add_sizes(Batch* b, const char* list);
+// seeds or inclusive ranges of seeds, eg. "7,100-199".
+int8_t batch_add_seeds(Batch* b, const char* list);
+
+// Compiles the output path pattern. Returns 0 on success and -1 on failure.
+int8_t batch_set_out(Batch* b, const char* pattern);
+
+// Returns the number of jobs in the matrix, one per output file.
+uint64_t batch_job_count(const Batch* b);
+
+// Renders every job of the batch, on pool when given, and fills report.
+// Missing directories of the output paths are created.
+// Returns 0 if every job succeeded and -1 otherwise.
+int8_t batch_run(const Batch* b, Pool* pool, BatchReport* report);
+
+// Frees the lists and the output pattern of the batch.
+void batch_free(Batch* b);
+
+#endif
@@ -0,0 +1,91 @@
+/*
+Content-addressed file cache on disk: every entry is a file named after a 64-bit key,
+usually a hash of everything its content was made from, so that a key always holds the same bytes.
+
+An index file next to the entries records their sizes and when each was last used, and
+the least recently used entries are removed whenever the cache outgrows its size. Any number of
+processes can share a cache: the index is mapped by all of them and only changed with an
+flock(2) on it held, and entries are written to a temporary file and renamed into place,
+so that a reader only ever opens a complete entry. An entry that is opened stays readable
+until it is closed, even if it is evicted meanwhile.
+*/
+
+#ifndef __CACHE_H__
+#define __CACHE_H__
+
+#include <stdint.h>
+#include <limits.h>
+#include <pthread.h>
+
+// bumped whenever the index layout changes; an index of another version is reset.
+#define CACHE_INDEX_VERSION 1
+#define CACHE_INDEX_FILE "index"
+// entries the index holds; the least recently used one makes room for a new one past that.
+#define CACHE_MAX_ENTRIES 4096
+// longest file name extension of an entry, dot included.
+#define CACHE_EXT_MAX 8
+
+typedef struct CacheSlot {
+    uint64_t key;
+    uint64_t bytes;
+    uint64_t used;           // value of the index clock when the entry was last used.
+    char ext[CACHE_EXT_MAX]; // of the entry file, eg. ".svg".
+} CacheSlot;
+
+// Counts of the operations on a cache, either of one process or of every process since the index was created.
+typedef struct CacheCounters {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t inserts;
+    uint64_t evictions;
+} CacheCounters;
+
+// The index file, mapped in every process using the cache.
+typedef struct CacheIndex {
+    char magic[4];
+    uint32_t version;
+    uint64_t bytes;   // total size of the entries.
+    uint64_t clock;   // advanced by every use of an entry.
+    CacheCounters counters;
+    uint32_t count;
+    uint32_t reserved;
+    CacheSlot slots[CACHE_MAX_ENTRIES];
+} CacheIndex;
+
+typedef struct Cache {
+    char dir[PATH_MAX];
+    uint64_t max_bytes;
+    int index_fd;
+    CacheIndex* index;
+    // flock(2) locks belong to the open file, which the threads of a process share.
+    pthread_mutex_t lock;
+    CacheCounters counters; // of this process, guarded by lock; read them with cache_counters().
+} Cache;
+
+// Opens the cache in dir, creating it if needed, and bounds it to max_bytes.
+// A missing or damaged index is reset, and the entries it no longer knows are removed.
+// Returns 0 on success and -1 on failure.
+int8_t cache_open(Cache* c, const char* dir, uint64_t max_bytes);
+
+// Fills path with the file of the entry of key, whose name ends with ext (at most CACHE_EXT_MAX - 1
+// characters). The entry is written there atomically, then recorded with cache_insert().
+// Returns 0 on success and -1 if the path does not fit.
+int8_t cache_entry_path(const Cache* c, uint64_t key, const char* ext, char path[PATH_MAX]);
+
+// Looks key up and marks its entry as the most recently used one. On a hit, *fd is the
+// entry opened for reading, to be closed by the caller.
+// Returns 0 on a hit and -1 on a miss; failing to read the cache counts as a miss.
+int8_t cache_lookup(Cache* c, uint64_t key, int* fd);
+
+// Records the entry of key written at its path, then evicts the least recently used entries
+// until the cache fits in its size again; the new entry goes last, even when it alone does not fit.
+// Returns 0 on success and -1 on failure.
+int8_t cache_insert(Cache* c, uint64_t key, const char* ext);
+
+// Fills *own with the counters of this process and *all with those of every process sharing the cache.
+void cache_counters(Cache* c, CacheCounters* own, CacheCounters* all);
+
+// Unmaps the index and resets the fields; the entries stay on disk.
+void cache_close(Cache* c);
+
+#endif
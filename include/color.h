@@ -0,0 +1,113 @@
+/*
+Colours as renderers draw them, 8-bit channels packed into one integer, and the palettes
+the presets draw the colours of their shapes from.
+
+HSL and HSV are converted with integer arithmetic only, rounding the exact value of every
+channel, so the same colour always gets the same channels whichever module converts it:
+the compact SVG writes them as #rrggbb, and the rasterizer parses hsl() fills into the same ones.
+A palette precomputes, for every saturation and lightness it draws, the chroma and the
+offset of the conversion, leaving a lookup and the part that depends on the hue.
+*/
+
+#ifndef __COLOR_H__
+#define __COLOR_H__
+
+#include <stdint.h>
+#include "strings.h"
+
+typedef struct Rng Rng;
+
+// Red, green, blue and alpha, 8 bits each, packed as 0xRRGGBBAA.
+typedef uint32_t Rgba;
+
+#define RGBA(r, g, b, a) (((Rgba)(r) << 24) | ((Rgba)(g) << 16) | ((Rgba)(b) << 8) | (Rgba)(a))
+
+static inline uint8_t rgba_red(Rgba c) { return (uint8_t)(c >> 24); }
+static inline uint8_t rgba_green(Rgba c) { return (uint8_t)(c >> 16); }
+static inline uint8_t rgba_blue(Rgba c) { return (uint8_t)(c >> 8); }
+static inline uint8_t rgba_alpha(Rgba c) { return (uint8_t)c; }
+
+// h in degrees, s and l in percent (written as integers), a in 0..1.
+typedef struct Hsla {
+    float h;
+    float s;
+    float l;
+    float a;
+} Hsla;
+
+// Hues are in hundredths of a degree and wrap around, saturation, lightness and value
+// in hundredths of a percent, from 0 to 10000.
+Rgba color_hsl(int32_t hue, int32_t saturation, int32_t lightness, uint8_t alpha);
+Rgba color_hsv(int32_t hue, int32_t saturation, int32_t value, uint8_t alpha);
+
+// The colour c is drawn with once written by svg_hsla() with `precision` decimals:
+// the hue and alpha rounded to them, saturation and lightness to whole percents.
+Rgba color_from_hsla(Hsla c, uint8_t precision);
+
+// Returns the hue of c in hundredths of a degree, from 0 to 35999; 0 for greys.
+int32_t color_hue(Rgba c);
+
+// Appends c as #rrggbb, or #rgb when it is as short; the alpha is left out.
+// Returns 0 on success and -1 on memory allocation failure.
+int8_t color_hex(StrBuilder* out, Rgba c);
+
+// Reads a #rgb or #rrggbb colour, the '#' optional, into *c with an opaque alpha.
+// Returns 0 on success and -1 if text is not one.
+int8_t color_parse_hex(StrView text, Rgba* c);
+
+// Reads a comma separated list of one or more such colours, eg. "#ff8800,36c", into at most
+// `capacity` colours. Returns 0 on success and -1 if the list is empty, one is malformed
+// (an empty one after a trailing comma included) or there are too many.
+int8_t color_parse_hex_list(StrView list, Rgba colors[], uint8_t capacity, uint8_t* count);
+
+// accent colours a palette can draw its hues around.
+#define PALETTE_MAX_ACCENTS 8
+// degrees a hue drawn around an accent strays from it, either way.
+#define PALETTE_ACCENT_SPREAD 24
+
+// The colours a palette draws: whole percents of lightness and saturation in [min, max)
+// and the alpha they all share.
+typedef struct PaletteSpec {
+    uint8_t lightness_min, lightness_max;
+    uint8_t saturation_min, saturation_max;
+    float alpha;
+} PaletteSpec;
+
+// The parts of the conversion of one saturation and lightness that do not depend on the hue.
+typedef struct PaletteCell {
+    int64_t chroma;
+    int64_t offset;
+} PaletteCell;
+
+typedef struct Palette {
+    PaletteSpec spec;
+    const PaletteCell* cells; // saturation major, shared by the palettes made from one another.
+    PaletteCell* owned;       // the cells, when this palette built them.
+    int32_t accents[PALETTE_MAX_ACCENTS]; // hues, in hundredths of a degree.
+    uint8_t accent_count;
+} Palette;
+
+// Builds the tables of a palette drawing what spec describes, with hues all around.
+// Returns 0 on success and -1 on failure.
+int8_t palette_init(Palette* p, PaletteSpec spec);
+
+// Reads a list of at most PALETTE_MAX_ACCENTS accent colours, as color_parse_hex_list() does.
+// Greys, white and black have no hue to draw around and are refused.
+// Returns 0 on success and -1 if a colour is malformed or grey, or there are too many.
+int8_t palette_parse_accents(StrView list, Rgba accents[PALETTE_MAX_ACCENTS], uint8_t* count);
+
+// Makes a palette drawing like base, whose tables it shares, but with hues around the hues of
+// `count` accent colours, none of them grey; with none it draws like base.
+void palette_accented(Palette* p, const Palette* base, const Rgba accents[], uint8_t count);
+
+// Draws a colour of the palette from rng in O(1): its lightness, its saturation, then its hue,
+// in that order, and around one of the accents when there are some.
+Hsla palette_draw(const Palette* p, Rng* rng);
+
+// The colour of color_from_hsla(), taken from the tables for the colours the palette draws.
+Rgba palette_rgba(const Palette* p, Hsla c, uint8_t precision);
+
+// Frees the tables the palette built; the palettes sharing them must not be used after.
+void palette_free(Palette* p);
+
+#endif
@@ -0,0 +1,67 @@
+/*
+Streaming gzip (RFC 1952) and zlib (RFC 1950) encoders, and the checksums of the zlib,
+PNG and gzip formats.
+Both compress with deflate (RFC 1951): greedy LZ77 matches over the last 32K, found through
+hash chains, coded in blocks of GZIP_BLOCK_TOKENS literals and matches with Huffman codes
+built for each block, or with the fixed codes of deflate when those come out shorter.
+Only their header and trailer differ; gzip wraps .svgz output, zlib the pixels of a PNG.
+*/
+
+#ifndef __DEFLATE_H__
+#define __DEFLATE_H__
+
+#include <stdint.h>
+#include "strings.h"
+
+// largest distance back a gzip match can reach.
+#define GZIP_WINDOW 32768
+// literals and matches coded together, with the same codes.
+#define GZIP_BLOCK_TOKENS 16384
+// codes of the literal/length and distance alphabets.
+#define GZIP_LIT_CODES 286
+#define GZIP_DIST_CODES 30
+
+typedef struct Gzip {
+    StrBuilder* out;
+    int8_t zlib;      // a zlib stream, whose trailer is the Adler-32 instead of the CRC and size.
+    uint32_t crc;     // of everything written so far, the Adler-32 in a zlib stream.
+    uint32_t size;    // bytes written so far, modulo 2^32.
+    uint64_t bits;    // coded bits not appended to out yet, first ones lowest.
+    uint8_t bit_count;
+    uint8_t* window;  // 2 * GZIP_WINDOW bytes: the input already coded and the input to code.
+    uint32_t filled;  // bytes of input in the window.
+    uint32_t pos;     // first byte of the window not coded yet.
+    int32_t* head;    // last position of every hash of 3 bytes, -1 if none.
+    int32_t* prev;    // previous position of the same hash, by position modulo GZIP_WINDOW.
+    uint16_t* tokens; // length, 0 for a literal, then byte or distance of each token of the block.
+    uint32_t token_count;
+    uint32_t lit_freq[GZIP_LIT_CODES]; // uses of each code by the tokens of the block.
+    uint32_t dist_freq[GZIP_DIST_CODES];
+} Gzip;
+
+// Starts a gzip stream appended to out.
+// Returns 0 on success and -1 on memory allocation failure.
+int8_t gzip_begin(Gzip* g, StrBuilder* out);
+
+// Starts a zlib stream appended to out, then written, ended and freed as a gzip one.
+// Returns 0 on success and -1 on memory allocation failure.
+int8_t zlib_begin(Gzip* g, StrBuilder* out);
+
+// Compresses length bytes of data into the stream; the output lags the input by up to a block.
+// Returns 0 on success and -1 on memory allocation failure.
+int8_t gzip_write(Gzip* g, const uint8_t* data, uint64_t length);
+
+// Codes what is left, then the end of the block and the trailer; the stream is complete afterwards.
+// Returns 0 on success and -1 on memory allocation failure.
+int8_t gzip_end(Gzip* g);
+
+// Releases the window and hash chains, whether the stream was ended or not.
+void gzip_free(Gzip* g);
+
+// Continues a CRC-32 (as in PNG, gzip and zip) over data; start with crc = 0.
+uint32_t crc32_update(uint32_t crc, const uint8_t* data, uint64_t length);
+
+// Continues an Adler-32 (as in zlib) over data; start with adler = 1.
+uint32_t adler32_update(uint32_t adler, const uint8_t* data, uint64_t length);
+
+#endif
@@ -0,0 +1,42 @@
+/*
+Locale independent number formatting straight into caller supplied memory.
+Used instead of the printf family on hot paths, where measuring, parsing the
+format string and locale lookups cost more than the digits themselves.
+*/
+
+#ifndef __FMT_H__
+#define __FMT_H__
+
+#include <stdint.h>
+#include "strings.h"
+
+// enough room for any 64 bit integer or fixed point number written by this module.
+#define FMT_MAX 48
+
+// highest precision fmt_fixed() supports.
+#define FMT_MAX_PRECISION 9
+
+// Writes n in decimal into buf. Returns the number of bytes written; buf is not null terminated.
+uint8_t fmt_uint(char* buf, uint64_t n);
+uint8_t fmt_int(char* buf, int64_t n);
+
+// Writes v with exactly `precision` decimals, rounding half away from zero; unlike printf,
+// a value sitting on (or within a rounding error of) a tie may round up in the last digit.
+// Precision is clamped to FMT_MAX_PRECISION. Returns the number of bytes written.
+uint8_t fmt_fixed(char* buf, double v, uint8_t precision);
+
+// The digits fmt_fixed() writes v with, as an integer: two values get the same key exactly
+// when they are written the same, so output can be compared without formatting it.
+// Values too large for fmt_fixed() to write itself share a key per sign.
+int64_t fmt_fixed_key(double v, uint8_t precision);
+
+// Writes the number whose fmt_fixed_key() at `precision` is key in its shortest form:
+// no zeros trailing the decimals nor leading the point, eg. -.5 for -0.50.
+// Returns the number of bytes written.
+uint8_t fmt_key_short(char* buf, int64_t key, uint8_t precision);
+
+// Same as above but appends to a builder. Returns 0 on success, -1 on failure.
+int8_t str_builder_append_int(StrBuilder* sb, int64_t n);
+int8_t str_builder_append_fixed(StrBuilder* sb, double v, uint8_t precision);
+
+#endif
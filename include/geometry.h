@@ -0,0 +1,54 @@
+/*
+Batched geometry for shapes made of control points.
+The points of every shape in a batch live in structure of arrays float buffers,
+laid out point major: x[point * capacity + shape]. A transform pass then walks
+each point row across all shapes with unit stride, which the compiler can vectorize.
+*/
+
+#ifndef __GEOMETRY_H__
+#define __GEOMETRY_H__
+
+#include <stdint.h>
+
+typedef struct ShapeBatch {
+    float* x;
+    float* y;
+    // per shape transform: rotate by angle (degrees) and scale around the
+    // shape's centroid, then translate by tx, ty.
+    float* angle;
+    float* scale;
+    float* tx;
+    float* ty;
+    // scratch space for the transform pass.
+    float* m[6];
+    uint32_t count;
+    uint32_t capacity;
+    uint16_t points; // control points per shape.
+} ShapeBatch;
+
+// Control point `point` of shape `shape`.
+#define GEOM_X(batch, shape, point) ((batch)->x[(uint64_t)(point) * (batch)->capacity + (shape)])
+#define GEOM_Y(batch, shape, point) ((batch)->y[(uint64_t)(point) * (batch)->capacity + (shape)])
+
+// Creates an empty batch of shapes with `points` control points each.
+// Returns 0 on success and -1 on failure.
+int8_t geom_batch_init(ShapeBatch* batch, uint16_t points, uint32_t capacity);
+
+// Makes room for `capacity` shapes, keeping the ones already in the batch.
+// Returns 0 on success and -1 on failure.
+int8_t geom_batch_reserve(ShapeBatch* batch, uint32_t capacity);
+
+// Appends a shape with an identity transform, growing the batch if needed.
+// Returns the index of the new shape or -1 on failure.
+int64_t geom_batch_push(ShapeBatch* batch);
+
+// Removes every shape but keeps the memory.
+void geom_batch_clear(ShapeBatch* batch);
+
+// Applies each shape's rotate + scale + translate as one affine map, in place.
+void geom_batch_transform(ShapeBatch* batch);
+
+// Frees the memory held by the batch and resets its fields.
+void geom_batch_free(ShapeBatch* batch);
+
+#endif
@@ -0,0 +1,43 @@
+/*
+The pieces of HTTP/1.1 (RFC 9112) a small server needs: parsing the head of a request as
+its bytes arrive, reading the parameters of its query string and writing the head of a
+response. Nothing is copied, a parsed request views the bytes it was parsed from.
+Requests with a body are recognised but their body is not parsed.
+*/
+
+#ifndef __HTTP_H__
+#define __HTTP_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "strings.h"
+
+typedef struct HttpRequest {
+    StrView method;
+    StrView path;       // target up to its query, eg. "/render".
+    StrView query;      // target after the '?', empty when there is none.
+    uint8_t minor;      // of the version, HTTP/1.minor.
+    int8_t keep_alive;  // the connection stays open after the response.
+    int8_t has_body;    // a Content-Length other than 0 or a Transfer-Encoding was given.
+    uint64_t length;    // bytes of the head, its blank line included.
+} HttpRequest;
+
+// Parses the head of the request data starts with.
+// Returns 1 once it is complete, 0 while more bytes are needed and -1 if it is malformed.
+int8_t http_parse_request(StrView data, HttpRequest* req);
+
+// Looks parameter name up in a query string, eg. "seed=7&theme=noir", and copies its
+// percent-decoded value into value, null terminated, which holds cap bytes.
+// Returns 1 if it is there, 0 if it is not and -1 if its value is malformed or does not fit.
+int8_t http_query_param(StrView query, const char* name, char* value, size_t cap);
+
+// Appends the head of a response: its status line, Content-Type and Content-Length,
+// Connection, the header lines in extra, each ending with "\r\n", and the blank line.
+// Returns 0 on success and -1 on memory allocation failure.
+int8_t http_response_head(StrBuilder* out, uint16_t status, const char* content_type, uint64_t content_length,
+        int8_t keep_alive, StrView extra);
+
+// Returns the reason phrase of a status code, eg. "Not Found" for 404.
+const char* http_reason(uint16_t status);
+
+#endif
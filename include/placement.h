@@ -0,0 +1,74 @@
+/*
+Blue noise placement: points scattered over a box so that no two of them are closer
+than a minimum spacing (Poisson-disk sampling, after Bridson's algorithm). A uniform grid
+whose cells hold at most one point answers the distance checks in constant time,
+so placing n points is O(n).
+
+Points come one at a time, in a sequence that only depends on the generator the
+placement was started with. A box only holds so many points at a given spacing, so
+the spacing shrinks to fit the number of points expected, down to what the grid
+allows. Past that, the points come in layers: the layout is computed once, with the
+box wrapping around at its edges, and every layer is that layout shifted by a random
+offset and wrapped back into the box, so any number of points costs O(1) each.
+*/
+
+#ifndef __PLACEMENT_H__
+#define __PLACEMENT_H__
+
+#include <stdint.h>
+#include "rng.h"
+#include "utils.h"
+
+// common divisor is used to maintain relative scaling for other resolutions.
+// 120 is the common divisor of 1920 x 1080.
+// !It is not necessary to change it for different resolutions.
+#define COMMON_DIVISOR 120
+
+// candidates tried around a point before it is considered surrounded.
+#define PLACEMENT_ATTEMPTS 8
+// the grid never has more cells than this (20 bytes each); smaller spacings are raised to fit.
+#define PLACEMENT_MAX_CELLS (1 << 16)
+// share of the box a layer fills at a given spacing: a full layer holds about
+// PLACEMENT_FILL * area / spacing^2 points, 0.68 measured; lower so that the count fits.
+#define PLACEMENT_FILL 0.6f
+
+typedef struct Placement {
+    Point begin;
+    Point size;          // of the box.
+    float spacing;       // minimum distance between two points of a layer.
+    Rng rng;
+    uint32_t cols;
+    uint32_t rows;
+    Point inverse_cell;  // cells per unit of length, along each axis.
+    uint32_t reach;      // cells around a point that may hold points too close to it.
+    Point* grid;         // the point of the layout in each cell, NaN when empty.
+    Point* points;       // the layout; the points of the current layer handed out come first.
+    uint32_t* active;    // points that may still have room around them, while laying out.
+    uint32_t count;
+    uint32_t next;
+    uint32_t active_count;
+    uint32_t capacity;   // cells the buffers are sized for, kept across placements.
+    Point offset;        // shift of the current layer.
+    uint32_t layers;     // layers started so far.
+} Placement;
+
+// Spacing of `units` canvas units. A unit is the mean side of the canvas divided by
+// COMMON_DIVISOR, so a layout keeps its proportions at every resolution.
+static inline float placement_spacing(uint16_t width, uint16_t height, float units) {
+    return ((float)width + height) / 2 / COMMON_DIVISOR * units;
+}
+
+// Starts placing points in the box from begin to end, drawing from a copy of rng, at most
+// spacing apart. When count, the number of points that will be drawn, does not fit at that
+// spacing, it is lowered so that they all fit in one layer if the grid allows.
+// The memory of a previous placement is reused. Returns 0 on success and -1 on failure.
+int8_t placement_begin(Placement* p, const Rng* rng, Point begin, Point end, float spacing, uint32_t count);
+
+// Returns the next point. Never fails once the placement has begun.
+// The layout is computed when the first point is asked for.
+Point placement_next(Placement* p);
+
+// Frees the memory held by the placement and resets its fields.
+void placement_free(Placement* p);
+
+#endif
@@ -0,0 +1,59 @@
+/*
+A fixed size pool of worker threads running queued tasks.
+Every worker owns a deque of tasks: it runs its own tasks newest first and,
+once it runs dry, steals the oldest tasks of the other workers. Tasks
+submitted from outside the pool are dealt round-robin over the workers.
+*/
+
+#ifndef __POOL_H__
+#define __POOL_H__
+
+#include <stdint.h>
+#include <pthread.h>
+
+typedef void (*PoolTask)(void* arg);
+
+typedef struct PoolJob {
+    PoolTask fn;
+    void* arg;
+} PoolJob;
+
+// Ring buffer of the tasks of one worker, owner end at the back.
+typedef struct PoolDeque {
+    pthread_mutex_t lock;
+    PoolJob* jobs;
+    uint32_t head;
+    uint32_t count;
+    uint32_t capacity;
+} PoolDeque;
+
+typedef struct Pool {
+    pthread_t* threads;
+    PoolDeque* deques; // one per worker.
+    uint16_t thread_count;
+    uint32_t next;     // deque receiving the next task submitted from outside.
+    pthread_mutex_t lock;
+    pthread_cond_t has_work;
+    pthread_cond_t idle;
+    int64_t queued;    // tasks not yet started, counted before they are pushed.
+    uint64_t pending;  // tasks queued or running.
+    uint64_t steals;   // tasks run by a thread other than the one they were queued on.
+    int8_t stopping;
+} Pool;
+
+// Starts `threads` worker threads. Returns 0 on success and -1 on failure.
+int8_t pool_init(Pool* pool, uint16_t threads);
+
+// Queues fn(arg) to run on one of the workers. Called from a task, the task
+// goes to the deque of the calling worker. Returns 0 on success and -1 on failure.
+int8_t pool_submit(Pool* pool, PoolTask fn, void* arg);
+
+// Blocks until every submitted task has finished.
+// The calling thread runs queued tasks too instead of sleeping.
+// Must not be called from a task of the same pool.
+void pool_wait(Pool* pool);
+
+// Waits for the queued tasks, stops the workers and frees the pool.
+void pool_destroy(Pool* pool);
+
+#endif
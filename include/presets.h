@@ -0,0 +1,173 @@
+/*
+Entry points of the presets in src/ and the options they are rendered with.
+*/
+
+#ifndef __PRESETS_H__
+#define __PRESETS_H__
+
+#include <stdint.h>
+#include "color.h"
+#include "deflate.h"
+#include "raster.h"
+#include "strings.h"
+#include "utils.h"
+
+typedef struct Pool Pool;
+typedef struct Cache Cache;
+
+// light and dark theme
+typedef enum {Lumos, Noir} Theme;
+
+typedef struct RenderParams {
+    uint16_t width;
+    uint16_t height;
+    Theme theme;
+    uint64_t seed;     // the same seed always renders the same wallpaper.
+    uint32_t density;  // number of shapes to draw; 0 lets the preset pick.
+    Pool* pool;        // optional; large renders are spread over its threads.
+    const char* path;  // file the image atomically replaces; NULL writes out.svg and "-" streams to stdout.
+    const char* script; // preset script rendered by scripted().
+    int8_t compact;    // shorter SVG that renders the same: relative paths, hex colours, shared opacity.
+    int fd;            // when not 0, an open file (eg. a memfd) the image is written to instead of
+                       // path, which then only names the format; it is left open.
+    const Rgba* accents; // colours whose hues triogons draws its shapes around; NULL for the theme's own.
+    uint8_t accent_count;
+} RenderParams;
+
+// Presets render the SVG described by params into params->path.
+// They may run concurrently on different threads.
+// Return 0 on success and -1 on failure.
+typedef int8_t (*PresetRender)(const RenderParams* params);
+
+// Directory custom presets are loaded from at runtime, as <name>.preset, instead of the
+// copies built into the binary; NULL renders the built-in ones. Set it before rendering.
+extern const char* preset_dir;
+
+// Where the SVG of a render goes while the preset generates it.
+// SVG output is streamed: the preset flushes the chain whenever a bounded piece of the
+// document is complete, so memory does not grow with the number of shapes.
+// Paths ending in .png or .ppm keep the whole document, to rasterize it at the end;
+// paths ending in .svgz stream it gzipped.
+typedef struct PresetSink {
+    StrChain chain;   // what has been generated and not written yet.
+    int fd;           // where the SVG is streamed; -1 when it is kept for a bitmap.
+    AtomicFile file;  // behind fd when a regular file is replaced.
+    int8_t replacing;
+    int8_t gzipped;
+    Gzip gzip;        // compresses the chain into packed when gzipped.
+    StrBuilder packed;
+    RasterSplice splice; // for a bitmap, adds shapes at byte splice_at of the document, see preset_sink_splice().
+    void* splice_arg;
+    uint64_t splice_at;
+} PresetSink;
+
+// Prepares the output of a render to params->path. Regular files are replaced atomically
+// when the render succeeds; "-" streams to stdout and other non regular files, like pipes,
+// sockets or /dev/fd/N, are written in place as the render goes.
+// Returns 0 on success and -1 on failure.
+int8_t preset_sink_open(PresetSink* sink, const RenderParams* params);
+
+// Returns 1 if the sink streams, so that flushing it releases memory.
+static inline int8_t preset_sink_streams(const PresetSink* sink) {
+    return sink->fd != -1;
+}
+
+// Has a sink that rasterizes the document draw the shapes splice(raster, arg) adds where the
+// document ends now, instead of text for them; what arg refers to must last until the sink is closed.
+void preset_sink_splice(PresetSink* sink, RasterSplice splice, void* arg);
+
+// Writes out and drops the parts of the chain when the sink streams; does nothing otherwise.
+// Whatever the parts refer to can be reused once it returns.
+// Returns 0 on success and -1 on failure.
+int8_t preset_sink_flush(PresetSink* sink);
+
+// Completes the output: writes what is left or rasterizes the document, on params->pool
+// when there is one. With a non zero status the render failed and a replaced file is left as it was.
+// Returns 0 on success and -1 on failure.
+int8_t preset_sink_close(PresetSink* sink, const RenderParams* params, int8_t status);
+
+// Writes everything left to read from fd to params->path, the way a sink writes a render:
+// regular files are replaced atomically, "-", params->fd and other files are written in place.
+// Returns 0 on success and -1 on failure.
+int8_t preset_sink_copy(const RenderParams* params, int fd);
+
+// Extension of the format params->path is rendered in: ".svg", ".svgz", ".png" or ".ppm".
+const char* preset_output_ext(const RenderParams* params);
+
+// Presets fill *hash with a hash of what they render from besides the params every preset
+// uses: their name, the preset file or script they read, and params such as the accents
+// that only they draw with. Return 0 on success and -1 if it cannot be read.
+typedef int8_t (*PresetContent)(const RenderParams* params, uint64_t* hash);
+
+// Hashes the name of a preset with the content of filename, or, when it is NULL, with
+// builtin, the hash of the copy built into the binary. Returns 0 on success and -1 on failure.
+int8_t preset_content_hash(const char* preset, const char* filename, uint64_t builtin, uint64_t* hash);
+
+// Bumped whenever a preset renders another file from the same params and content, so that
+// cached renders of an older version are never served.
+#define RENDER_CACHE_VERSION 4
+
+int8_t triogons(const RenderParams* params);
+int8_t triogons_content(const RenderParams* params, uint64_t* hash);
+
+// One of the sizes a wallpaper is rendered at, and the file it goes to (see RenderParams.path).
+typedef struct RenderSize {
+    uint16_t width;
+    uint16_t height;
+    const char* path;
+} RenderSize;
+
+// Presets that render the same wallpaper at every size of `sizes` in one call,
+// generating its shapes only once. Return 0 if every size succeeded and -1 otherwise.
+typedef int8_t (*PresetRenderSizes)(const RenderParams* params, const RenderSize sizes[], uint16_t count);
+
+// Triogons are created once in canvas independent coordinates, then fitted to each size:
+// rendering a size this way gives the same file as triogons() for that size.
+// The shapes are all held in memory until the last size is written.
+int8_t triogons_sizes(const RenderParams* params, const RenderSize sizes[], uint16_t count);
+
+// Renders params through cache, keyed on the content of the preset and every param but
+// the pool and the path: a hit is copied from its entry, a miss is rendered into a new
+// entry, then copied. With no cache, or one that cannot be written, render() writes the path itself.
+// Returns 0 on success and -1 on failure.
+int8_t preset_render_cached(Cache* cache, PresetRender render, PresetContent content, const RenderParams* params);
+
+// The same for the sizes of a wallpaper rendered in one call: the sizes found in the cache
+// are copied, the others rendered together. Returns 0 if every size succeeded and -1 otherwise.
+int8_t preset_render_sizes_cached(Cache* cache, PresetRenderSizes render_sizes, PresetContent content,
+    const RenderParams* params, const RenderSize sizes[], uint16_t count);
+
+// An animation: `frames` frames shown `fps` per second.
+typedef struct Animation {
+    uint32_t frames;
+    uint16_t fps;
+} Animation;
+
+typedef struct AnimationReport {
+    uint32_t frames;
+    uint64_t shapes;      // shapes drawn over all the frames.
+    uint64_t reformatted; // of those, the ones formatted again because they changed.
+    double seconds;
+} AnimationReport;
+
+// In an output path of an animation, replaced by the number of each frame, eg. "frames/{frame}.svg".
+#define ANIMATION_FRAME_KEY "{frame}"
+
+// Renders the triogons of params slowly drifting: every shape moves, turns and changes
+// hue a little each frame. Shapes stay in memory between frames and only the ones
+// whose output changes are formatted again. When params->path holds ANIMATION_FRAME_KEY
+// every frame is a document of its own, in directories created as needed, otherwise the whole animation is one SVG
+// animated with SMIL, held in memory until its last frame.
+// Frame 0 is the wallpaper triogons() renders from the same params.
+// Returns 0 on success and -1 on failure; report is filled either way.
+int8_t triogons_animate(const RenderParams* params, const Animation* animation, AnimationReport* report);
+int8_t sample(const RenderParams* params);
+int8_t sample_content(const RenderParams* params, uint64_t* hash);
+// Renders the preset script at params->script, see script.h.
+int8_t scripted(const RenderParams* params);
+// Compiles the script at filename ahead of its first render; it stays compiled in the process
+// and is reloaded by the renders that find its file changed. Returns 0 on success and -1 on failure.
+int8_t scripted_load(const char* filename);
+int8_t scripted_content(const RenderParams* params, uint64_t* hash);
+
+#endif
@@ -0,0 +1,96 @@
+/*
+A rasterizer for the SVG that the presets emit.
+It understands filled <rect>, <circle> and <path> elements (M, L, H, V, C and Z
+commands, absolute or relative) whose fill is a #rgb, #rrggbb, rgb(), rgba(), hsl()
+or hsla() colour, given as a fill attribute or in style, with fill-opacity; both
+are inherited from enclosing <g> elements. Colours are packed into 8-bit channels,
+as browsers do, hsl() ones by color_hsl() like the compact SVG writes them.
+Anything else, such as <text> or strokes, is skipped.
+Shapes can also be handed over as they are, outlines and packed colours, in the middle of
+a document: a preset rendering a bitmap then writes no text for them.
+
+Curves are flattened into line segments and filled with exact area coverage
+(nonzero rule), then blended in document order. The canvas is split into tiles
+that are rendered independently, on a thread pool when one is given.
+*/
+
+#ifndef __RASTER_H__
+#define __RASTER_H__
+
+#include <stdint.h>
+#include "color.h"
+#include "strings.h"
+
+typedef struct Pool Pool;
+
+// side of the square tiles the canvas is rendered in.
+#define RASTER_TILE 64
+
+typedef struct RasterEdge {
+    float x0, y0, x1, y1;
+} RasterEdge;
+
+typedef struct RasterShape {
+    uint32_t first;     // index of the first edge.
+    uint32_t count;
+    int32_t x0, y0;     // pixel bounds, clipped to the canvas; x1 and y1 excluded.
+    int32_t x1, y1;
+    Rgba color;         // see color.h; its alpha channel is not used.
+    float alpha;        // 0-1, of the colour and its fill-opacity.
+} RasterShape;
+
+typedef struct Raster {
+    uint16_t width;
+    uint16_t height;
+    float scale_x, scale_y;  // pixel = (user unit - origin) * scale, from the viewBox of the document.
+    float origin_x, origin_y;
+    uint8_t* pixels;         // width x height premultiplied RGBA, row by row.
+    uint64_t pixels_capacity;
+    RasterEdge* edges;
+    uint32_t edge_count;
+    uint32_t edge_capacity;
+    RasterShape* shapes;
+    uint32_t shape_count;
+    uint32_t shape_capacity;
+    // shapes touching tile t are bins[bin_start[t]] to bins[bin_start[t + 1]], in document order.
+    uint32_t* bins;
+    uint64_t bin_capacity;
+    uint32_t* bin_start;
+    uint32_t bin_start_capacity;
+    uint32_t next_tile;      // next tile to render, shared by the threads.
+} Raster;
+
+// Reads the canvas size and the shapes of an SVG document, replacing those of r.
+// The memory of r is reused between documents.
+// Returns 0 on success and -1 on malformed input or memory allocation failure.
+int8_t raster_parse_svg(Raster* r, StrView svg);
+
+// Adds shapes to r with raster_fill_cubics(), within a document being read.
+// Returns 0 on success and -1 on failure.
+typedef int8_t (*RasterSplice)(Raster* r, void* arg);
+
+// Reads svg as raster_parse_svg() does, with the shapes splice(r, arg) adds drawn as if
+// they were written at byte `at` of it. Returns 0 on success and -1 on failure.
+int8_t raster_parse_svg_spliced(Raster* r, StrView svg, uint64_t at, RasterSplice splice, void* arg);
+
+// Adds a closed path of `count` cubic curves from (x[0], y[0]), curve i running through
+// points 3i + 1 to 3i + 3, in the user units of the document, filled with color at its alpha.
+// Returns 0 on success and -1 on memory allocation failure.
+int8_t raster_fill_cubics(Raster* r, const float* x, const float* y, uint32_t count, Rgba color);
+
+// Fills the pixels of r with its shapes, over the pool's threads when pool is not NULL.
+// Returns 0 on success and -1 on memory allocation failure.
+int8_t raster_render(Raster* r, Pool* pool);
+
+// Appends the pixels as a binary PPM (P6), composited over black.
+// Returns 0 on success and -1 on memory allocation failure.
+int8_t raster_write_ppm(const Raster* r, StrBuilder* out);
+
+// Appends the pixels as an RGBA PNG.
+// Returns 0 on success and -1 on memory allocation failure.
+int8_t raster_write_png(const Raster* r, StrBuilder* out);
+
+// Frees the memory held by r.
+void raster_free(Raster* r);
+
+#endif
@@ -0,0 +1,39 @@
+/*
+A small, fast pseudo random number generator (xoshiro256**) with explicit state.
+Every render owns its Rng, so a wallpaper can be reproduced from its seed and
+renders on different threads never share state.
+*/
+
+#ifndef __RNG_H__
+#define __RNG_H__
+
+#include <stdint.h>
+
+typedef struct Rng {
+    uint64_t s[4];
+} Rng;
+
+// Initializes the state from a 64 bit seed. Any seed, including 0, is fine.
+void rng_seed(Rng* rng, uint64_t seed);
+
+// Returns the next 64 random bits.
+uint64_t rng_next(Rng* rng);
+
+// Returns a uniform float in [0, 1) using all 24 bits of mantissa.
+float rng_float(Rng* rng);
+
+// Returns a uniform integer in [0, n) without modulo bias; 0 when n is 0.
+uint32_t rng_below(Rng* rng, uint32_t n);
+
+// Fills out with n uniform floats between lo and hi, drawn in one tight loop.
+void rng_fill_range(Rng* rng, float* out, uint64_t n, float lo, float hi);
+
+// Derives an independent generator for `stream` from the parent's current state
+// without advancing the parent, so stream k is the same no matter which streams
+// were derived before it or on which thread.
+void rng_stream(const Rng* parent, uint64_t stream, Rng* out);
+
+// Advances the state by 2^128 steps, giving a non overlapping subsequence.
+void rng_jump(Rng* rng);
+
+#endif
@@ -0,0 +1,105 @@
+/*
+Preset scripts: presets that carry the logic that builds them, so that a new
+wallpaper needs no C code. A script is parsed and compiled once into a compact
+bytecode that a small stack machine runs against the shared string, formatting
+and random number primitives. Compiled scripts are cached on disk keyed by a hash
+of their source, so later launches skip parsing.
+
+A script is a header of declarations, a line holding only ---, and the document:
+
+    # bubbles, comments start with a hash.
+    let hue = random_range(0, 360)
+    def background = theme("#EEEEEE", "#121212")
+    def bubbles = svg_tags[density(40)](bubble)
+    def bubble = svg_tag("<circle cx=\"$x\" cy=\"$y\" r=\"$r\" fill=\"hsl($hue,50%,70%)\"/>")
+    def x = round(random_range(0, canvas_width))
+    def y = round(random_range(0, canvas_height))
+    def r = round(random_range(20, 80))
+    ---
+    <svg xmlns="http://www.w3.org/2000/svg" width="$canvas_width" height="$canvas_height">
+    <rect width="100%" height="100%" fill="$background"/>
+    $bubbles
+    </svg>
+
+`let` names a number evaluated once, at the start of a render, in declaration order;
+`def` names an expression evaluated again at every use, and compiled again too: a script
+whose defs expand to more than SCRIPT_MAX_CODE bytes of bytecode is rejected. $name in
+the document and in svg_tag() text writes the value of a declaration or a builtin.
+Expressions are numbers, "strings" (with \" \\ \n escapes), + - * / and parentheses on
+numbers, and the calls below, nested at most 256 deep:
+
+    canvas_width, canvas_height   size of the canvas.
+    density(n)                    the requested density, n when none was requested.
+    random_range(a, b)            uniform number in [a, b).
+    round(x)                      x rounded to the nearest integer.
+    theme(light, dark)            one of two values depending on the theme.
+    text(a, b, ...)               one of the values at random.
+    svg_tag("...")                text with $name placeholders.
+    svg_tags[n](x)                x written n times.
+
+Numbers are written with up to two decimals.
+*/
+
+#ifndef __SCRIPT_H__
+#define __SCRIPT_H__
+
+#include <stdint.h>
+#include "rng.h"
+#include "strings.h"
+
+// bumped whenever the bytecode changes, so that stale cache entries are ignored.
+#define SCRIPT_VERSION 1
+
+// limits the compiler enforces, so that the interpreter can run without bounds checks.
+#define SCRIPT_MAX_STACK 32
+#define SCRIPT_MAX_LETS 64
+#define SCRIPT_MAX_LOOPS 8
+// bytes of bytecode a script compiles to at most; every use of a def compiles its
+// expression again, so defs using each other can otherwise grow it exponentially.
+#define SCRIPT_MAX_CODE (1 << 20)
+
+typedef struct Script {
+    uint8_t* code;
+    uint32_t code_length;
+    double* numbers;     // constant pool.
+    uint16_t number_count;
+    char* text;          // literal text written by the code.
+    uint32_t text_length;
+    uint8_t let_count;
+} Script;
+
+typedef struct ScriptEnv {
+    uint16_t width;
+    uint16_t height;
+    int8_t dark;      // picks the second value of theme().
+    uint32_t density; // 0 lets the script pick.
+    Rng rng;
+    // called between repetitions of svg_tags[] once out holds more than SCRIPT_FLUSH_AT bytes,
+    // so that a streaming caller can write out and empty it. Optional.
+    int8_t (*flush)(void* ctx);
+    void* flush_ctx;
+} ScriptEnv;
+
+#define SCRIPT_FLUSH_AT (64 * 1024)
+
+// Parses and compiles source. name is only used in error messages.
+// Returns 0 on success and -1 on a syntax error or memory allocation failure.
+int8_t script_compile(Script* s, StrView source, const char* name);
+
+// Runs the script, appending the document to out.
+// Returns 0 on success and -1 on failure.
+int8_t script_run(const Script* s, ScriptEnv* env, StrBuilder* out);
+
+// Reads the script at filename, from the compiled copy in cache_dir when there is one that
+// matches its content; otherwise compiles it and stores the result there. A NULL
+// cache_dir disables the cache. Returns 0 on success and -1 on failure.
+int8_t script_load(Script* s, const char* filename, const char* cache_dir);
+
+// Returns the directory compiled scripts are cached in: $WOOTKAS_CACHE, or wootkas/ in
+// $XDG_CACHE_HOME or ~/.cache; NULL if none of them is set.
+const char* script_cache_dir(void);
+
+// Frees the memory held by the script and resets its fields.
+void script_free(Script* s);
+
+#endif
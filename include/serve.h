@@ -0,0 +1,40 @@
+/*
+A local HTTP server rendering wallpapers on demand, to preview presets in a browser or with curl:
+
+  GET /          this list, as plain text.
+  GET /render    renders a wallpaper; every parameter is optional:
+                 preset=NAME theme=lumos|noir size=WIDTHxHEIGHT seed=N density=N compact=1 format=svg|svgz|png
+                 accent=RRGGBB,...
+  GET /presets   the names of the presets, as a JSON array.
+  GET /stats     requests, renders and the p50, p99 and worst latency of both, as JSON.
+
+  curl -o preview.png 'http://127.0.0.1:8080/render?theme=noir&size=1920x1080&seed=7&format=png'
+
+It only listens on the loopback interface. One thread owns every connection and waits in
+epoll(7), renders run on the pool, so a slow render never holds up the other connections.
+Connections are kept alive and requests can be pipelined.
+*/
+
+#ifndef __SERVE_H__
+#define __SERVE_H__
+
+#include <signal.h>
+#include <stdint.h>
+#include "batch.h"
+
+typedef struct ServeOptions {
+    uint16_t port;              // 0 picks a free port; the one listened on is printed.
+    const BatchPreset* presets; // the first one renders requests that name none.
+    uint16_t preset_count;
+    Pool* pool;                 // optional; renders run on the server thread without one.
+    Cache* cache;               // optional, see preset_render_cached().
+    uint64_t seed;              // the seeds of requests that give none are drawn from it.
+    const Rgba* accents;        // of the requests that give none, see RenderParams.accents.
+    uint8_t accent_count;
+} ServeOptions;
+
+// Serves requests until one of `signals` (blocked by the caller in every thread) arrives.
+// Returns 0 on success and -1 if the server cannot be started.
+int8_t serve(const ServeOptions* options, const sigset_t* signals);
+
+#endif
@@ -0,0 +1,83 @@
+/*
+Lightweight instrumentation: monotonic-clock timers around the stages of a render
+and counters of what the String API allocates and the file I/O moves.
+Everything is process wide and updated with relaxed atomics, so that pool threads can record
+concurrently. Until stats_enable() is called every hook is a single predictable branch.
+*/
+
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <stdint.h>
+
+typedef struct StrBuilder StrBuilder;
+
+typedef enum {
+    STAT_RENDER,    // a whole preset render.
+    STAT_LOAD,      // reading and compiling a preset template.
+    STAT_SPLICE,    // filling the template slots, including the geometry and formatting below.
+    STAT_GEOMETRY,  // drawing and transforming shapes.
+    STAT_FORMAT,    // formatting shapes as SVG.
+    STAT_WRITE,     // encoding and writing the output file.
+    STAT_TIMER_COUNT
+} StatTimer;
+
+typedef enum {
+    STAT_STR_ALLOCS,      // allocations made by the String API, from the heap or an arena.
+    STAT_STR_HEAP_ALLOCS, // the part of them served by malloc()/realloc().
+    STAT_STR_BYTES,       // bytes requested by them.
+    STAT_FILE_READS,
+    STAT_READ_BYTES,
+    STAT_FILE_WRITES,
+    STAT_WRITE_BYTES,
+    STAT_COUNTER_COUNT
+} StatCounter;
+
+typedef struct StatTimerTotal {
+    uint64_t calls;
+    uint64_t ns;
+} StatTimerTotal;
+
+extern int8_t stats_enabled;
+extern StatTimerTotal stats_timers[STAT_TIMER_COUNT];
+extern uint64_t stats_counters[STAT_COUNTER_COUNT];
+
+// Starts recording. Call it before any thread that records is started.
+void stats_enable(void);
+
+// Nanoseconds of the monotonic clock.
+uint64_t stats_now(void);
+
+// Adds n to a counter.
+static inline void stats_add(StatCounter counter, uint64_t n) {
+    if (stats_enabled) __atomic_fetch_add(&stats_counters[counter], n, __ATOMIC_RELAXED);
+}
+
+typedef struct StatScope {
+    StatTimer timer;
+    uint64_t begin; // 0 when recording is off.
+} StatScope;
+
+static inline StatScope stats_scope_begin(StatTimer timer) {
+    return (StatScope){timer, stats_enabled ? stats_now() : 0};
+}
+
+static inline void stats_scope_end(StatScope* scope) {
+    if (scope->begin == 0) return;
+    __atomic_fetch_add(&stats_timers[scope->timer].calls, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats_timers[scope->timer].ns, stats_now() - scope->begin, __ATOMIC_RELAXED);
+}
+
+#define STATS_CONCAT_(a, b) a##b
+#define STATS_CONCAT(a, b) STATS_CONCAT_(a, b)
+
+// Times the rest of the enclosing block, however it is left, eg. { STATS_SCOPE(STAT_WRITE); ... }.
+// Stages running on several threads add up their times, so they can exceed the wall clock.
+#define STATS_SCOPE(timer) \
+    StatScope STATS_CONCAT(stats_scope_, __LINE__) __attribute__((cleanup(stats_scope_end))) = stats_scope_begin(timer)
+
+// Appends every timer and counter as a JSON object.
+// Returns 0 on success, -1 on failure.
+int8_t stats_append_json(StrBuilder* out);
+
+#endif
@@ -15,15 +15,80 @@ Started on: 11-11-2024
 #include <stdlib.h>
 #include <string.h>
 
+typedef struct Arena Arena;
+
 typedef struct String {
     char* str;
     uint64_t length;
 } String;
 
+// A borrowed, read-only run of characters. It never owns memory,
+// so making one costs nothing; it must not outlive what it points into.
+// Not necessarily null terminated.
+typedef struct StrView {
+    const char* str;
+    uint64_t length;
+} StrView;
+
+// Builds a StrView from a string literal at compile time, eg. STR_LIT("$THEME").
+#define STR_LIT(literal) ((StrView){"" literal, sizeof(literal) - 1})
+
+// An append-only buffer for assembling large outputs in linear time.
+// The buffer grows geometrically and is always kept null terminated.
+typedef struct StrBuilder {
+    char* str;
+    uint64_t length;
+    uint64_t capacity;
+} StrBuilder;
+
+// Views the content of a String.
+static inline StrView str_view(const String s) {
+    return (StrView){s.str, s.length};
+}
+
+// Views a null terminated char sequence.
+static inline StrView str_view_cstr(const char* s) {
+    return (StrView){s, (s != NULL) ? strlen(s) : 0};
+}
+
+// Views what has been built so far; the view is invalidated by the next append.
+static inline StrView str_builder_view(const StrBuilder* sb) {
+    return (StrView){sb->str, sb->length};
+}
+
+// A piece of a StrChain: a view into memory owned elsewhere when str is set,
+// otherwise `length` bytes at `offset` in the chain's own text.
+typedef struct StrChainPart {
+    const char* str;
+    uint64_t offset;
+    uint64_t length;
+} StrChainPart;
+
+// A document assembled from pieces that stay where they are, so that it can be
+// written out with writev(2) instead of being copied into one contiguous string first.
+// Generated text is appended to `text`; large buffers that already exist are referenced.
+typedef struct StrChain {
+    StrBuilder text;
+    StrChainPart* parts;
+    uint32_t count;
+    uint32_t capacity;
+    uint64_t flushed; // bytes of text already covered by parts.
+    uint64_t length;  // length of the document, once ended.
+} StrChain;
+
+// Makes the String API on the calling thread allocate from arena, or from the heap when NULL.
+// Returns the arena that was in use, so that it can be restored.
+// Strings allocated from an arena must not be used after the arena is reset;
+// freeing them is a no-op, heap strings can still be freed while an arena is in use.
+Arena* str_use_arena(Arena* arena);
+
 // The caller is responsible for freeing the memory.
 // Creates an instance of String type
 String str_from(const char* str);
 
+// Creates an owned copy of a view. The caller is responsible for freeing the memory.
+String str_from_view(StrView view);
+
 // Returns the char* from String.
 char* str_str(const String s);
 
@@ -31,19 +96,42 @@ char* str_str(const String s);
 uint64_t str_len(const String s);
 
 // Frees the memory allocated for a String object and resets its fields
+// The content is wiped before it is freed.
 void str_free(String* s);
 
+// Same as str_free() but skips wiping the content, for data that is not sensitive.
+void str_release(String* s);
+
 // Creates a substring (slice) from the specified start and end indices
 // Returns a new String containing the slice; caller must free it
-String str_slice(const String str, uint64_t start, uint64_t end);
+String str_slice(StrView str, uint64_t start, uint64_t end);
+
+// Same as str_slice() but returns a view into str instead of copying.
+// Returns an empty view if the indices are out of range.
+StrView str_slice_view(StrView str, uint64_t start, uint64_t end);
+
+// An Aho-Corasick automaton that finds any of a set of keys in a single pass.
+typedef struct StrMatcher {
+    uint8_t classes[256];  // maps each byte to its column in next; 0 for bytes in no key.
+    uint16_t class_count;
+    int32_t* next;         // state_count x class_count transition table.
+    int32_t* match;        // longest key ending in each state, -1 if none.
+    uint32_t* depth;       // length of the prefix each state stands for.
+    uint64_t* key_lengths;
+    uint32_t state_count;
+    uint16_t key_count;
+} StrMatcher;
+
+// Returns the index of the first occurrence of key at or after look_from; -1 otherwise.
+int64_t str_find(StrView str, uint64_t look_from, StrView key);
 
 // Returns number of occurances of key in str if key is in str; 0 otherwise.
-uint64_t str_key_frequency(const String str, const String key);
+uint64_t str_key_frequency(StrView str, StrView key);
 
 // Replaces all occurrences of `key` with `value` in `str`
 // Modifies `str` in place, resizing it as necessary; caller must free result
 // Returns 0 on success, -1 on failure and 2 if key is not in given str.
-int8_t str_replace_all(String* str, const String key, const String value);
+int8_t str_replace_all(String* str, StrView key, StrView value);
 
 // Returns -1 on failure or the ending position of current replacement on success.
 // ## Parameters: 
@@ -51,7 +139,22 @@ int8_t str_replace_all(String* str, const String key, const String value);
     // look_from: a starting position to search key.
     // key: String to be replaced.
     // value: String to replace.
-int64_t str_replace_next(String* str, uint64_t look_from, const String key, const String value);
+int64_t str_replace_next(String* str, uint64_t look_from, StrView key, StrView value);
+
+// Builds a matcher for the given keys. The keys are not referenced afterwards.
+// Returns 0 on success, -1 on failure; free it with str_matcher_free().
+int8_t str_matcher_build(StrMatcher* m, const StrView keys[], uint16_t key_count);
+
+// Returns the position of the leftmost match at or after look_from and stores the
+// index of the matched key in *key; the longest key wins a tie. Returns -1 if none is found.
+int64_t str_matcher_find(const StrMatcher* m, StrView str, uint64_t look_from, uint16_t* key);
+
+// Frees the memory held by a matcher.
+void str_matcher_free(StrMatcher* m);
+
+// Replaces every key of the matcher with values[key] in a single pass over `str`.
+// Returns 0 on success, -1 on failure and 2 if no key is in given str.
+int8_t str_replace_multi(String* str, const StrMatcher* m, const StrView values[]);
 
 // Returns a composed string, ie; works like sprintf(),
 // but returns the output as a string type.
@@ -62,4 +165,71 @@ String str_compose(const char *format, ...);
 // frees the memory allocated for String.
 void str_free(String* string);
 
+// Creates an empty builder with room for `capacity` bytes.
+// The caller is responsible for freeing it with str_builder_free() or str_builder_build().
+StrBuilder str_builder_new(uint64_t capacity);
+
+// Makes sure the builder can hold at least `capacity` bytes without reallocating.
+// Returns 0 on success, -1 on failure.
+int8_t str_builder_reserve(StrBuilder* sb, uint64_t capacity);
+
+// Grows the builder geometrically so that `additional` more bytes fit,
+// for writers that fill sb->str + sb->length directly and then bump sb->length.
+// Returns 0 on success, -1 on failure.
+int8_t str_builder_grow(StrBuilder* sb, uint64_t additional);
+
+// Appends n bytes of s to the builder.
+// Returns 0 on success, -1 on failure.
+int8_t str_builder_append_n(StrBuilder* sb, const char* s, uint64_t n);
+
+// Appends a String or any other view to the builder.
+int8_t str_builder_append(StrBuilder* sb, StrView s);
+
+// Appends a null terminated char sequence to the builder.
+int8_t str_builder_append_cstr(StrBuilder* sb, const char* s);
+
+// Works like sprintf(), but appends the output to the builder.
+// Returns 0 on success, -1 on format errors or memory allocation failure.
+int8_t str_builder_append_fmt(StrBuilder* sb, const char* format, ...);
+
+// Hands the built content over as a String and resets the builder.
+// The caller must free the returned String.
+String str_builder_build(StrBuilder* sb);
+
+// Frees the memory held by the builder and resets its fields.
+void str_builder_free(StrBuilder* sb);
+
+// Creates an empty chain with room for `capacity` bytes of generated text.
+// Like builders, chains allocate from the arena in use on the calling thread.
+StrChain str_chain_new(uint64_t capacity);
+
+// Adds a view to the chain without copying it; the memory must stay valid
+// and unchanged until the chain is no longer used.
+// Returns 0 on success, -1 on failure.
+int8_t str_chain_append_ref(StrChain* chain, StrView view);
+
+// Adds the text appended since the last part as a part of its own; call it
+// once the document is complete, before reading the parts.
+// Returns 0 on success, -1 on failure.
+int8_t str_chain_end(StrChain* chain);
+
+// Returns part i of an ended chain.
+static inline StrView str_chain_part(const StrChain* chain, uint32_t i) {
+    const StrChainPart* part = &chain->parts[i];
+    return (StrView){(part->str != NULL) ? part->str : chain->text.str + part->offset, part->length};
+}
+
+// Drops every part and the generated text but keeps the memory, eg. once the parts are written out.
+void str_chain_clear(StrChain* chain);
+
+// Copies an ended chain into one contiguous builder.
+// Returns 0 on success, -1 on failure.
+int8_t str_chain_join(const StrChain* chain, StrBuilder* out);
+
+// 64-bit FNV-1a hash of the bytes of str; stable across runs and machines, not cryptographic.
+uint64_t str_hash(StrView str);
+
+// Frees the memory held by the chain, not the memory it refers to, and resets its fields.
+void str_chain_free(StrChain* chain);
+
 #endif
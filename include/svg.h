@@ -0,0 +1,66 @@
+/*
+Emitters for the SVG elements the presets generate.
+They write straight into a StrBuilder through the fmt module, so a shape
+costs no intermediate strings and no printf calls.
+
+Paths have a compact form, for output that is stored and sent around: path data is made of
+relative commands with no spaces to spare, fills are #rrggbb (or #rgb) colours, and the
+fill-opacity the shapes share is set once on a group around them. Renderers draw it the
+same as the verbose form: the relative coordinates add up to exactly the absolute ones
+whenever those are integers, and the colours are the 8-bit ones renderers turn hsla() into.
+*/
+
+#ifndef __SVG_H__
+#define __SVG_H__
+
+#include <stdint.h>
+#include "color.h"
+#include "strings.h"
+
+typedef struct SvgPath {
+    StrBuilder* out;
+    uint8_t coord_precision; // decimals written for coordinates.
+    uint8_t color_precision; // decimals written for hue and alpha.
+    int8_t compact;          // writes the compact form.
+    float opacity;           // in the compact form, the fill-opacity of the enclosing group.
+    const Palette* palette;  // optional, what the fills are drawn from; their colours come from its tables.
+    int64_t x, y;            // current point, as written (see fmt_fixed_key()), for relative commands.
+    char command;            // last command written, which the compact form does not repeat.
+} SvgPath;
+
+// Writes an hsla() colour, eg. hsla(111.09,51%,68%,0.72).
+int8_t svg_hsla(StrBuilder* out, Hsla color, uint8_t precision);
+
+// Writes the colour svg_path_begin() fills with, in the form of p, eg. for animating it.
+// The compact form leaves the alpha to the group.
+int8_t svg_path_fill(SvgPath* p, Hsla fill);
+
+// Opens the group around compact paths, setting the fill-opacity they share, and closes it.
+int8_t svg_group_begin(StrBuilder* out, float opacity, uint8_t precision);
+int8_t svg_group_end(StrBuilder* out);
+
+// Opens a <path/> tag filled with the given colour and starts its data. In the compact form,
+// a fill whose alpha is not p->opacity sets its own fill-opacity.
+int8_t svg_path_begin(SvgPath* p, Hsla fill);
+
+// Starts a subpath at x,y.
+int8_t svg_path_move(SvgPath* p, float x, float y);
+
+// Adds a cubic bezier curve with control points x1,y1 and x2,y2 ending at x,y; relative
+// to the current point in the compact form.
+int8_t svg_path_cubic(SvgPath* p, float x1, float y1, float x2, float y2, float x, float y);
+
+// Closes the subpath and the <path/> tag.
+int8_t svg_path_close(SvgPath* p);
+
+// Closes the subpath but leaves the <path> element open, for animations to go in it;
+// svg_path_end() closes the element.
+int8_t svg_path_close_open(SvgPath* p);
+int8_t svg_path_end(SvgPath* p);
+
+// Writes an SMIL <animate/> of `attribute` that steps through `values` at `key_times`,
+// both separated by ';', over `seconds` and then starts over. Key times are fractions
+// of the duration, the first one 0.
+int8_t svg_animate(StrBuilder* out, StrView attribute, StrView key_times, StrView values, double seconds);
+
+#endif
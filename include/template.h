@@ -0,0 +1,79 @@
+/*
+Compiled preset templates.
+A preset is split once into literal segments and placeholder slots, so that
+rendering is a single pass over the segments with no searching for keys.
+*/
+
+#ifndef __TEMPLATE_H__
+#define __TEMPLATE_H__
+
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include "strings.h"
+
+// slot value of a segment that holds literal text.
+#define TEMPLATE_LITERAL -1
+
+typedef struct TemplateSegment {
+    uint64_t offset; // position of the segment in the template source.
+    uint64_t length;
+    int16_t slot;    // index of the matched key, or TEMPLATE_LITERAL.
+} TemplateSegment;
+
+typedef struct Template {
+    String source;
+    int8_t mapped;   // source was loaded by map_file() from the preset file, see unmap_file().
+    TemplateSegment* segments;
+    uint32_t count;
+    const StrView* keys;
+    uint16_t key_count;
+    // set by template_load(), used by template_refresh() to notice edits.
+    const char* filename;
+    struct timespec mtime;
+    uint64_t size;
+} Template;
+
+// Writes the value of `slot` into out.
+// Returns 0 on success, -1 on failure which aborts the render.
+typedef int8_t (*TemplateFill)(StrBuilder* out, uint16_t slot, void* ctx);
+
+// Splits source into literal segments and slots for the given keys.
+// The template takes ownership of source; keys must outlive the template.
+// Returns 0 on success and -1 on failure.
+int8_t template_compile(Template* t, String source, const StrView keys[], uint16_t key_count);
+
+// Maps and compiles the preset at filename; rendering reads the literal text straight
+// from the mapping. filename must outlive the template.
+// Returns 0 on success and -1 on failure.
+int8_t template_load(Template* t, const char* filename, const StrView keys[], uint16_t key_count);
+
+// Recompiles a loaded template if its file changed since it was loaded.
+// Loads it when the template is still empty.
+// Returns 0 if it is up to date, 1 if it was (re)loaded and -1 on failure.
+int8_t template_refresh(Template* t, const char* filename, const StrView keys[], uint16_t key_count);
+
+// Returns 1 if the template is empty or its file changed since it was loaded,
+// 0 if it is up to date and -1 on failure.
+int8_t template_stale(const Template* t);
+
+// Refreshes a template shared by several threads and returns holding lock for reading,
+// so that the template stays valid until the caller unlocks it.
+// Returns 0 on success and -1 on failure, in which case lock is not held.
+int8_t template_acquire(Template* t, pthread_rwlock_t* lock, const char* filename, const StrView keys[], uint16_t key_count);
+
+// Returns the total length of the literal text, useful to presize the output.
+uint64_t template_literal_length(const Template* t);
+
+// Appends the template to out, calling fill for each slot in document order.
+// Returns 0 on success and -1 on failure.
+int8_t template_render(const Template* t, StrBuilder* out, TemplateFill fill, void* ctx);
+
+// Same as template_render(), but the literal text is referenced rather than copied
+// and the slots are filled into chain->text. The chain must not outlive the template.
+int8_t template_render_chain(const Template* t, StrChain* chain, TemplateFill fill, void* ctx);
+
+// Frees the memory held by the template and resets its fields.
+void template_free(Template* t);
+
+#endif
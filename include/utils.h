@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <limits.h>
 
 // to toggle error messages.
 #define DEBUG 1
@@ -13,31 +14,83 @@
 #endif
 
 typedef struct String String;
+typedef struct StrView StrView;
+typedef struct StrChain StrChain;
+typedef struct Rng Rng;
 
 // Reads given character sequence file int *read_content.
 // Returns 0 on success and -1 on failures.
 int8_t read_file_content(const char* filename, String* read_content);
 
+// files smaller than this are read by map_file() instead of being mapped.
+#define MAP_FILE_MIN (256 * 1024)
+
+// Maps filename read-only into *content; the content must be released with unmap_file().
+// Reads nothing up front and copies nothing, pages are loaded as they are touched.
+// Files under MAP_FILE_MIN bytes, such as presets and scripts, are read into memory
+// instead, so that editing them in place never affects the content; larger ones must
+// not be truncated while they are mapped.
+// Returns 0 on success and -1 on failure.
+int8_t map_file(const char* filename, String* content);
+
+// Unmaps or frees what map_file() loaded and resets its fields.
+void unmap_file(String* content);
+
 // Writes given content to filename.
 // returns 0 on success and -1 on failure.
-int8_t write_to_file(const char* filename, const String content);
+int8_t write_to_file(const char* filename, StrView content);
+
+// Writes content to a temporary file next to filename, then renames it over filename.
+// Readers of filename see either the previous or the new content, never a partial file.
+// Allocates nothing. Returns 0 on success and -1 on failure.
+int8_t write_to_file_atomic(const char* filename, StrView content);
+
+// Writes all of content to fd, retrying short writes.
+// Returns 0 on success and -1 on failure.
+int8_t write_all(int fd, StrView content);
+
+// Writes everything left to read from `from` to fd, copied within the kernel by sendfile(2).
+// Returns 0 on success and -1 on failure.
+int8_t write_from_fd(int fd, int from);
+
+// Writes the parts of an ended chain to fd with writev(2), straight from where they are.
+// Returns 0 on success and -1 on failure.
+int8_t write_chain(int fd, const StrChain* chain);
+
+// A new version of a file, written to a temporary file next to it and renamed over it at the end.
+typedef struct AtomicFile {
+    int fd;
+    char tmp[PATH_MAX];
+} AtomicFile;
+
+// Creates the temporary file for a new version of filename, to be written through file->fd.
+// Returns 0 on success and -1 on failure.
+int8_t atomic_file_open(AtomicFile* file, const char* filename);
+
+// Closes the temporary file and, if status is 0, renames it over filename; removes it otherwise.
+// Returns 0 if filename was replaced and -1 on failure.
+int8_t atomic_file_commit(AtomicFile* file, const char* filename, int8_t status);
+
 
 
+// Creates the missing directories leading to path, which is modified in place and restored.
+// Returns 0 on success and -1 on failure.
+int8_t make_parents(char* path);
 
 // ### project specific definitions ###
 
-String hsv_to_rgb(float h, float s, float v);
-String greet();
+StrView greet();
 
-// returns a random number between x and y;
-float rand_range(float x, float y);
-String get_quote();
+// returns a random number between x and y, drawn from rng;
+float rand_range(Rng* rng, float x, float y);
+// returns a random quote, drawn from rng.
+StrView get_quote(Rng* rng);
 String num_to_str(int num);
 
 typedef struct {float x; float y;} Point;
 
-// generates random point between begin and end.
-Point rand_point(Point begin, Point end);
+// generates random point between begin and end, drawn from rng.
+Point rand_point(Rng* rng, Point begin, Point end);
 
 // Function to compute the centroid of the shape
 Point get_centroid(int row, int col, int C[][col]);
@@ -0,0 +1,92 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/arena.h"
+#include "../include/utils.h"
+
+#define ARENA_DEFAULT_BLOCK (64 * 1024)
+#define ARENA_ALIGN(n) (((n) + 15) & ~(uint64_t)15)
+
+static ArenaBlock* arena_block_new(uint64_t size) {
+  ArenaBlock* block = (ArenaBlock*)malloc(sizeof(ArenaBlock) + size);
+  if (block == NULL) {
+    DEBUG_PRINT("err! arena_block_new(): failed to allocate memory for block.\n");
+    return NULL;
+  }
+  block->next = NULL;
+  block->size = size;
+  block->used = 0;
+  return block;
+}
+
+void* arena_alloc(Arena* arena, uint64_t size) {
+  size = ARENA_ALIGN(size);
+
+  if (arena->current == NULL) {
+    if (arena->head == NULL) {
+      uint64_t block_size = (arena->block_size != 0) ? arena->block_size : ARENA_DEFAULT_BLOCK;
+      arena->head = arena_block_new((size > block_size) ? size : block_size);
+      if (arena->head == NULL) return NULL;
+    }
+    arena->current = arena->head;
+  }
+
+  // blocks that were used before a reset are reused in order before new ones are added.
+  while (arena->current->size - arena->current->used < size) {
+    ArenaBlock* next = arena->current->next;
+    if (next == NULL) {
+      uint64_t block_size = arena->current->size * 2;
+      next = arena_block_new((size > block_size) ? size : block_size);
+      if (next == NULL) return NULL;
+      arena->current->next = next;
+    }
+    next->used = 0;
+    arena->current = next;
+  }
+
+  void* ptr = arena->current->data + arena->current->used;
+  arena->current->used += size;
+  arena->last = ptr;
+  return ptr;
+}
+
+void* arena_realloc(Arena* arena, void* ptr, uint64_t old_size, uint64_t new_size) {
+  if (ptr == NULL) return arena_alloc(arena, new_size);
+
+  if (ptr == arena->last) {
+    ArenaBlock* block = arena->current;
+    uint64_t offset = (char*)ptr - block->data;
+    if (offset + ARENA_ALIGN(new_size) <= block->size) {
+      block->used = offset + ARENA_ALIGN(new_size);
+      return ptr;
+    }
+  }
+
+  void* moved = arena_alloc(arena, new_size);
+  if (moved == NULL) return NULL;
+  memcpy(moved, ptr, (old_size < new_size) ? old_size : new_size);
+  return moved;
+}
+
+int8_t arena_owns(const Arena* arena, const void* ptr) {
+  for (const ArenaBlock* block = arena->head; block != NULL; block = block->next) {
+    if ((const char*)ptr >= block->data && (const char*)ptr < block->data + block->size) return 1;
+  }
+  return 0;
+}
+
+void arena_reset(Arena* arena) {
+  arena->current = arena->head;
+  if (arena->head != NULL) arena->head->used = 0;
+  arena->last = NULL;
+}
+
+void arena_free(Arena* arena) {
+  ArenaBlock* block = arena->head;
+  while (block != NULL) {
+    ArenaBlock* next = block->next;
+    free(block);
+    block = next;
+  }
+  *arena = (Arena){NULL, NULL, arena->block_size, NULL};
+}
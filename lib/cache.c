@@ -0,0 +1,201 @@
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../include/cache.h"
+#include "../include/utils.h"
+
+#define CACHE_MAGIC "WKRC"
+// digits of the key at the start of an entry name.
+#define KEY_DIGITS 16
+
+// Takes the index for the calling thread, then for the process.
+static void lock_index(Cache* c) {
+  pthread_mutex_lock(&c->lock);
+  while (flock(c->index_fd, LOCK_EX) != 0 && errno == EINTR) {}
+}
+
+static void unlock_index(Cache* c) {
+  flock(c->index_fd, LOCK_UN);
+  pthread_mutex_unlock(&c->lock);
+}
+
+int8_t cache_entry_path(const Cache* c, uint64_t key, const char* ext, char path[PATH_MAX]) {
+  if (strlen(ext) >= CACHE_EXT_MAX) return -1;
+  const int n = snprintf(path, PATH_MAX, "%s/%016llx%s", c->dir, (unsigned long long)key, ext);
+  return (n > 0 && n < PATH_MAX) ? 0 : -1;
+}
+
+// Returns whether name is an entry, or a temporary file of one.
+static int8_t is_entry_name(const char* name) {
+  for (int i = 0; i < KEY_DIGITS; i++) {
+    if (!isxdigit((unsigned char)name[i]) || isupper((unsigned char)name[i])) return 0;
+  }
+  return name[KEY_DIGITS] == '.';
+}
+
+// Empties the index and removes every entry in the directory, which the index no longer knows.
+// Called with the index locked.
+static void reset_index(Cache* c) {
+  memset(c->index, 0, sizeof(CacheIndex));
+  memcpy(c->index->magic, CACHE_MAGIC, 4);
+  c->index->version = CACHE_INDEX_VERSION;
+
+  DIR* d = opendir(c->dir);
+  if (d == NULL) return;
+  const int dir_fd = dirfd(d);
+  for (struct dirent* entry = readdir(d); entry != NULL; entry = readdir(d)) {
+    if (is_entry_name(entry->d_name)) unlinkat(dir_fd, entry->d_name, 0);
+  }
+  closedir(d);
+}
+
+static int8_t index_valid(const CacheIndex* index) {
+  return memcmp(index->magic, CACHE_MAGIC, 4) == 0 && index->version == CACHE_INDEX_VERSION &&
+    index->count <= CACHE_MAX_ENTRIES;
+}
+
+int8_t cache_open(Cache* c, const char* dir, uint64_t max_bytes) {
+  *c = (Cache){.index_fd = -1, .max_bytes = max_bytes};
+  char path[PATH_MAX];
+  const int n = snprintf(path, sizeof(path), "%s/" CACHE_INDEX_FILE, dir);
+  if (n <= 0 || n >= (int)sizeof(path) || strlen(dir) >= sizeof(c->dir)) {
+    DEBUG_PRINT("err! cache_open(): the path of %s is too long.\n", dir);
+    return -1;
+  }
+  strcpy(c->dir, dir);
+  if (make_parents(path) != 0) return -1;
+
+  c->index_fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (c->index_fd == -1 || pthread_mutex_init(&c->lock, NULL) != 0) {
+    DEBUG_PRINT("err! cache_open(): failed to open %s.\n", path);
+    if (c->index_fd != -1) close(c->index_fd);
+    return -1;
+  }
+  int8_t status = -1;
+  lock_index(c);
+  struct stat st;
+  // a new index file is sized while locked, so every process maps it whole.
+  if (fstat(c->index_fd, &st) == 0 && (st.st_size == sizeof(CacheIndex) || ftruncate(c->index_fd, sizeof(CacheIndex)) == 0)) {
+    void* index = mmap(NULL, sizeof(CacheIndex), PROT_READ | PROT_WRITE, MAP_SHARED, c->index_fd, 0);
+    if (index != MAP_FAILED) {
+      c->index = index;
+      if (!index_valid(c->index)) reset_index(c);
+      status = 0;
+    }
+  }
+  unlock_index(c);
+  if (status != 0) {
+    DEBUG_PRINT("err! cache_open(): failed to map %s.\n", path);
+    pthread_mutex_destroy(&c->lock);
+    close(c->index_fd);
+    *c = (Cache){.index_fd = -1};
+  }
+  return status;
+}
+
+static uint32_t find_slot(const CacheIndex* index, uint64_t key) {
+  uint32_t i = 0;
+  while (i < index->count && index->slots[i].key != key) i++;
+  return i;
+}
+
+// Removes the entry of slot i and its file. Called with the index locked.
+static void remove_slot(Cache* c, uint32_t i) {
+  CacheIndex* index = c->index;
+  char path[PATH_MAX];
+  if (cache_entry_path(c, index->slots[i].key, index->slots[i].ext, path) == 0) unlink(path);
+  index->bytes -= (index->slots[i].bytes < index->bytes) ? index->slots[i].bytes : index->bytes;
+  index->slots[i] = index->slots[--index->count];
+}
+
+// Returns the least recently used slot other than `except`, count if there is none.
+static uint32_t oldest_slot(const CacheIndex* index, uint64_t except) {
+  uint32_t oldest = index->count;
+  for (uint32_t i = 0; i < index->count; i++) {
+    if (index->slots[i].key == except) continue;
+    if (oldest == index->count || index->slots[i].used < index->slots[oldest].used) oldest = i;
+  }
+  return oldest;
+}
+
+int8_t cache_lookup(Cache* c, uint64_t key, int* fd) {
+  *fd = -1;
+  lock_index(c);
+  CacheIndex* index = c->index;
+  const uint32_t i = find_slot(index, key);
+  if (i < index->count) {
+    // opened with the index locked, so that the entry cannot be evicted in between.
+    char path[PATH_MAX];
+    if (cache_entry_path(c, key, index->slots[i].ext, path) == 0) *fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (*fd != -1) index->slots[i].used = ++index->clock;
+    else remove_slot(c, i); // removed from the outside.
+  }
+  CacheCounters* counts[2] = {&index->counters, &c->counters};
+  for (int k = 0; k < 2; k++) {
+    if (*fd != -1) counts[k]->hits++;
+    else counts[k]->misses++;
+  }
+  unlock_index(c);
+  return (*fd != -1) ? 0 : -1;
+}
+
+int8_t cache_insert(Cache* c, uint64_t key, const char* ext) {
+  char path[PATH_MAX];
+  struct stat st;
+  if (cache_entry_path(c, key, ext, path) != 0 || stat(path, &st) != 0) {
+    DEBUG_PRINT("err! cache_insert(): no entry %016llx%s to insert.\n", (unsigned long long)key, ext);
+    return -1;
+  }
+  lock_index(c);
+  CacheIndex* index = c->index;
+  uint32_t i = find_slot(index, key);
+  // another process may have rendered the same entry meanwhile, it is replaced.
+  if (i < index->count) {
+    index->bytes -= (index->slots[i].bytes < index->bytes) ? index->slots[i].bytes : index->bytes;
+  } else {
+    if (index->count == CACHE_MAX_ENTRIES) {
+      remove_slot(c, oldest_slot(index, key));
+      index->counters.evictions++;
+      c->counters.evictions++;
+    }
+    i = index->count++;
+  }
+  index->slots[i] = (CacheSlot){key, (uint64_t)st.st_size, ++index->clock, {0}};
+  strcpy(index->slots[i].ext, ext);
+  index->bytes += st.st_size;
+  index->counters.inserts++;
+  c->counters.inserts++;
+
+  while (index->bytes > c->max_bytes) {
+    const uint32_t oldest = oldest_slot(index, key);
+    if (oldest == index->count) break;
+    remove_slot(c, oldest);
+    index->counters.evictions++;
+    c->counters.evictions++;
+  }
+  unlock_index(c);
+  return 0;
+}
+
+void cache_counters(Cache* c, CacheCounters* own, CacheCounters* all) {
+  lock_index(c);
+  *own = c->counters;
+  *all = c->index->counters;
+  unlock_index(c);
+}
+
+void cache_close(Cache* c) {
+  if (c->index != NULL) munmap(c->index, sizeof(CacheIndex));
+  if (c->index_fd != -1) {
+    close(c->index_fd);
+    pthread_mutex_destroy(&c->lock);
+  }
+  *c = (Cache){.index_fd = -1};
+}
@@ -0,0 +1,226 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "../include/color.h"
+#include "../include/fmt.h"
+#include "../include/rng.h"
+#include "../include/utils.h"
+
+// Channels are worked out exactly in units of 1 / CHANNEL_SCALE: hundredths of a percent
+// squared, times 12000 so that the sixths of the hue and the halves of the chroma stay whole.
+#define CHANNEL_SCALE 1200000000000LL
+
+static int32_t clamp_percent(int32_t v) {
+  return (v < 0) ? 0 : (v > 10000) ? 10000 : v;
+}
+
+// Rounds the three channels the hue picks out of chroma and offset (see palette_cell())
+// to 8 bits; halves round up, as there are no negative values.
+static Rgba hue_channels(int32_t hue, int64_t chroma, int64_t offset, uint8_t alpha) {
+  hue %= 36000;
+  if (hue < 0) hue += 36000;
+  const int32_t sector = hue / 6000, within = hue % 6000;
+  const int64_t c = chroma * 12000;
+  // the second largest channel rises over even sectors and falls over odd ones.
+  const int64_t x = chroma * 2 * ((sector & 1) ? 6000 - within : within);
+  int64_t channels[3] = {0, 0, 0};
+  switch (sector) {
+    case 0: channels[0] = c; channels[1] = x; break;
+    case 1: channels[0] = x; channels[1] = c; break;
+    case 2: channels[1] = c; channels[2] = x; break;
+    case 3: channels[1] = x; channels[2] = c; break;
+    case 4: channels[0] = x; channels[2] = c; break;
+    default: channels[0] = c; channels[2] = x; break;
+  }
+  uint8_t rgb[3];
+  for (int i = 0; i < 3; i++) rgb[i] = (uint8_t)((255 * (channels[i] + offset) + CHANNEL_SCALE / 2) / CHANNEL_SCALE);
+  return RGBA(rgb[0], rgb[1], rgb[2], alpha);
+}
+
+// Chroma, in hundredths of a percent squared, and the offset added to every channel,
+// already scaled, of an HSL saturation and lightness.
+static PaletteCell palette_cell(int32_t saturation, int32_t lightness) {
+  const int64_t chroma = (int64_t)(10000 - abs(2 * lightness - 10000)) * saturation;
+  return (PaletteCell){chroma, (int64_t)lightness * 10000 * 12000 - chroma * 6000};
+}
+
+Rgba color_hsl(int32_t hue, int32_t saturation, int32_t lightness, uint8_t alpha) {
+  const PaletteCell cell = palette_cell(clamp_percent(saturation), clamp_percent(lightness));
+  return hue_channels(hue, cell.chroma, cell.offset, alpha);
+}
+
+Rgba color_hsv(int32_t hue, int32_t saturation, int32_t value, uint8_t alpha) {
+  value = clamp_percent(value);
+  const int64_t chroma = (int64_t)value * clamp_percent(saturation);
+  return hue_channels(hue, chroma, (int64_t)value * 10000 * 12000 - chroma * 12000, alpha);
+}
+
+// The hue c is written with, in hundredths of a degree.
+static int32_t hue_key(float h, uint8_t precision) {
+  int64_t key = fmt_fixed_key(h, precision);
+  if (precision < 2) {
+    for (uint8_t i = precision; i < 2; i++) key *= 10;
+  } else {
+    int64_t unit = 1;
+    for (uint8_t i = 2; i < precision; i++) unit *= 10;
+    key = (key >= 0) ? (key + unit / 2) / unit : -((-key + unit / 2) / unit);
+  }
+  key %= 36000;
+  return (int32_t)key;
+}
+
+// The alpha a is written with, in 8 bits.
+static uint8_t alpha_byte(float a, uint8_t precision) {
+  int64_t unit = 1;
+  for (uint8_t i = 0; i < precision; i++) unit *= 10;
+  const int64_t key = fmt_fixed_key(a, precision);
+  if (key <= 0) return 0;
+  if (key >= unit) return 255;
+  return (uint8_t)((key * 255 + unit / 2) / unit);
+}
+
+Rgba color_from_hsla(Hsla c, uint8_t precision) {
+  const int32_t s = (int32_t)fmt_fixed_key(fminf(fmaxf(c.s, 0), 100), 0) * 100;
+  const int32_t l = (int32_t)fmt_fixed_key(fminf(fmaxf(c.l, 0), 100), 0) * 100;
+  return color_hsl(hue_key(c.h, precision), s, l, alpha_byte(c.a, precision));
+}
+
+int32_t color_hue(Rgba c) {
+  const int32_t r = rgba_red(c), g = rgba_green(c), b = rgba_blue(c);
+  const int32_t max = (r > g) ? ((r > b) ? r : b) : ((g > b) ? g : b);
+  const int32_t min = (r < g) ? ((r < b) ? r : b) : ((g < b) ? g : b);
+  const int32_t delta = max - min;
+  if (delta == 0) return 0;
+  // truncated to the hundredth of a degree, which is as close as hues are written.
+  int32_t hue;
+  if (max == r) hue = 6000 * (g - b) / delta;
+  else if (max == g) hue = 12000 + 6000 * (b - r) / delta;
+  else hue = 24000 + 6000 * (r - g) / delta;
+  return (hue < 0) ? hue + 36000 : hue;
+}
+
+int8_t color_hex(StrBuilder* out, Rgba c) {
+  static const char HEX[] = "0123456789abcdef";
+  const uint8_t rgb[3] = {rgba_red(c), rgba_green(c), rgba_blue(c)};
+  if (str_builder_grow(out, 8) != 0) return -1;
+  const int8_t doubled = rgb[0] % 17 == 0 && rgb[1] % 17 == 0 && rgb[2] % 17 == 0;
+  out->str[out->length++] = '#';
+  for (int i = 0; i < 3; i++) {
+    if (doubled) {
+      out->str[out->length++] = HEX[rgb[i] / 17];
+    } else {
+      out->str[out->length++] = HEX[rgb[i] >> 4];
+      out->str[out->length++] = HEX[rgb[i] & 0xF];
+    }
+  }
+  out->str[out->length] = '\0';
+  return 0;
+}
+
+static int hex_digit(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+int8_t color_parse_hex(StrView text, Rgba* c) {
+  if (text.length > 0 && text.str[0] == '#') text.str++, text.length--;
+  if (text.length != 3 && text.length != 6) return -1;
+  uint8_t rgb[3];
+  const uint64_t digits = text.length / 3;
+  for (int i = 0; i < 3; i++) {
+    const int high = hex_digit(text.str[i * digits]);
+    const int low = hex_digit(text.str[i * digits + digits - 1]);
+    if (high < 0 || low < 0) return -1;
+    rgb[i] = (uint8_t)(high * 16 + low);
+  }
+  *c = RGBA(rgb[0], rgb[1], rgb[2], 255);
+  return 0;
+}
+
+int8_t color_parse_hex_list(StrView list, Rgba colors[], uint8_t capacity, uint8_t* count) {
+  *count = 0;
+  // every colour, the first included, is read after a separator or the start of the list,
+  // so an empty list and a trailing comma both end with an empty, malformed colour.
+  for (;;) {
+    const char* comma = memchr(list.str, ',', list.length);
+    const uint64_t n = (comma != NULL) ? (uint64_t)(comma - list.str) : list.length;
+    if (*count == capacity || color_parse_hex((StrView){list.str, n}, &colors[*count]) != 0) {
+      DEBUG_PRINT("err! color_parse_hex_list(): '%.*s' is not a #rrggbb colour or one too many.\n", (int)n, list.str);
+      return -1;
+    }
+    (*count)++;
+    if (comma == NULL) return 0;
+    list.str += n + 1;
+    list.length -= n + 1;
+  }
+}
+
+int8_t palette_init(Palette* p, PaletteSpec spec) {
+  *p = (Palette){.spec = spec};
+  if (spec.lightness_min >= spec.lightness_max || spec.saturation_min >= spec.saturation_max ||
+      spec.lightness_max > 101 || spec.saturation_max > 101) {
+    DEBUG_PRINT("err! palette_init(): empty or out of range palette.\n");
+    return -1;
+  }
+  const uint32_t lightness_count = spec.lightness_max - spec.lightness_min;
+  const uint32_t saturation_count = spec.saturation_max - spec.saturation_min;
+  p->owned = (PaletteCell*)malloc(lightness_count * saturation_count * sizeof(PaletteCell));
+  if (p->owned == NULL) {
+    DEBUG_PRINT("err! palette_init(): failed to allocate memory for the tables.\n");
+    return -1;
+  }
+  for (uint32_t s = 0; s < saturation_count; s++) {
+    for (uint32_t l = 0; l < lightness_count; l++) {
+      p->owned[s * lightness_count + l] = palette_cell((spec.saturation_min + s) * 100, (spec.lightness_min + l) * 100);
+    }
+  }
+  p->cells = p->owned;
+  return 0;
+}
+
+int8_t palette_parse_accents(StrView list, Rgba accents[PALETTE_MAX_ACCENTS], uint8_t* count) {
+  if (color_parse_hex_list(list, accents, PALETTE_MAX_ACCENTS, count) != 0) return -1;
+  for (uint8_t i = 0; i < *count; i++) {
+    if (rgba_red(accents[i]) == rgba_green(accents[i]) && rgba_green(accents[i]) == rgba_blue(accents[i])) {
+      DEBUG_PRINT("err! palette_parse_accents(): accent %d is grey, it has no hue.\n", i + 1);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+void palette_accented(Palette* p, const Palette* base, const Rgba accents[], uint8_t count) {
+  *p = (Palette){.spec = base->spec, .cells = base->cells};
+  for (uint8_t i = 0; i < count && i < PALETTE_MAX_ACCENTS; i++) p->accents[p->accent_count++] = color_hue(accents[i]);
+}
+
+Hsla palette_draw(const Palette* p, Rng* rng) {
+  const int lightness = (int)rand_range(rng, p->spec.lightness_min, p->spec.lightness_max);
+  const int saturation = (int)rand_range(rng, p->spec.saturation_min, p->spec.saturation_max);
+  float hue;
+  if (p->accent_count == 0) {
+    hue = rand_range(rng, 0, 360);
+  } else {
+    const uint32_t accent = (p->accent_count > 1) ? rng_below(rng, p->accent_count) : 0;
+    hue = fmodf(p->accents[accent] / 100.0f + rand_range(rng, -PALETTE_ACCENT_SPREAD, PALETTE_ACCENT_SPREAD) + 360, 360);
+  }
+  return (Hsla){hue, saturation, lightness, p->spec.alpha};
+}
+
+Rgba palette_rgba(const Palette* p, Hsla c, uint8_t precision) {
+  const int64_t s = fmt_fixed_key(c.s, 0), l = fmt_fixed_key(c.l, 0);
+  // the colours the palette does not draw, eg. ones an animation has changed, are converted.
+  if (s < p->spec.saturation_min || s >= p->spec.saturation_max || l < p->spec.lightness_min || l >= p->spec.lightness_max) {
+    return color_from_hsla(c, precision);
+  }
+  const uint32_t lightness_count = p->spec.lightness_max - p->spec.lightness_min;
+  const PaletteCell cell = p->cells[(s - p->spec.saturation_min) * lightness_count + (l - p->spec.lightness_min)];
+  return hue_channels(hue_key(c.h, precision), cell.chroma, cell.offset, alpha_byte(c.a, precision));
+}
+
+void palette_free(Palette* p) {
+  free(p->owned);
+  *p = (Palette){0};
+}
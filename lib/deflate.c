@@ -0,0 +1,452 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "../include/deflate.h"
+#include "../include/strings.h"
+#include "../include/utils.h"
+
+static uint32_t crc_table[256];
+static pthread_once_t crc_table_once = PTHREAD_ONCE_INIT;
+
+static void crc_table_build(void) {
+  for (uint32_t n = 0; n < 256; n++) {
+    uint32_t c = n;
+    for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+    crc_table[n] = c;
+  }
+}
+
+uint32_t crc32_update(uint32_t crc, const uint8_t* data, uint64_t length) {
+  pthread_once(&crc_table_once, crc_table_build);
+  crc = ~crc;
+  for (uint64_t i = 0; i < length; i++) crc = crc_table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+  return ~crc;
+}
+
+uint32_t adler32_update(uint32_t adler, const uint8_t* data, uint64_t length) {
+  // 5552 is the longest run whose sums cannot overflow 32 bits before the modulo.
+  const uint32_t mod = 65521;
+  uint32_t a = adler & 0xFFFF, b = adler >> 16;
+  while (length > 0) {
+    uint64_t run = (length < 5552) ? length : 5552;
+    length -= run;
+    while (run--) {
+      a += *data++;
+      b += a;
+    }
+    a %= mod;
+    b %= mod;
+  }
+  return (b << 16) | a;
+}
+
+// shortest and longest matches deflate can code.
+#define MIN_MATCH 3
+#define MAX_MATCH 258
+#define HASH_BITS 15
+// candidates tried per position; longer chains find longer matches, slowly.
+#define MAX_CHAIN 32
+#define END_OF_BLOCK 256
+// codes of the literal/length alphabet; the fixed code also has 286 and 287, which never occur.
+#define FIXED_LIT_CODES 288
+// code lengths of the code lengths of a dynamic block, and the longest of them.
+#define LEN_CODES 19
+#define MAX_LEN_BITS 7
+#define MAX_BITS 15
+
+static const uint16_t length_base[29] = {
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t length_extra[29] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t dist_base[GZIP_DIST_CODES] = {
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537,
+  2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t dist_extra[GZIP_DIST_CODES] = {
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+// order the code lengths of the code length code are sent in.
+static const uint8_t length_order[LEN_CODES] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+// the fixed Huffman codes, bit reversed since deflate packs codes from their most significant bit.
+static uint16_t fixed_lit_code[FIXED_LIT_CODES];
+static uint8_t fixed_lit_bits[FIXED_LIT_CODES];
+static uint16_t fixed_dist_code[GZIP_DIST_CODES];
+static uint8_t fixed_dist_bits[GZIP_DIST_CODES];
+// length - MIN_MATCH to its length code, minus 257.
+static uint8_t length_code[MAX_MATCH - MIN_MATCH + 1];
+// distance - 1 to its distance code: below 256 directly, then by 128s from 256 on.
+static uint8_t dist_code[512];
+static pthread_once_t codes_once = PTHREAD_ONCE_INIT;
+
+static uint16_t reverse_bits(uint16_t code, uint8_t bits) {
+  uint16_t r = 0;
+  for (uint8_t i = 0; i < bits; i++, code >>= 1) r = (r << 1) | (code & 1);
+  return r;
+}
+
+static void codes_build(void) {
+  for (int v = 0; v < FIXED_LIT_CODES; v++) {
+    // RFC 1951 3.2.6.
+    if (v < 144) fixed_lit_bits[v] = 8, fixed_lit_code[v] = reverse_bits(0x30 + v, 8);
+    else if (v < 256) fixed_lit_bits[v] = 9, fixed_lit_code[v] = reverse_bits(0x190 + v - 144, 9);
+    else if (v < 280) fixed_lit_bits[v] = 7, fixed_lit_code[v] = reverse_bits(v - 256, 7);
+    else fixed_lit_bits[v] = 8, fixed_lit_code[v] = reverse_bits(0xC0 + v - 280, 8);
+  }
+  for (uint8_t c = 0; c < GZIP_DIST_CODES; c++) {
+    fixed_dist_code[c] = reverse_bits(c, 5);
+    fixed_dist_bits[c] = 5;
+  }
+  for (uint8_t c = 0; c < 29; c++) {
+    // 258 has a code of its own, though 227 + 31 reaches it too.
+    const uint16_t last = (c + 1 < 29) ? length_base[c + 1] - 1 : MAX_MATCH;
+    for (uint16_t len = length_base[c]; len <= last && len <= MAX_MATCH; len++) length_code[len - MIN_MATCH] = c;
+  }
+  for (uint8_t c = 0; c < GZIP_DIST_CODES; c++) {
+    const uint32_t last = (c + 1 < GZIP_DIST_CODES) ? dist_base[c + 1] - 1u : GZIP_WINDOW;
+    for (uint32_t d = dist_base[c]; d <= last; d++) {
+      if (d <= 256) dist_code[d - 1] = c;
+      else dist_code[256 + ((d - 1) >> 7)] = c;
+    }
+  }
+}
+
+static inline uint8_t dist_code_of(uint32_t dist) {
+  return (dist <= 256) ? dist_code[dist - 1] : dist_code[256 + ((dist - 1) >> 7)];
+}
+
+// Appends count bits of code to the output, whose room was grown beforehand.
+static inline void put_bits(Gzip* g, uint32_t code, uint8_t count) {
+  g->bits |= (uint64_t)code << g->bit_count;
+  g->bit_count += count;
+  if (g->bit_count >= 32) {
+    uint8_t* out = (uint8_t*)g->out->str + g->out->length;
+    for (int i = 0; i < 4; i++) out[i] = (g->bits >> (8 * i)) & 0xFF;
+    g->out->length += 4;
+    g->bits >>= 32;
+    g->bit_count -= 32;
+  }
+}
+
+// Fills lengths with those of a Huffman code for the count symbols of freq, none longer than
+// max_bits; unused symbols get none. At least two symbols get a code, so that the code is complete.
+static void build_lengths(const uint32_t* freq, uint16_t count, uint8_t max_bits, uint8_t* lengths) {
+  uint32_t f[GZIP_LIT_CODES];
+  uint16_t used = 0;
+  for (uint16_t i = 0; i < count; i++) used += (f[i] = freq[i]) != 0;
+  for (uint16_t i = 0; used < 2; i++) {
+    if (f[i] == 0) f[i] = 1, used++;
+  }
+  // leaves sorted by weight, then the inner nodes, made in order of weight too; parents come after their children.
+  uint16_t order[GZIP_LIT_CODES];
+  uint32_t weight[2 * GZIP_LIT_CODES];
+  uint16_t parent[2 * GZIP_LIT_CODES];
+  uint8_t depth[2 * GZIP_LIT_CODES];
+  for (;;) {
+    uint16_t n = 0;
+    for (uint16_t i = 0; i < count; i++) {
+      if (f[i] == 0) continue;
+      uint16_t k = n++;
+      for (; k > 0 && f[order[k - 1]] > f[i]; k--) order[k] = order[k - 1];
+      order[k] = i;
+    }
+    for (uint16_t i = 0; i < n; i++) weight[i] = f[order[i]];
+    uint16_t leaf = 0, node = n;
+    for (uint16_t next = n; next < 2 * n - 1; next++) {
+      uint16_t pick[2];
+      for (int k = 0; k < 2; k++) pick[k] = (leaf < n && (node == next || weight[leaf] <= weight[node])) ? leaf++ : node++;
+      weight[next] = weight[pick[0]] + weight[pick[1]];
+      parent[pick[0]] = parent[pick[1]] = next;
+    }
+    uint8_t longest = 0;
+    depth[2 * n - 2] = 0;
+    for (int i = 2 * n - 3; i >= 0; i--) {
+      depth[i] = depth[parent[i]] + 1;
+      if (i < n && depth[i] > longest) longest = depth[i];
+    }
+    if (longest <= max_bits) {
+      memset(lengths, 0, count);
+      for (uint16_t i = 0; i < n; i++) lengths[order[i]] = depth[i];
+      return;
+    }
+    // flatter weights make a shallower tree, halving them until it fits costs little.
+    for (uint16_t i = 0; i < count; i++) f[i] = (f[i] + 1) / 2;
+  }
+}
+
+// Fills codes with the canonical code of lengths, bit reversed.
+static void build_codes(const uint8_t* lengths, uint16_t count, uint16_t* codes) {
+  uint16_t bl_count[MAX_BITS + 1] = {0}, next[MAX_BITS + 1];
+  for (uint16_t i = 0; i < count; i++) bl_count[lengths[i]]++;
+  bl_count[0] = 0;
+  uint16_t code = 0;
+  for (uint8_t bits = 1; bits <= MAX_BITS; bits++) next[bits] = code = (code + bl_count[bits - 1]) << 1;
+  for (uint16_t i = 0; i < count; i++) {
+    if (lengths[i] != 0) codes[i] = reverse_bits(next[lengths[i]]++, lengths[i]);
+  }
+}
+
+// Codes the code lengths of a dynamic block as code length symbols, with the repeat counts
+// of symbols 16, 17 and 18 in extras. Returns the number of symbols.
+static uint16_t rle_lengths(const uint8_t* lengths, uint16_t count, uint8_t* syms, uint8_t* extras) {
+  uint16_t n = 0;
+  for (uint16_t i = 0; i < count;) {
+    const uint8_t len = lengths[i];
+    uint16_t run = 1;
+    while (i + run < count && lengths[i + run] == len) run++;
+    i += run;
+    if (len == 0) {
+      for (; run >= 11; n++) {
+        const uint16_t r = (run < 138) ? run : 138;
+        syms[n] = 18, extras[n] = r - 11, run -= r;
+      }
+      if (run >= 3) syms[n] = 17, extras[n++] = run - 3, run = 0;
+    } else {
+      syms[n] = len, extras[n++] = 0, run--;
+      for (; run >= 3; n++) {
+        const uint16_t r = (run < 6) ? run : 6;
+        syms[n] = 16, extras[n] = r - 3, run -= r;
+      }
+    }
+    for (; run > 0; run--) syms[n] = len, extras[n++] = 0;
+  }
+  return n;
+}
+
+// Codes the symbols gathered since the last block as one block, with Huffman codes built
+// for them or with the fixed ones, whichever is shorter.
+static int8_t gzip_block(Gzip* g, uint8_t final) {
+  static const uint8_t repeat_bits[LEN_CODES] = {[16] = 2, [17] = 3, [18] = 7};
+  g->lit_freq[END_OF_BLOCK]++;
+  uint8_t lit_len[GZIP_LIT_CODES], dist_len[GZIP_DIST_CODES];
+  build_lengths(g->lit_freq, GZIP_LIT_CODES, MAX_BITS, lit_len);
+  build_lengths(g->dist_freq, GZIP_DIST_CODES, MAX_BITS, dist_len);
+  uint16_t hlit = GZIP_LIT_CODES, hdist = GZIP_DIST_CODES;
+  while (hlit > 257 && lit_len[hlit - 1] == 0) hlit--;
+  while (hdist > 1 && dist_len[hdist - 1] == 0) hdist--;
+  // the two sets of lengths are run-length coded as one.
+  uint8_t lengths[GZIP_LIT_CODES + GZIP_DIST_CODES];
+  memcpy(lengths, lit_len, hlit);
+  memcpy(lengths + hlit, dist_len, hdist);
+
+  uint8_t syms[GZIP_LIT_CODES + GZIP_DIST_CODES], extras[GZIP_LIT_CODES + GZIP_DIST_CODES];
+  const uint16_t sym_count = rle_lengths(lengths, hlit + hdist, syms, extras);
+  uint32_t len_freq[LEN_CODES] = {0};
+  for (uint16_t i = 0; i < sym_count; i++) len_freq[syms[i]]++;
+  uint8_t len_len[LEN_CODES];
+  build_lengths(len_freq, LEN_CODES, MAX_LEN_BITS, len_len);
+  uint8_t hclen = LEN_CODES;
+  while (hclen > 4 && len_len[length_order[hclen - 1]] == 0) hclen--;
+
+  // both codes spend the same extra bits on the symbols, only the codes are compared.
+  uint64_t dynamic = 5 + 5 + 4 + 3 * hclen, fixed = 0;
+  for (uint16_t i = 0; i < sym_count; i++) dynamic += len_len[syms[i]] + repeat_bits[syms[i]];
+  for (uint16_t i = 0; i < GZIP_LIT_CODES; i++) {
+    dynamic += (uint64_t)g->lit_freq[i] * lit_len[i];
+    fixed += (uint64_t)g->lit_freq[i] * fixed_lit_bits[i];
+  }
+  for (uint16_t i = 0; i < GZIP_DIST_CODES; i++) {
+    dynamic += (uint64_t)g->dist_freq[i] * dist_len[i];
+    fixed += (uint64_t)g->dist_freq[i] * fixed_dist_bits[i];
+  }
+  // a match takes at most 48 bits, the header less than 400 bytes.
+  if (str_builder_grow(g->out, (uint64_t)g->token_count * 6 + 512) != 0) return -1;
+
+  uint16_t lit_codes[GZIP_LIT_CODES], dist_codes[GZIP_DIST_CODES];
+  const uint16_t* lcode = fixed_lit_code;
+  const uint8_t* lbits = fixed_lit_bits;
+  const uint16_t* dcode = fixed_dist_code;
+  const uint8_t* dbits = fixed_dist_bits;
+  if (dynamic < fixed) {
+    uint16_t len_codes[LEN_CODES];
+    build_codes(lit_len, GZIP_LIT_CODES, lit_codes);
+    build_codes(dist_len, GZIP_DIST_CODES, dist_codes);
+    build_codes(len_len, LEN_CODES, len_codes);
+    put_bits(g, final | (2 << 1), 3);
+    put_bits(g, hlit - 257, 5);
+    put_bits(g, hdist - 1, 5);
+    put_bits(g, hclen - 4, 4);
+    for (uint8_t k = 0; k < hclen; k++) put_bits(g, len_len[length_order[k]], 3);
+    for (uint16_t i = 0; i < sym_count; i++) {
+      put_bits(g, len_codes[syms[i]], len_len[syms[i]]);
+      put_bits(g, extras[i], repeat_bits[syms[i]]);
+    }
+    lcode = lit_codes, lbits = lit_len, dcode = dist_codes, dbits = dist_len;
+  } else {
+    put_bits(g, final | (1 << 1), 3);
+  }
+
+  for (uint32_t t = 0; t < g->token_count; t++) {
+    const uint16_t len = g->tokens[2 * t], value = g->tokens[2 * t + 1];
+    if (len == 0) {
+      put_bits(g, lcode[value], lbits[value]);
+      continue;
+    }
+    const uint8_t lc = length_code[len - MIN_MATCH], dc = dist_code_of(value);
+    put_bits(g, lcode[257 + lc], lbits[257 + lc]);
+    put_bits(g, len - length_base[lc], length_extra[lc]);
+    put_bits(g, dcode[dc], dbits[dc]);
+    put_bits(g, value - dist_base[dc], dist_extra[dc]);
+  }
+  put_bits(g, lcode[END_OF_BLOCK], lbits[END_OF_BLOCK]);
+  g->out->str[g->out->length] = '\0';
+
+  g->token_count = 0;
+  memset(g->lit_freq, 0, sizeof(g->lit_freq));
+  memset(g->dist_freq, 0, sizeof(g->dist_freq));
+  return 0;
+}
+
+// Adds a literal, or a match when len is not 0, to the block; a full block is coded.
+static inline int8_t add_token(Gzip* g, uint16_t len, uint16_t value) {
+  g->tokens[2 * g->token_count] = len;
+  g->tokens[2 * g->token_count + 1] = value;
+  if (len == 0) {
+    g->lit_freq[value]++;
+  } else {
+    g->lit_freq[257 + length_code[len - MIN_MATCH]]++;
+    g->dist_freq[dist_code_of(value)]++;
+  }
+  return (++g->token_count == GZIP_BLOCK_TOKENS) ? gzip_block(g, 0) : 0;
+}
+
+static inline uint32_t hash3(const uint8_t* p) {
+  const uint32_t v = ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2];
+  return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// Makes position p of the window the first of its hash chain.
+static inline void insert_hash(Gzip* g, uint32_t p) {
+  const uint32_t h = hash3(g->window + p);
+  g->prev[p & (GZIP_WINDOW - 1)] = g->head[h];
+  g->head[h] = (int32_t)p;
+}
+
+// Codes the window from pos up to limit; matches may look ahead up to the end of the input.
+static int8_t gzip_code(Gzip* g, uint32_t limit) {
+  const uint8_t* w = g->window;
+  while (g->pos < limit) {
+    const uint32_t pos = g->pos;
+    const uint32_t avail = g->filled - pos;
+    const uint32_t max = (avail < MAX_MATCH) ? avail : MAX_MATCH;
+    uint32_t best = 0, best_dist = 0;
+    if (avail >= MIN_MATCH) {
+      int32_t candidate = g->head[hash3(w + pos)];
+      insert_hash(g, pos);
+      for (int chain = MAX_CHAIN; candidate >= 0 && pos - (uint32_t)candidate <= GZIP_WINDOW && chain > 0; chain--) {
+        const uint8_t* a = w + candidate;
+        const uint8_t* b = w + pos;
+        // only a match longer than the best one is worth comparing whole.
+        if (a[best] == b[best] && a[0] == b[0]) {
+          uint32_t len = 0;
+          while (len < max && a[len] == b[len]) len++;
+          if (len > best) {
+            best = len;
+            best_dist = pos - (uint32_t)candidate;
+            if (len == max) break;
+          }
+        }
+        candidate = g->prev[candidate & (GZIP_WINDOW - 1)];
+      }
+    }
+    if (best >= MIN_MATCH) {
+      if (add_token(g, best, best_dist) != 0) return -1;
+      // the matched bytes start chains too, as long as 3 bytes are there to hash.
+      for (uint32_t p = pos + 1; p < pos + best && p + MIN_MATCH <= g->filled; p++) insert_hash(g, p);
+      g->pos += best;
+    } else {
+      if (add_token(g, 0, w[pos]) != 0) return -1;
+      g->pos++;
+    }
+  }
+  return 0;
+}
+
+// Drops the older half of the window once it is out of reach.
+static void gzip_slide(Gzip* g) {
+  memmove(g->window, g->window + GZIP_WINDOW, g->filled - GZIP_WINDOW);
+  g->filled -= GZIP_WINDOW;
+  g->pos -= GZIP_WINDOW;
+  for (uint32_t i = 0; i < (1u << HASH_BITS); i++) g->head[i] = (g->head[i] >= GZIP_WINDOW) ? g->head[i] - GZIP_WINDOW : -1;
+  for (uint32_t i = 0; i < GZIP_WINDOW; i++) g->prev[i] = (g->prev[i] >= GZIP_WINDOW) ? g->prev[i] - GZIP_WINDOW : -1;
+}
+
+// Allocates the window and hash chains of a stream appended to out.
+static int8_t coder_begin(Gzip* g, StrBuilder* out, int8_t zlib) {
+  pthread_once(&codes_once, codes_build);
+  *g = (Gzip){.out = out, .zlib = zlib, .crc = zlib ? 1 : 0};
+  g->window = malloc(2 * GZIP_WINDOW);
+  g->head = malloc((1u << HASH_BITS) * sizeof(int32_t));
+  g->prev = malloc(GZIP_WINDOW * sizeof(int32_t));
+  g->tokens = malloc(2 * GZIP_BLOCK_TOKENS * sizeof(uint16_t));
+  if (g->window == NULL || g->head == NULL || g->prev == NULL || g->tokens == NULL) {
+    DEBUG_PRINT("err! coder_begin(): failed to allocate the window.\n");
+    gzip_free(g);
+    return -1;
+  }
+  memset(g->head, 0xFF, (1u << HASH_BITS) * sizeof(int32_t));
+  memset(g->prev, 0xFF, GZIP_WINDOW * sizeof(int32_t));
+  return 0;
+}
+
+int8_t gzip_begin(Gzip* g, StrBuilder* out) {
+  if (coder_begin(g, out, 0) != 0) return -1;
+  // magic, deflate, no flags, no time, no extra flags, Unix.
+  static const uint8_t header[10] = {0x1F, 0x8B, 8, 0, 0, 0, 0, 0, 0, 3};
+  return str_builder_append_n(out, (const char*)header, sizeof(header));
+}
+
+int8_t zlib_begin(Gzip* g, StrBuilder* out) {
+  if (coder_begin(g, out, 1) != 0) return -1;
+  // CMF: deflate with a 32K window; FLG: no dictionary, check bits making CMF.FLG a multiple of 31.
+  return str_builder_append_n(out, "\x78\x01", 2);
+}
+
+int8_t gzip_write(Gzip* g, const uint8_t* data, uint64_t length) {
+  g->crc = g->zlib ? adler32_update(g->crc, data, length) : crc32_update(g->crc, data, length);
+  g->size += (uint32_t)length;
+  while (length > 0) {
+    uint64_t n = 2 * GZIP_WINDOW - g->filled;
+    if (n > length) n = length;
+    memcpy(g->window + g->filled, data, n);
+    g->filled += n;
+    data += n;
+    length -= n;
+    if (g->filled == 2 * GZIP_WINDOW) {
+      // the last bytes wait for what follows them, to be matched whole.
+      if (gzip_code(g, g->filled - MAX_MATCH) != 0) return -1;
+      gzip_slide(g);
+    }
+  }
+  return 0;
+}
+
+int8_t gzip_end(Gzip* g) {
+  if (gzip_code(g, g->filled) != 0 || gzip_block(g, 1) != 0) return -1;
+  // the last byte is padded with zeros.
+  uint8_t tail[16];
+  uint8_t n = 0;
+  for (; g->bit_count > 0; g->bit_count = (g->bit_count > 8) ? g->bit_count - 8 : 0, g->bits >>= 8) tail[n++] = g->bits & 0xFF;
+  if (g->zlib) {
+    // big endian, unlike the gzip trailer.
+    for (int i = 0; i < 4; i++) tail[n++] = (g->crc >> (24 - 8 * i)) & 0xFF;
+  } else {
+    for (int i = 0; i < 4; i++) tail[n++] = (g->crc >> (8 * i)) & 0xFF;
+    for (int i = 0; i < 4; i++) tail[n++] = (g->size >> (8 * i)) & 0xFF;
+  }
+  return str_builder_append_n(g->out, (const char*)tail, n);
+}
+
+void gzip_free(Gzip* g) {
+  free(g->window);
+  free(g->head);
+  free(g->prev);
+  free(g->tokens);
+  g->window = NULL;
+  g->head = NULL;
+  g->prev = NULL;
+  g->tokens = NULL;
+}
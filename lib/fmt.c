@@ -0,0 +1,117 @@
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include "../include/fmt.h"
+
+static const char DIGIT_PAIRS[201] =
+  "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+  "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+  "8081828384858687888990919293949596979899";
+
+static const uint64_t POW10[FMT_MAX_PRECISION + 1] = {
+  1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+uint8_t fmt_uint(char* buf, uint64_t n) {
+  char tmp[20];
+  uint8_t i = sizeof(tmp);
+
+  // two digits per division.
+  while (n >= 100) {
+    uint64_t pair = (n % 100) * 2;
+    n /= 100;
+    tmp[--i] = DIGIT_PAIRS[pair + 1];
+    tmp[--i] = DIGIT_PAIRS[pair];
+  }
+  if (n >= 10) {
+    tmp[--i] = DIGIT_PAIRS[n * 2 + 1];
+    tmp[--i] = DIGIT_PAIRS[n * 2];
+  } else {
+    tmp[--i] = '0' + n;
+  }
+
+  uint8_t length = sizeof(tmp) - i;
+  memcpy(buf, tmp + i, length);
+  return length;
+}
+
+uint8_t fmt_int(char* buf, int64_t n) {
+  if (n >= 0) return fmt_uint(buf, n);
+  buf[0] = '-';
+  return 1 + fmt_uint(buf + 1, -(uint64_t)n);
+}
+
+uint8_t fmt_fixed(char* buf, double v, uint8_t precision) {
+  if (precision > FMT_MAX_PRECISION) precision = FMT_MAX_PRECISION;
+
+  double scaled = fabs(v) * POW10[precision] + 0.5;
+  // past 2^53 the scaled value loses digits; such values are rare enough to leave to snprintf.
+  if (!(scaled < 9007199254740992.0)) {
+    int length = snprintf(buf, FMT_MAX, "%.*f", precision, v);
+    return (length > 0 && length < FMT_MAX) ? length : 0;
+  }
+
+  uint64_t fixed = (uint64_t)scaled;
+  uint8_t length = 0;
+  // no sign when the value rounds to zero, so -0.001 never prints as "-0".
+  if (v < 0 && fixed != 0) buf[length++] = '-';
+  length += fmt_uint(buf + length, fixed / POW10[precision]);
+
+  if (precision != 0) {
+    uint64_t fraction = fixed % POW10[precision];
+    buf[length++] = '.';
+    for (uint8_t i = precision; i > 0; i--) {
+      buf[length + i - 1] = '0' + fraction % 10;
+      fraction /= 10;
+    }
+    length += precision;
+  }
+  return length;
+}
+
+int64_t fmt_fixed_key(double v, uint8_t precision) {
+  if (precision > FMT_MAX_PRECISION) precision = FMT_MAX_PRECISION;
+
+  double scaled = fabs(v) * POW10[precision] + 0.5;
+  if (!(scaled < 9007199254740992.0)) return (v < 0) ? INT64_MIN : INT64_MAX;
+  int64_t fixed = (int64_t)scaled;
+  return (v < 0) ? -fixed : fixed;
+}
+
+uint8_t fmt_key_short(char* buf, int64_t key, uint8_t precision) {
+  if (precision > FMT_MAX_PRECISION) precision = FMT_MAX_PRECISION;
+
+  const uint64_t magnitude = (key < 0) ? -(uint64_t)key : (uint64_t)key;
+  const uint64_t whole = magnitude / POW10[precision];
+  uint64_t fraction = magnitude % POW10[precision];
+  uint8_t length = 0;
+  if (key < 0) buf[length++] = '-';
+  if (whole != 0 || fraction == 0) length += fmt_uint(buf + length, whole);
+  if (fraction != 0) {
+    uint8_t digits = precision;
+    for (; fraction % 10 == 0; digits--) fraction /= 10;
+    buf[length++] = '.';
+    for (uint8_t i = digits; i > 0; i--) {
+      buf[length + i - 1] = '0' + fraction % 10;
+      fraction /= 10;
+    }
+    length += digits;
+  }
+  return length;
+}
+
+// the digits are written straight into the builder's spare room.
+int8_t str_builder_append_int(StrBuilder* sb, int64_t n) {
+  if (str_builder_grow(sb, FMT_MAX) != 0) return -1;
+  sb->length += fmt_int(sb->str + sb->length, n);
+  sb->str[sb->length] = '\0';
+  return 0;
+}
+
+int8_t str_builder_append_fixed(StrBuilder* sb, double v, uint8_t precision) {
+  if (str_builder_grow(sb, FMT_MAX) != 0) return -1;
+  sb->length += fmt_fixed(sb->str + sb->length, v, precision);
+  sb->str[sb->length] = '\0';
+  return 0;
+}
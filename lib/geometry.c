@@ -0,0 +1,131 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "../include/geometry.h"
+#include "../include/utils.h"
+
+// arrays in one allocation: x, y and the scratch rows are `points` or 1 rows of `capacity` floats.
+#define GEOM_PARAM_ROWS 4
+#define GEOM_SCRATCH_ROWS 6
+
+int8_t geom_batch_init(ShapeBatch* batch, uint16_t points, uint32_t capacity) {
+  *batch = (ShapeBatch){0};
+  batch->points = points;
+  return geom_batch_reserve(batch, capacity);
+}
+
+int8_t geom_batch_reserve(ShapeBatch* batch, uint32_t capacity) {
+  if (batch->x != NULL && capacity <= batch->capacity) return 0;
+  if (capacity < 16) capacity = 16;
+
+  uint64_t rows = 2 * batch->points + GEOM_PARAM_ROWS + GEOM_SCRATCH_ROWS;
+  float* data = (float*)malloc(rows * capacity * sizeof(float));
+  if (data == NULL) {
+    DEBUG_PRINT("err! geom_batch_reserve(): failed to allocate memory for the batch.\n");
+    return -1;
+  }
+
+  float* rows_of[2 + GEOM_PARAM_ROWS] = {
+    data,
+    data + (uint64_t)batch->points * capacity,
+    data + (uint64_t)2 * batch->points * capacity,
+    data + (uint64_t)(2 * batch->points + 1) * capacity,
+    data + (uint64_t)(2 * batch->points + 2) * capacity,
+    data + (uint64_t)(2 * batch->points + 3) * capacity,
+  };
+
+  // point major rows change stride with the capacity, so every row is copied on its own.
+  if (batch->x != NULL) {
+    for (uint16_t p = 0; p < batch->points; p++) {
+      memcpy(rows_of[0] + (uint64_t)p * capacity, batch->x + (uint64_t)p * batch->capacity, batch->count * sizeof(float));
+      memcpy(rows_of[1] + (uint64_t)p * capacity, batch->y + (uint64_t)p * batch->capacity, batch->count * sizeof(float));
+    }
+    memcpy(rows_of[2], batch->angle, batch->count * sizeof(float));
+    memcpy(rows_of[3], batch->scale, batch->count * sizeof(float));
+    memcpy(rows_of[4], batch->tx, batch->count * sizeof(float));
+    memcpy(rows_of[5], batch->ty, batch->count * sizeof(float));
+    free(batch->x);
+  }
+
+  batch->x = rows_of[0];
+  batch->y = rows_of[1];
+  batch->angle = rows_of[2];
+  batch->scale = rows_of[3];
+  batch->tx = rows_of[4];
+  batch->ty = rows_of[5];
+  for (int i = 0; i < GEOM_SCRATCH_ROWS; i++) {
+    batch->m[i] = data + (uint64_t)(2 * batch->points + GEOM_PARAM_ROWS + i) * capacity;
+  }
+  batch->capacity = capacity;
+  return 0;
+}
+
+int64_t geom_batch_push(ShapeBatch* batch) {
+  if (batch->count == batch->capacity || batch->x == NULL) {
+    if (geom_batch_reserve(batch, batch->capacity * 2) != 0) return -1;
+  }
+  uint32_t shape = batch->count++;
+  batch->angle[shape] = 0;
+  batch->scale[shape] = 1;
+  batch->tx[shape] = 0;
+  batch->ty[shape] = 0;
+  return shape;
+}
+
+void geom_batch_clear(ShapeBatch* batch) {
+  batch->count = 0;
+}
+
+void geom_batch_transform(ShapeBatch* batch) {
+  const uint32_t n = batch->count;
+  const uint64_t stride = batch->capacity;
+  float* restrict cx = batch->m[4];
+  float* restrict cy = batch->m[5];
+  float* restrict m00 = batch->m[0];
+  float* restrict m10 = batch->m[1];
+  float* restrict bx = batch->m[2];
+  float* restrict by = batch->m[3];
+
+  // centroid of every shape, one point row at a time.
+  memset(cx, 0, n * sizeof(float));
+  memset(cy, 0, n * sizeof(float));
+  for (uint16_t p = 0; p < batch->points; p++) {
+    const float* restrict x = batch->x + p * stride;
+    const float* restrict y = batch->y + p * stride;
+    for (uint32_t s = 0; s < n; s++) {
+      cx[s] += x[s];
+      cy[s] += y[s];
+    }
+  }
+
+  // the trig is computed once per shape. With M = scale * R, a point maps to
+  // M * (p - c) + c + t, which is M * p + b with b = c + t - M * c.
+  const float inv_points = 1.0f / batch->points;
+  const float to_radians = M_PI / 180.0;
+  for (uint32_t s = 0; s < n; s++) {
+    const float c = cosf(batch->angle[s] * to_radians) * batch->scale[s];
+    const float sn = sinf(batch->angle[s] * to_radians) * batch->scale[s];
+    cx[s] *= inv_points;
+    cy[s] *= inv_points;
+    m00[s] = c;
+    m10[s] = sn;
+    bx[s] = cx[s] + batch->tx[s] - (c * cx[s] - sn * cy[s]);
+    by[s] = cy[s] + batch->ty[s] - (sn * cx[s] + c * cy[s]);
+  }
+
+  for (uint16_t p = 0; p < batch->points; p++) {
+    float* restrict x = batch->x + p * stride;
+    float* restrict y = batch->y + p * stride;
+    for (uint32_t s = 0; s < n; s++) {
+      const float px = x[s], py = y[s];
+      x[s] = m00[s] * px - m10[s] * py + bx[s];
+      y[s] = m10[s] * px + m00[s] * py + by[s];
+    }
+  }
+}
+
+void geom_batch_free(ShapeBatch* batch) {
+  free(batch->x);
+  *batch = (ShapeBatch){0};
+}
@@ -0,0 +1,177 @@
+#include <ctype.h>
+#include <stdint.h>
+#include <string.h>
+#include "../include/http.h"
+#include "../include/fmt.h"
+#include "../include/strings.h"
+
+// Returns whether v is s, ignoring case as header names and tokens do.
+static int8_t view_ieq(StrView v, const char* s) {
+  const size_t n = strlen(s);
+  if (v.length != n) return 0;
+  for (size_t i = 0; i < n; i++) {
+    if (tolower((unsigned char)v.str[i]) != s[i]) return 0;
+  }
+  return 1;
+}
+
+static StrView trim_spaces(StrView v) {
+  while (v.length > 0 && (v.str[0] == ' ' || v.str[0] == '\t')) v.str++, v.length--;
+  while (v.length > 0 && (v.str[v.length - 1] == ' ' || v.str[v.length - 1] == '\t')) v.length--;
+  return v;
+}
+
+// Returns the offset of the first "\r\n" of data at or after from, data.length if there is none.
+static uint64_t find_crlf(StrView data, uint64_t from) {
+  for (uint64_t i = from; i + 1 < data.length; i++) {
+    if (data.str[i] == '\r' && data.str[i + 1] == '\n') return i;
+  }
+  return data.length;
+}
+
+// Reads the request line: METHOD SP target SP HTTP/1.x.
+static int8_t parse_request_line(StrView line, HttpRequest* req) {
+  const char* sp = memchr(line.str, ' ', line.length);
+  if (sp == NULL || sp == line.str) return -1;
+  req->method = (StrView){line.str, (uint64_t)(sp - line.str)};
+  for (uint64_t i = 0; i < req->method.length; i++) {
+    if (req->method.str[i] < 'A' || req->method.str[i] > 'Z') return -1;
+  }
+  const char* target = sp + 1;
+  const char* line_end = line.str + line.length;
+  const char* sp2 = memchr(target, ' ', line_end - target);
+  if (sp2 == NULL || sp2 == target || *target != '/') return -1;
+
+  const StrView version = {sp2 + 1, (uint64_t)(line_end - sp2 - 1)};
+  if (version.length != 8 || memcmp(version.str, "HTTP/1.", 7) != 0 || (version.str[7] != '0' && version.str[7] != '1')) return -1;
+  req->minor = version.str[7] - '0';
+
+  const char* question = memchr(target, '?', sp2 - target);
+  const char* path_end = (question != NULL) ? question : sp2;
+  req->path = (StrView){target, (uint64_t)(path_end - target)};
+  req->query = (question != NULL) ? (StrView){question + 1, (uint64_t)(sp2 - question - 1)} : (StrView){sp2, 0};
+  return 0;
+}
+
+// Applies the comma separated options of a Connection header.
+static void parse_connection(StrView value, HttpRequest* req) {
+  while (value.length > 0) {
+    const char* comma = memchr(value.str, ',', value.length);
+    const uint64_t n = (comma != NULL) ? (uint64_t)(comma - value.str) : value.length;
+    const StrView option = trim_spaces((StrView){value.str, n});
+    if (view_ieq(option, "close")) req->keep_alive = 0;
+    else if (view_ieq(option, "keep-alive")) req->keep_alive = 1;
+    value.str += n;
+    value.length -= n;
+    if (value.length > 0) value.str++, value.length--;
+  }
+}
+
+int8_t http_parse_request(StrView data, HttpRequest* req) {
+  *req = (HttpRequest){0};
+  // blank lines before the request line are allowed.
+  uint64_t start = 0;
+  while (start + 1 < data.length && data.str[start] == '\r' && data.str[start + 1] == '\n') start += 2;
+
+  uint64_t line_end = find_crlf(data, start);
+  if (line_end == data.length) return 0;
+  if (parse_request_line((StrView){data.str + start, line_end - start}, req) != 0) return -1;
+  // HTTP/1.1 keeps connections open unless told otherwise, HTTP/1.0 closes them.
+  req->keep_alive = req->minor == 1;
+
+  for (;;) {
+    const uint64_t line = line_end + 2;
+    line_end = find_crlf(data, line);
+    if (line_end == data.length) return 0;
+    if (line_end == line) break;
+    const StrView header = {data.str + line, line_end - line};
+    const char* colon = memchr(header.str, ':', header.length);
+    // a line starting with a space would continue the previous one, which RFC 9112 obsoletes.
+    if (colon == NULL || colon == header.str || header.str[0] == ' ' || header.str[0] == '\t') return -1;
+    const StrView name = {header.str, (uint64_t)(colon - header.str)};
+    const StrView value = trim_spaces((StrView){colon + 1, (uint64_t)(header.str + header.length - colon - 1)});
+    if (memchr(header.str, '\n', header.length) != NULL || memchr(header.str, '\r', header.length) != NULL) return -1;
+
+    if (view_ieq(name, "connection")) {
+      parse_connection(value, req);
+    } else if (view_ieq(name, "content-length")) {
+      if (!(value.length == 1 && value.str[0] == '0')) req->has_body = 1;
+    } else if (view_ieq(name, "transfer-encoding")) {
+      req->has_body = 1;
+    }
+  }
+  req->length = line_end + 2;
+  return 1;
+}
+
+static int hex_value(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  c = (char)tolower((unsigned char)c);
+  return (c >= 'a' && c <= 'f') ? c - 'a' + 10 : -1;
+}
+
+int8_t http_query_param(StrView query, const char* name, char* value, size_t cap) {
+  const size_t name_length = strlen(name);
+  while (query.length > 0) {
+    const char* amp = memchr(query.str, '&', query.length);
+    const uint64_t n = (amp != NULL) ? (uint64_t)(amp - query.str) : query.length;
+    const StrView pair = {query.str, n};
+    query.str += n;
+    query.length -= n;
+    if (query.length > 0) query.str++, query.length--;
+
+    const char* eq = memchr(pair.str, '=', pair.length);
+    const uint64_t key_length = (eq != NULL) ? (uint64_t)(eq - pair.str) : pair.length;
+    if (key_length != name_length || memcmp(pair.str, name, name_length) != 0) continue;
+
+    // percent escapes and '+' for spaces, as forms encode them.
+    const char* p = (eq != NULL) ? eq + 1 : pair.str + pair.length;
+    const char* end = pair.str + pair.length;
+    size_t length = 0;
+    for (; p < end; p++) {
+      char c = *p;
+      if (c == '+') {
+        c = ' ';
+      } else if (c == '%') {
+        const int high = (end - p > 2) ? hex_value(p[1]) : -1;
+        const int low = (high != -1) ? hex_value(p[2]) : -1;
+        if (low == -1) return -1;
+        c = (char)(high * 16 + low);
+        p += 2;
+      }
+      if (c == '\0' || length + 1 >= cap) return -1;
+      value[length++] = c;
+    }
+    value[length] = '\0';
+    return 1;
+  }
+  return 0;
+}
+
+const char* http_reason(uint16_t status) {
+  switch (status) {
+    case 200: return "OK";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 431: return "Request Header Fields Too Large";
+    case 500: return "Internal Server Error";
+    case 503: return "Service Unavailable";
+  }
+  return "Unknown";
+}
+
+int8_t http_response_head(StrBuilder* out, uint16_t status, const char* content_type, uint64_t content_length,
+        int8_t keep_alive, StrView extra) {
+  char digits[FMT_MAX];
+  if (str_builder_append(out, STR_LIT("HTTP/1.1 ")) != 0 || str_builder_append_int(out, status) != 0 ||
+      str_builder_append(out, STR_LIT(" ")) != 0 || str_builder_append_cstr(out, http_reason(status)) != 0 ||
+      str_builder_append(out, STR_LIT("\r\nContent-Type: ")) != 0 || str_builder_append_cstr(out, content_type) != 0 ||
+      str_builder_append(out, STR_LIT("\r\nContent-Length: ")) != 0 ||
+      str_builder_append_n(out, digits, fmt_uint(digits, content_length)) != 0 ||
+      str_builder_append(out, keep_alive ? STR_LIT("\r\nConnection: keep-alive\r\n") : STR_LIT("\r\nConnection: close\r\n")) != 0) {
+    return -1;
+  }
+  if (str_builder_append(out, extra) != 0) return -1;
+  return str_builder_append(out, STR_LIT("\r\n"));
+}
@@ -0,0 +1,160 @@
+#include <math.h>
+#include <stdlib.h>
+#include "../include/placement.h"
+
+// The layout is computed on a torus: the box wraps around at its edges, so that any
+// shift of the layout, wrapped back into the box, keeps its points a spacing apart.
+
+int8_t placement_begin(Placement* p, const Rng* rng, Point begin, Point end, float spacing, uint32_t count) {
+  const float width = (end.x > begin.x) ? end.x - begin.x : 0;
+  const float height = (end.y > begin.y) ? end.y - begin.y : 0;
+
+  const float fit_spacing = sqrtf(width * height * PLACEMENT_FILL / ((count != 0) ? count : 1));
+  if (count != 0 && fit_spacing < spacing) spacing = fit_spacing;
+  // then raise it until the grid fits, the cells stay at most PLACEMENT_MAX_CELLS.
+  if (!(spacing > 0)) spacing = 1;
+  const float min_spacing = sqrtf(width * height * 2 / PLACEMENT_MAX_CELLS);
+  if (spacing < min_spacing) spacing = min_spacing;
+
+  // cells divide the box exactly, so that the grid wraps around with it, and are no wider
+  // than spacing / sqrt(2), so that a cell holds one point at most.
+  const float side = spacing / (float)M_SQRT2;
+  const uint32_t cols = (uint32_t)ceilf(width / side), rows = (uint32_t)ceilf(height / side);
+  const uint32_t cells = ((cols != 0) ? cols : 1) * ((rows != 0) ? rows : 1);
+
+  if (cells > p->capacity) {
+    Point* grid = (Point*)realloc(p->grid, cells * sizeof(Point));
+    if (grid != NULL) p->grid = grid;
+    Point* points = (Point*)realloc(p->points, cells * sizeof(Point));
+    if (points != NULL) p->points = points;
+    uint32_t* active = (uint32_t*)realloc(p->active, cells * sizeof(uint32_t));
+    if (active != NULL) p->active = active;
+    if (grid == NULL || points == NULL || active == NULL) {
+      DEBUG_PRINT("err! placement_begin(): failed to allocate memory for %u cells.\n", cells);
+      p->capacity = 0; // the buffers that grew are kept, but they may differ in size.
+      return -1;
+    }
+    p->capacity = cells;
+  }
+
+  p->begin = begin;
+  p->size = (Point){width, height};
+  p->spacing = spacing;
+  p->rng = *rng;
+  p->cols = (cols != 0) ? cols : 1;
+  p->rows = (rows != 0) ? rows : 1;
+  p->inverse_cell = (Point){p->cols / ((width > 0) ? width : 1), p->rows / ((height > 0) ? height : 1)};
+  // the points that may be too close are this many cells away at most.
+  const float cell = fminf(width / p->cols, height / p->rows);
+  p->reach = (cell > 0) ? (uint32_t)ceilf(spacing / cell) : 1;
+  p->count = 0;
+  p->next = 0;
+  p->active_count = 0;
+  p->layers = 0;
+  p->offset = (Point){0, 0};
+  return 0;
+}
+
+static inline uint32_t col_of(const Placement* p, float x) {
+  const uint32_t col = (uint32_t)(x * p->inverse_cell.x);
+  return (col < p->cols) ? col : p->cols - 1;
+}
+
+static inline uint32_t row_of(const Placement* p, float y) {
+  const uint32_t row = (uint32_t)(y * p->inverse_cell.y);
+  return (row < p->rows) ? row : p->rows - 1;
+}
+
+// wraps v, at most one length outside, back into [0, length).
+static inline float wrap(float v, float length) {
+  if (v < 0) v += length;
+  else if (v >= length) v -= length;
+  return (v >= 0 && v < length) ? v : 0;
+}
+
+// distance along one axis of the torus.
+static inline float torus_delta(float a, float b, float length) {
+  const float d = fabsf(a - b);
+  return (d * 2 > length) ? length - d : d;
+}
+
+// Empty cells hold NaN, which never compares as too close.
+static int8_t has_room(const Placement* p, Point pt) {
+  const int64_t col = col_of(p, pt.x), row = row_of(p, pt.y);
+  const float min_distance = p->spacing * p->spacing;
+  // a small grid is covered once, rather than wrapping onto the same cells again.
+  const int64_t reach_rows = (2 * (int64_t)p->reach + 1 < p->rows) ? p->reach : p->rows / 2;
+  const int64_t reach_cols = (2 * (int64_t)p->reach + 1 < p->cols) ? p->reach : p->cols / 2;
+  for (int64_t dr = -reach_rows; dr <= reach_rows; dr++) {
+    const Point* cells = p->grid + ((row + dr + p->rows) % p->rows) * p->cols;
+    for (int64_t dc = -reach_cols; dc <= reach_cols; dc++) {
+      const Point other = cells[(col + dc + p->cols) % p->cols];
+      const float dx = torus_delta(other.x, pt.x, p->size.x), dy = torus_delta(other.y, pt.y, p->size.y);
+      if (dx * dx + dy * dy < min_distance) return 0;
+    }
+  }
+  return 1;
+}
+
+static void add_point(Placement* p, Point pt) {
+  p->grid[row_of(p, pt.y) * p->cols + col_of(p, pt.x)] = pt;
+  p->active[p->active_count++] = p->count;
+  p->points[p->count++] = pt;
+}
+
+// Computes the layout: a first point anywhere, then points just over one spacing away
+// from the last point that may have room around it, until no point has any left.
+// Candidates are evenly spaced around that point from a random angle (Roberts' variant of
+// Bridson's algorithm), which packs the layout tighter with fewer attempts, and working
+// from the last point keeps the grid cells being read close to each other.
+static void fill_layout(Placement* p) {
+  const uint32_t cells = p->cols * p->rows;
+  for (uint32_t i = 0; i < cells; i++) p->grid[i] = (Point){NAN, NAN};
+
+  add_point(p, (Point){wrap(rng_float(&p->rng) * p->size.x, p->size.x), wrap(rng_float(&p->rng) * p->size.y, p->size.y)});
+  const float step = 2 * (float)M_PI / PLACEMENT_ATTEMPTS;
+  const float step_cos = cosf(step), step_sin = sinf(step);
+  const float distance = p->spacing * 1.0001f;
+  while (p->active_count != 0) {
+    const Point around = p->points[p->active[p->active_count - 1]];
+    const float angle = rng_float(&p->rng) * 2 * (float)M_PI;
+    // the direction is rotated by one step per attempt instead of calling cosf() and sinf().
+    float dx = cosf(angle), dy = sinf(angle);
+    int8_t added = 0;
+    for (int k = 0; k < PLACEMENT_ATTEMPTS && !added && p->count < cells; k++) {
+      const Point pt = {wrap(around.x + distance * dx, p->size.x), wrap(around.y + distance * dy, p->size.y)};
+      const float rotated = dx * step_cos - dy * step_sin;
+      dy = dx * step_sin + dy * step_cos;
+      dx = rotated;
+      if (has_room(p, pt)) {
+        add_point(p, pt);
+        added = 1;
+      }
+    }
+    if (!added) p->active_count--;
+  }
+}
+
+Point placement_next(Placement* p) {
+  // every layer is the layout shifted by a random offset.
+  if (p->next == p->count) {
+    if (p->count == 0) fill_layout(p);
+    p->next = 0;
+    p->layers++;
+    p->offset = (Point){rng_float(&p->rng) * p->size.x, rng_float(&p->rng) * p->size.y};
+  }
+  // the layout grows outwards from its first point, so a layer hands its points out in
+  // random order; the first points of a layer then cover the whole box, not a patch of it.
+  const uint32_t pick = p->next + rng_below(&p->rng, p->count - p->next);
+  const Point pt = p->points[pick];
+  p->points[pick] = p->points[p->next];
+  p->points[p->next++] = pt;
+  return (Point){p->begin.x + wrap(pt.x + p->offset.x, p->size.x), p->begin.y + wrap(pt.y + p->offset.y, p->size.y)};
+}
+
+void placement_free(Placement* p) {
+  free(p->grid);
+  free(p->points);
+  free(p->active);
+  *p = (Placement){0};
+}
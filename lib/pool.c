@@ -0,0 +1,225 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "../include/pool.h"
+#include "../include/utils.h"
+
+#define POOL_DEQUE_CAPACITY 64
+
+// the pool the calling thread works for and its deque, if it is a worker.
+static _Thread_local Pool* pool_self = NULL;
+static _Thread_local uint16_t pool_self_index;
+
+static int8_t deque_push(PoolDeque* dq, PoolJob job) {
+  pthread_mutex_lock(&dq->lock);
+  if (dq->count == dq->capacity) {
+    PoolJob* grown = (PoolJob*)malloc(dq->capacity * 2 * sizeof(PoolJob));
+    if (grown == NULL) {
+      pthread_mutex_unlock(&dq->lock);
+      DEBUG_PRINT("err! pool_submit(): failed to allocate memory for the queue.\n");
+      return -1;
+    }
+    // unwrap the ring into the front of the new buffer.
+    for (uint32_t i = 0; i < dq->count; i++) grown[i] = dq->jobs[(dq->head + i) % dq->capacity];
+    free(dq->jobs);
+    dq->jobs = grown;
+    dq->head = 0;
+    dq->capacity *= 2;
+  }
+  dq->jobs[(dq->head + dq->count) % dq->capacity] = job;
+  dq->count++;
+  pthread_mutex_unlock(&dq->lock);
+  return 0;
+}
+
+// Takes the newest task (back) for the owner, or the oldest (front) for a thief.
+static int8_t deque_take(PoolDeque* dq, PoolJob* job, int8_t steal) {
+  int8_t found = 0;
+  pthread_mutex_lock(&dq->lock);
+  if (dq->count != 0) {
+    if (steal) {
+      *job = dq->jobs[dq->head];
+      dq->head = (dq->head + 1) % dq->capacity;
+    } else {
+      *job = dq->jobs[(dq->head + dq->count - 1) % dq->capacity];
+    }
+    dq->count--;
+    found = 1;
+  }
+  pthread_mutex_unlock(&dq->lock);
+  return found;
+}
+
+// Finds a task for the deque at self, stealing from the other deques when it is empty.
+// Returns 1 when job was set and 0 when every deque is empty.
+static int8_t pool_take(Pool* pool, uint16_t self, PoolJob* job) {
+  int8_t stolen = 1;
+  int8_t found = 0;
+
+  if (self < pool->thread_count && deque_take(&pool->deques[self], job, 0)) {
+    stolen = 0;
+    found = 1;
+  }
+  for (uint16_t i = 1; !found && i <= pool->thread_count; i++) {
+    found = deque_take(&pool->deques[(self + i) % pool->thread_count], job, 1);
+  }
+  if (found) {
+    pthread_mutex_lock(&pool->lock);
+    pool->queued--;
+    pool->steals += stolen;
+    pthread_mutex_unlock(&pool->lock);
+  }
+  return found;
+}
+
+// Marks a task as finished.
+static void pool_finish(Pool* pool) {
+  pthread_mutex_lock(&pool->lock);
+  if (--pool->pending == 0) pthread_cond_broadcast(&pool->idle);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+typedef struct {
+  Pool* pool;
+  uint16_t index;
+} PoolWorker;
+
+static void pool_stop(Pool* pool, uint16_t started);
+
+static void* pool_worker(void* arg) {
+  Pool* pool = ((PoolWorker*)arg)->pool;
+  const uint16_t self = ((PoolWorker*)arg)->index;
+  PoolJob job;
+
+  free(arg);
+  pool_self = pool;
+  pool_self_index = self;
+  for (;;) {
+    if (pool_take(pool, self, &job)) {
+      job.fn(job.arg);
+      pool_finish(pool);
+      continue;
+    }
+    pthread_mutex_lock(&pool->lock);
+    while (pool->queued <= 0 && !pool->stopping) pthread_cond_wait(&pool->has_work, &pool->lock);
+    const int8_t done = pool->queued <= 0; // stopping with nothing left to do.
+    pthread_mutex_unlock(&pool->lock);
+    if (done) break;
+  }
+  return NULL;
+}
+
+int8_t pool_init(Pool* pool, uint16_t threads) {
+  *pool = (Pool){0};
+  if (threads == 0) threads = 1;
+
+  pool->threads = (pthread_t*)malloc(threads * sizeof(pthread_t));
+  pool->deques = (PoolDeque*)calloc(threads, sizeof(PoolDeque));
+  if (pool->threads == NULL || pool->deques == NULL) {
+    DEBUG_PRINT("err! pool_init(): failed to allocate memory for the pool.\n");
+    free(pool->threads);
+    free(pool->deques);
+    return -1;
+  }
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->has_work, NULL);
+  pthread_cond_init(&pool->idle, NULL);
+
+  // every deque exists before the first worker starts looking for work in them.
+  for (uint16_t i = 0; i < threads; i++) {
+    PoolDeque* dq = &pool->deques[i];
+    pthread_mutex_init(&dq->lock, NULL);
+    dq->capacity = POOL_DEQUE_CAPACITY;
+    dq->jobs = (PoolJob*)malloc(dq->capacity * sizeof(PoolJob));
+    if (dq->jobs == NULL) {
+      DEBUG_PRINT("err! pool_init(): failed to allocate memory for the queues.\n");
+      pool->thread_count = i + 1;
+      pool_stop(pool, 0);
+      return -1;
+    }
+  }
+  pool->thread_count = threads;
+
+  uint16_t started = 0;
+  for (; started < threads; started++) {
+    PoolWorker* worker = (PoolWorker*)malloc(sizeof(PoolWorker));
+    if (worker == NULL) break;
+    *worker = (PoolWorker){pool, started};
+    if (pthread_create(&pool->threads[started], NULL, pool_worker, worker) != 0) {
+      free(worker);
+      break;
+    }
+  }
+  if (started < threads) {
+    DEBUG_PRINT("err! pool_init(): failed to start worker %u.\n", started);
+    pool_stop(pool, started);
+    return -1;
+  }
+  return 0;
+}
+
+int8_t pool_submit(Pool* pool, PoolTask fn, void* arg) {
+  // counted before it is pushed, so that a thread taking and finishing it right away
+  // never sees pending go past zero, and pool_wait() never returns early.
+  pthread_mutex_lock(&pool->lock);
+  const uint16_t target = (pool_self == pool) ? pool_self_index : pool->next++ % pool->thread_count;
+  pool->queued++;
+  pool->pending++;
+  pthread_mutex_unlock(&pool->lock);
+
+  const int8_t status = deque_push(&pool->deques[target], (PoolJob){fn, arg});
+  pthread_mutex_lock(&pool->lock);
+  if (status == 0) {
+    pthread_cond_signal(&pool->has_work);
+  } else {
+    pool->queued--;
+    if (--pool->pending == 0) pthread_cond_broadcast(&pool->idle);
+  }
+  pthread_mutex_unlock(&pool->lock);
+  return status;
+}
+
+void pool_wait(Pool* pool) {
+  PoolJob job;
+
+  pthread_mutex_lock(&pool->lock);
+  while (pool->pending != 0) {
+    if (pool->queued > 0) {
+      pthread_mutex_unlock(&pool->lock);
+      // not a worker, so every take is a steal.
+      if (pool_take(pool, pool->thread_count, &job)) {
+        job.fn(job.arg);
+        pool_finish(pool);
+      }
+      pthread_mutex_lock(&pool->lock);
+    } else {
+      pthread_cond_wait(&pool->idle, &pool->lock);
+    }
+  }
+  pthread_mutex_unlock(&pool->lock);
+}
+
+// Stops the first `started` workers, which exit once the deques are empty, and frees the pool.
+static void pool_stop(Pool* pool, uint16_t started) {
+  pthread_mutex_lock(&pool->lock);
+  pool->stopping = 1;
+  pthread_cond_broadcast(&pool->has_work);
+  pthread_mutex_unlock(&pool->lock);
+
+  for (uint16_t i = 0; i < started; i++) pthread_join(pool->threads[i], NULL);
+  for (uint16_t i = 0; i < pool->thread_count; i++) {
+    pthread_mutex_destroy(&pool->deques[i].lock);
+    free(pool->deques[i].jobs);
+  }
+
+  pthread_mutex_destroy(&pool->lock);
+  pthread_cond_destroy(&pool->has_work);
+  pthread_cond_destroy(&pool->idle);
+  free(pool->threads);
+  free(pool->deques);
+  *pool = (Pool){0};
+}
+
+void pool_destroy(Pool* pool) {
+  pool_stop(pool, pool->thread_count);
+}
@@ -0,0 +1,804 @@
+#include <math.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/color.h"
+#include "../include/deflate.h"
+#include "../include/pool.h"
+#include "../include/raster.h"
+#include "../include/strings.h"
+#include "../include/utils.h"
+
+// largest distance, in pixels, between a curve and the segments replacing it.
+#define FLATTEN_TOLERANCE 0.2f
+#define FLATTEN_MAX_SEGMENTS 128
+// distance of the control points of a cubic approximating a quarter circle of radius 1.
+#define CIRCLE_KAPPA 0.5522847498f
+// attributes kept per tag; the presets use at most five.
+#define MAX_ATTRS 16
+// nested groups whose fill is tracked; deeper ones pass on the fill of the deepest tracked one.
+#define MAX_GROUPS 16
+// pixels covered less than this are left untouched, more than 1 - this are fully covered.
+#define MIN_COVERAGE (1.0f / 1024)
+
+// plain comparisons: unlike fminf() and fmaxf(), which must order NaNs, they compile to single instructions.
+#define MIN(a, b) (((a) < (b)) ? (a) : (b))
+#define MAX(a, b) (((a) > (b)) ? (a) : (b))
+
+typedef struct {
+  StrView name;
+  StrView value;
+} Attr;
+
+typedef struct {
+  StrView name;
+  Attr attrs[MAX_ATTRS];
+  uint8_t count;
+} Tag;
+
+// The fill and fill-opacity an element passes on to its children; NULL strings when unset.
+typedef struct {
+  StrView fill;
+  StrView opacity;
+} Inherited;
+
+// Shape being built: maps user units to pixels and tracks the current contour.
+typedef struct {
+  Raster* r;
+  float sx, sy; // pixel = (user - origin) * scale.
+  float ox, oy;
+  float x, y;   // current point, in user units.
+  float start_x, start_y;
+} Pen;
+
+// Grows *items to hold at least needed elements of size bytes.
+static int8_t grow(void** items, uint64_t* capacity, uint64_t needed, size_t size) {
+  if (needed <= *capacity) return 0;
+  uint64_t grown = (*capacity != 0) ? *capacity : 64;
+  while (grown < needed) grown *= 2;
+  void* p = realloc(*items, grown * size);
+  if (p == NULL) {
+    DEBUG_PRINT("err! raster: failed to allocate memory.\n");
+    return -1;
+  }
+  *items = p;
+  *capacity = grown;
+  return 0;
+}
+
+static int8_t grow32(void** items, uint32_t* capacity, uint64_t needed, size_t size) {
+  uint64_t c = *capacity;
+  if (needed > UINT32_MAX || grow(items, &c, needed, size) != 0) return -1;
+  *capacity = (uint32_t)c;
+  return 0;
+}
+
+static StrView trim(StrView v) {
+  while (v.length > 0 && isspace((unsigned char)v.str[0])) v.str++, v.length--;
+  while (v.length > 0 && isspace((unsigned char)v.str[v.length - 1])) v.length--;
+  return v;
+}
+
+static int8_t view_is(StrView v, const char* s) {
+  return v.length == strlen(s) && memcmp(v.str, s, v.length) == 0;
+}
+
+static StrView tag_attr(const Tag* tag, const char* name) {
+  for (uint8_t i = 0; i < tag->count; i++) {
+    if (view_is(tag->attrs[i].name, name)) return tag->attrs[i].value;
+  }
+  return (StrView){NULL, 0};
+}
+
+// Reads the next number of a list separated by spaces and commas, moving *p past it.
+// Values are always followed by a quote in the document, so strtof never runs past them.
+static int8_t next_number(const char** p, const char* end, float* out) {
+  while (*p < end && (isspace((unsigned char)**p) || **p == ',')) (*p)++;
+  if (*p >= end) return -1;
+  char* after;
+  *out = strtof(*p, &after);
+  if (after == *p || after > end) return -1;
+  *p = after;
+  return 0;
+}
+
+static float attr_float(const Tag* tag, const char* name, float fallback) {
+  StrView v = tag_attr(tag, name);
+  const char* p = v.str;
+  float value;
+  return (v.str != NULL && next_number(&p, v.str + v.length, &value) == 0) ? value : fallback;
+}
+
+// Parses a paint into a packed colour and an alpha in 0-1.
+// Returns 1 for a colour, 0 for "none" and -1 for anything not understood.
+static int8_t parse_color(StrView v, Rgba* color, float* alpha) {
+  v = trim(v);
+  *alpha = 1.0f;
+  if (view_is(v, "none") || view_is(v, "transparent")) return 0;
+  if (view_is(v, "black")) {
+    *color = RGBA(0, 0, 0, 255);
+    return 1;
+  }
+  if (view_is(v, "white")) {
+    *color = RGBA(255, 255, 255, 255);
+    return 1;
+  }
+  if (v.length > 0 && v.str[0] == '#') return (color_parse_hex(v, color) == 0) ? 1 : -1;
+
+  // functional notations: rgb(), rgba(), hsl() and hsla().
+  const char* open = memchr(v.str, '(', v.length);
+  if (open == NULL || v.str[v.length - 1] != ')') return -1;
+  const StrView fn = {v.str, (uint64_t)(open - v.str)};
+  const int8_t hsl = view_is(fn, "hsl") || view_is(fn, "hsla");
+  if (!hsl && !view_is(fn, "rgb") && !view_is(fn, "rgba")) return -1;
+
+  float args[4] = {0, 0, 0, 1};
+  int8_t percent[4] = {0};
+  const char* p = open + 1;
+  const char* end = v.str + v.length - 1;
+  int n = 0;
+  while (n < 4 && next_number(&p, end, &args[n]) == 0) {
+    if (p < end && *p == '%') {
+      percent[n] = 1;
+      p++;
+    }
+    n++;
+  }
+  if (n < 3) return -1;
+
+  if (hsl) {
+    // converted like the compact SVG converts it, so that hsl() draws the same as its #rrggbb.
+    const float hue = fmodf(args[0], 360.0f);
+    *color = color_hsl((int32_t)lroundf(hue * 100), (int32_t)lroundf(fminf(fmaxf(args[1], 0.0f), 100.0f) * 100),
+      (int32_t)lroundf(fminf(fmaxf(args[2], 0.0f), 100.0f) * 100), 255);
+  } else {
+    uint8_t rgb[3];
+    for (int i = 0; i < 3; i++) rgb[i] = (uint8_t)lroundf(fminf(fmaxf(percent[i] ? args[i] * 2.55f : args[i], 0.0f), 255.0f));
+    *color = RGBA(rgb[0], rgb[1], rgb[2], 255);
+  }
+  *alpha = fminf(fmaxf(percent[3] ? args[3] / 100.0f : args[3], 0.0f), 1.0f);
+  return 1;
+}
+
+// Returns the fill and fill-opacity of a tag: those of its attributes and its style, or
+// else the ones inherited from its parent.
+static Inherited tag_inherited(const Tag* tag, Inherited parent) {
+  StrView fill = tag_attr(tag, "fill");
+  StrView opacity = tag_attr(tag, "fill-opacity");
+  StrView style = tag_attr(tag, "style");
+  if (fill.str == NULL) fill = parent.fill;
+  if (opacity.str == NULL) opacity = parent.opacity;
+
+  // declarations of style override the attributes, as in CSS.
+  const char* p = style.str;
+  const char* end = style.str + style.length;
+  while (p != NULL && p < end) {
+    const char* semi = memchr(p, ';', end - p);
+    const char* stop = (semi != NULL) ? semi : end;
+    const char* colon = memchr(p, ':', stop - p);
+    if (colon != NULL) {
+      const StrView name = trim((StrView){p, (uint64_t)(colon - p)});
+      const StrView value = {colon + 1, (uint64_t)(stop - colon - 1)};
+      if (view_is(name, "fill")) fill = value;
+      if (view_is(name, "fill-opacity")) opacity = value;
+    }
+    p = (semi != NULL) ? semi + 1 : NULL;
+  }
+  return (Inherited){fill, opacity};
+}
+
+// Resolves the fill of a tag, within a parent passing on `parent`.
+// Returns 1 when the tag is painted, 0 when it is not and -1 on an unknown paint.
+static int8_t tag_fill(const Tag* tag, Inherited parent, Rgba* color, float* alpha) {
+  const Inherited own = tag_inherited(tag, parent);
+  const StrView fill = own.fill, opacity = own.opacity;
+  // an element without a fill is painted black.
+  const int8_t painted = (fill.str != NULL) ? parse_color(fill, color, alpha) : parse_color((StrView)STR_LIT("black"), color, alpha);
+  if (painted == 1 && opacity.str != NULL) {
+    const char* q = opacity.str;
+    float a;
+    if (next_number(&q, opacity.str + opacity.length, &a) == 0) *alpha *= fminf(fmaxf(a, 0.0f), 1.0f);
+  }
+  return painted;
+}
+
+static int8_t add_edge(Pen* pen, float x0, float y0, float x1, float y1) {
+  Raster* r = pen->r;
+  x0 = (x0 - pen->ox) * pen->sx;
+  y0 = (y0 - pen->oy) * pen->sy;
+  x1 = (x1 - pen->ox) * pen->sx;
+  y1 = (y1 - pen->oy) * pen->sy;
+  // horizontal edges cover nothing.
+  if (y0 == y1) return 0;
+  if (grow32((void**)&r->edges, &r->edge_capacity, (uint64_t)r->edge_count + 1, sizeof(RasterEdge)) != 0) return -1;
+  r->edges[r->edge_count++] = (RasterEdge){x0, y0, x1, y1};
+  return 0;
+}
+
+static int8_t pen_line(Pen* pen, float x, float y) {
+  if (add_edge(pen, pen->x, pen->y, x, y) != 0) return -1;
+  pen->x = x;
+  pen->y = y;
+  return 0;
+}
+
+// Replaces a cubic Bezier from the current point by line segments.
+static int8_t pen_cubic(Pen* pen, float x1, float y1, float x2, float y2, float x3, float y3) {
+  const float x0 = pen->x, y0 = pen->y;
+  // Wang's bound on the segments needed, from the second differences in pixels.
+  const float ddx = fmaxf(fabsf(x0 - 2 * x1 + x2), fabsf(x1 - 2 * x2 + x3)) * pen->sx;
+  const float ddy = fmaxf(fabsf(y0 - 2 * y1 + y2), fabsf(y1 - 2 * y2 + y3)) * pen->sy;
+  int n = (int)ceilf(sqrtf(0.75f * sqrtf(ddx * ddx + ddy * ddy) / FLATTEN_TOLERANCE));
+  if (n < 1) n = 1;
+  if (n > FLATTEN_MAX_SEGMENTS) n = FLATTEN_MAX_SEGMENTS;
+
+  for (int i = 1; i <= n; i++) {
+    const float t = (float)i / n, u = 1 - t;
+    const float a = u * u * u, b = 3 * u * u * t, c = 3 * u * t * t, d = t * t * t;
+    if (pen_line(pen, a * x0 + b * x1 + c * x2 + d * x3, a * y0 + b * y1 + c * y2 + d * y3) != 0) return -1;
+  }
+  pen->x = x3; // exact end point, whatever the rounding above.
+  pen->y = y3;
+  return 0;
+}
+
+static void pen_move(Pen* pen, float x, float y) {
+  pen->x = pen->start_x = x;
+  pen->y = pen->start_y = y;
+}
+
+// Fills always treat contours as closed.
+static int8_t pen_close(Pen* pen) {
+  if (pen->x == pen->start_x && pen->y == pen->start_y) return 0;
+  return pen_line(pen, pen->start_x, pen->start_y);
+}
+
+static int8_t parse_path(Pen* pen, StrView d) {
+  const char* p = d.str;
+  const char* end = d.str + d.length;
+  char cmd = 0;
+  float v[6];
+
+  for (;;) {
+    while (p < end && (isspace((unsigned char)*p) || *p == ',')) p++;
+    if (p >= end) break;
+    if (isalpha((unsigned char)*p)) {
+      cmd = *p++;
+      if (cmd == 'Z' || cmd == 'z') {
+        if (pen_close(pen) != 0) return -1;
+        cmd = 0; // a command must follow.
+        continue;
+      }
+    } else if (cmd == 0) {
+      return -1;
+    }
+
+    // relative commands are offsets from the current point.
+    const float rx = islower((unsigned char)cmd) ? pen->x : 0;
+    const float ry = islower((unsigned char)cmd) ? pen->y : 0;
+    switch (toupper((unsigned char)cmd)) {
+      case 'M':
+        if (next_number(&p, end, &v[0]) != 0 || next_number(&p, end, &v[1]) != 0) return -1;
+        if (pen_close(pen) != 0) return -1;
+        pen_move(pen, rx + v[0], ry + v[1]);
+        cmd = islower((unsigned char)cmd) ? 'l' : 'L'; // further pairs are line-tos.
+        break;
+      case 'L':
+        if (next_number(&p, end, &v[0]) != 0 || next_number(&p, end, &v[1]) != 0) return -1;
+        if (pen_line(pen, rx + v[0], ry + v[1]) != 0) return -1;
+        break;
+      case 'H':
+        if (next_number(&p, end, &v[0]) != 0 || pen_line(pen, rx + v[0], pen->y) != 0) return -1;
+        break;
+      case 'V':
+        if (next_number(&p, end, &v[0]) != 0 || pen_line(pen, pen->x, ry + v[0]) != 0) return -1;
+        break;
+      case 'C':
+        for (int i = 0; i < 6; i++) {
+          if (next_number(&p, end, &v[i]) != 0) return -1;
+        }
+        if (pen_cubic(pen, rx + v[0], ry + v[1], rx + v[2], ry + v[3], rx + v[4], ry + v[5]) != 0) return -1;
+        break;
+      default:
+        DEBUG_PRINT("err! raster: unsupported path command %c.\n", cmd);
+        return -1;
+    }
+  }
+  return pen_close(pen);
+}
+
+static int8_t parse_circle(Pen* pen, float cx, float cy, float radius) {
+  const float k = radius * CIRCLE_KAPPA;
+  pen_move(pen, cx + radius, cy);
+  if (pen_cubic(pen, cx + radius, cy + k, cx + k, cy + radius, cx, cy + radius) != 0) return -1;
+  if (pen_cubic(pen, cx - k, cy + radius, cx - radius, cy + k, cx - radius, cy) != 0) return -1;
+  if (pen_cubic(pen, cx - radius, cy - k, cx - k, cy - radius, cx, cy - radius) != 0) return -1;
+  if (pen_cubic(pen, cx + k, cy - radius, cx + radius, cy - k, cx + radius, cy) != 0) return -1;
+  return 0;
+}
+
+// Sets up the canvas from the <svg> tag.
+static int8_t parse_canvas(Raster* r, Pen* pen, const Tag* tag) {
+  float view[4] = {0, 0, 0, 0};
+  StrView box = tag_attr(tag, "viewBox");
+  const char* p = box.str;
+  int8_t has_view = box.str != NULL;
+  for (int i = 0; has_view && i < 4; i++) has_view = next_number(&p, box.str + box.length, &view[i]) == 0;
+  if (has_view && (view[2] <= 0 || view[3] <= 0)) has_view = 0;
+
+  const float width = attr_float(tag, "width", has_view ? view[2] : 0);
+  const float height = attr_float(tag, "height", has_view ? view[3] : 0);
+  if (!(width >= 1 && height >= 1 && width <= UINT16_MAX && height <= UINT16_MAX)) {
+    DEBUG_PRINT("err! raster: invalid canvas size.\n");
+    return -1;
+  }
+  r->width = (uint16_t)ceilf(width);
+  r->height = (uint16_t)ceilf(height);
+  r->scale_x = pen->sx = has_view ? width / view[2] : 1;
+  r->scale_y = pen->sy = has_view ? height / view[3] : 1;
+  r->origin_x = pen->ox = has_view ? view[0] : 0;
+  r->origin_y = pen->oy = has_view ? view[1] : 0;
+  return 0;
+}
+
+// Adds shape, whose edges are the ones added since shape.first, unless it is off the canvas.
+static int8_t add_shape(Raster* r, RasterShape shape) {
+  shape.count = r->edge_count - shape.first;
+  if (shape.count == 0) return 0;
+  float x0 = INFINITY, y0 = INFINITY, x1 = -INFINITY, y1 = -INFINITY;
+  for (uint32_t i = shape.first; i < r->edge_count; i++) {
+    const RasterEdge* e = &r->edges[i];
+    x0 = fminf(x0, fminf(e->x0, e->x1));
+    x1 = fmaxf(x1, fmaxf(e->x0, e->x1));
+    y0 = fminf(y0, fminf(e->y0, e->y1));
+    y1 = fmaxf(y1, fmaxf(e->y0, e->y1));
+  }
+  // bounds in pixels, clipped to the canvas.
+  shape.x0 = (int32_t)fmaxf(floorf(x0), 0);
+  shape.y0 = (int32_t)fmaxf(floorf(y0), 0);
+  shape.x1 = (int32_t)fminf(ceilf(x1), r->width);
+  shape.y1 = (int32_t)fminf(ceilf(y1), r->height);
+  if (shape.x0 >= shape.x1 || shape.y0 >= shape.y1) {
+    r->edge_count = shape.first; // off the canvas.
+    return 0;
+  }
+
+  if (grow32((void**)&r->shapes, &r->shape_capacity, (uint64_t)r->shape_count + 1, sizeof(RasterShape)) != 0) return -1;
+  r->shapes[r->shape_count++] = shape;
+  return 0;
+}
+
+// Adds the shape drawn by a <rect>, <circle> or <path> tag.
+static int8_t parse_shape(Raster* r, Pen* pen, const Tag* tag, Inherited parent) {
+  RasterShape shape = {.first = r->edge_count};
+  const int8_t painted = tag_fill(tag, parent, &shape.color, &shape.alpha);
+  if (painted < 0) {
+    DEBUG_PRINT("err! raster: unsupported fill on <%.*s>.\n", (int)tag->name.length, tag->name.str);
+    return -1;
+  }
+  if (painted == 0 || shape.alpha <= 0) return 0;
+
+  int8_t status = 0;
+  if (view_is(tag->name, "rect")) {
+    const float x = attr_float(tag, "x", 0), y = attr_float(tag, "y", 0);
+    const float w = attr_float(tag, "width", 0), h = attr_float(tag, "height", 0);
+    if (w <= 0 || h <= 0) return 0;
+    pen_move(pen, x, y);
+    status = (pen_line(pen, x + w, y) != 0 || pen_line(pen, x + w, y + h) != 0 ||
+        pen_line(pen, x, y + h) != 0 || pen_close(pen) != 0) ? -1 : 0;
+  } else if (view_is(tag->name, "circle")) {
+    const float radius = attr_float(tag, "r", 0);
+    if (radius <= 0) return 0;
+    status = parse_circle(pen, attr_float(tag, "cx", 0), attr_float(tag, "cy", 0), radius);
+  } else {
+    pen_move(pen, 0, 0);
+    StrView d = tag_attr(tag, "d");
+    status = (d.str != NULL) ? parse_path(pen, d) : 0;
+  }
+  return (status == 0) ? add_shape(r, shape) : -1;
+}
+
+// Reads the tag starting after its '<'. Returns a pointer past its '>' or NULL when malformed.
+static const char* parse_tag(const char* p, const char* end, Tag* tag) {
+  const char* name = p;
+  while (p < end && (isalnum((unsigned char)*p) || *p == ':' || *p == '-')) p++;
+  tag->name = (StrView){name, (uint64_t)(p - name)};
+  tag->count = 0;
+
+  for (;;) {
+    while (p < end && isspace((unsigned char)*p)) p++;
+    if (p >= end) return NULL;
+    if (*p == '>' || *p == '/') {
+      const char* close = memchr(p, '>', end - p);
+      return (close != NULL) ? close + 1 : NULL;
+    }
+    const char* attr = p;
+    while (p < end && *p != '=' && !isspace((unsigned char)*p) && *p != '>') p++;
+    const StrView attr_name = {attr, (uint64_t)(p - attr)};
+    while (p < end && isspace((unsigned char)*p)) p++;
+    if (p >= end || *p != '=') return NULL;
+    p++;
+    while (p < end && isspace((unsigned char)*p)) p++;
+    if (p >= end || (*p != '"' && *p != '\'')) return NULL;
+    const char quote = *p++;
+    const char* value = p;
+    const char* close = memchr(p, quote, end - p);
+    if (close == NULL) return NULL;
+    if (tag->count < MAX_ATTRS) tag->attrs[tag->count++] = (Attr){attr_name, {value, (uint64_t)(close - value)}};
+    p = close + 1;
+  }
+}
+
+int8_t raster_fill_cubics(Raster* r, const float* x, const float* y, uint32_t count, Rgba color) {
+  const RasterShape shape = {.first = r->edge_count, .color = color, .alpha = rgba_alpha(color) / 255.0f};
+  if (shape.alpha <= 0) return 0;
+  Pen pen = {.r = r, .sx = r->scale_x, .sy = r->scale_y, .ox = r->origin_x, .oy = r->origin_y};
+  pen_move(&pen, x[0], y[0]);
+  for (uint32_t i = 0; i < count; i++) {
+    if (pen_cubic(&pen, x[3 * i + 1], y[3 * i + 1], x[3 * i + 2], y[3 * i + 2], x[3 * i + 3], y[3 * i + 3]) != 0) return -1;
+  }
+  return (pen_close(&pen) == 0) ? add_shape(r, shape) : -1;
+}
+
+// Has splice() add its shapes, once the canvas is known.
+static int8_t run_splice(Raster* r, RasterSplice splice, void* arg) {
+  if (r->width == 0) {
+    DEBUG_PRINT("err! raster_parse_svg(): shapes spliced before the <svg> element.\n");
+    return -1;
+  }
+  return splice(r, arg);
+}
+
+int8_t raster_parse_svg(Raster* r, StrView svg) {
+  return raster_parse_svg_spliced(r, svg, svg.length, NULL, NULL);
+}
+
+int8_t raster_parse_svg_spliced(Raster* r, StrView svg, uint64_t at, RasterSplice splice, void* arg) {
+  const char* p = svg.str;
+  const char* end = svg.str + svg.length;
+  Pen pen = {.r = r, .sx = 1, .sy = 1};
+  Tag tag;
+  // what the open groups pass on; groups[0] is the document.
+  Inherited groups[MAX_GROUPS + 1] = {{{NULL, 0}, {NULL, 0}}};
+  uint32_t depth = 0;
+
+  r->width = r->height = 0;
+  r->edge_count = r->shape_count = 0;
+  while (p < end && (p = memchr(p, '<', end - p)) != NULL) {
+    // the spliced shapes come before the first tag at or after `at`.
+    if (splice != NULL && (uint64_t)(p - svg.str) >= at) {
+      if (run_splice(r, splice, arg) != 0) return -1;
+      splice = NULL;
+    }
+    p++;
+    // declarations, comments and closing tags.
+    if (p < end && (*p == '?' || *p == '!' || *p == '/')) {
+      const char* close = p;
+      p = memchr(p, '>', end - p);
+      if (p == NULL) break;
+      if (depth > 0 && view_is(trim((StrView){close + 1, (uint64_t)(p - close - 1)}), "g")) depth--;
+      continue;
+    }
+    p = parse_tag(p, end, &tag);
+    if (p == NULL) {
+      DEBUG_PRINT("err! raster_parse_svg(): malformed tag.\n");
+      return -1;
+    }
+
+    const Inherited* parent = &groups[(depth < MAX_GROUPS) ? depth : MAX_GROUPS];
+    if (view_is(tag.name, "svg")) {
+      if (r->width == 0 && parse_canvas(r, &pen, &tag) != 0) return -1;
+    } else if (view_is(tag.name, "g")) {
+      // an empty <g/> holds nothing.
+      if (p[-2] != '/' && ++depth <= MAX_GROUPS) groups[depth] = tag_inherited(&tag, *parent);
+    } else if (view_is(tag.name, "rect") || view_is(tag.name, "circle") || view_is(tag.name, "path")) {
+      if (r->width != 0 && parse_shape(r, &pen, &tag, *parent) != 0) return -1;
+    }
+  }
+  if (r->width == 0) {
+    DEBUG_PRINT("err! raster_parse_svg(): no <svg> element.\n");
+    return -1;
+  }
+  return (splice != NULL) ? run_splice(r, splice, arg) : 0;
+}
+
+// Adds the signed area a line covers in each pixel to acc, a grid of rows of `stride` cells.
+// Integrating a row left to right then gives the coverage of each pixel.
+// The line must lie within x in [0, stride - 2] and y within the rows of acc.
+static void accumulate_line(float* acc, uint32_t stride, float x0, float y0, float x1, float y1) {
+  float dir = 1;
+  if (y0 > y1) {
+    float t = x0; x0 = x1; x1 = t;
+    t = y0; y0 = y1; y1 = t;
+    dir = -1;
+  }
+  const float xmax = (float)(stride - 2);
+  const float dxdy = (x1 - x0) / (y1 - y0);
+  const int32_t ystart = (int32_t)y0;
+  const int32_t yend = (int32_t)ceilf(y1);
+  float x = x0;
+
+  for (int32_t y = ystart; y < yend; y++) {
+    float* row = acc + (uint64_t)y * stride;
+    const float dy = MIN((float)(y + 1), y1) - MAX((float)y, y0);
+    const float xnext = MIN(MAX(x + dxdy * dy, 0), xmax);
+    const float d = dy * dir;
+    const float xa = MIN(x, xnext), xb = MAX(x, xnext);
+    const float xa_floor = floorf(xa);
+    const int32_t xai = (int32_t)xa_floor;
+    const float xb_ceil = ceilf(xb);
+    const int32_t xbi = (int32_t)xb_ceil;
+
+    if (xbi <= xai + 1) {
+      // within one pixel: split by the mean position of the line.
+      const float xmf = 0.5f * (x + xnext) - xa_floor;
+      row[xai] += d - d * xmf;
+      row[xai + 1] += d * xmf;
+    } else {
+      // across pixels: triangles at both ends and equal slices in between.
+      const float s = 1.0f / (xb - xa);
+      const float xaf = xa - xa_floor;
+      const float a0 = 0.5f * s * (1 - xaf) * (1 - xaf);
+      const float xbf = xb - xb_ceil + 1.0f;
+      const float am = 0.5f * s * xbf * xbf;
+      row[xai] += d * a0;
+      if (xbi == xai + 2) {
+        row[xai + 1] += d * (1 - a0 - am);
+      } else {
+        const float a1 = s * (1.5f - xaf);
+        row[xai + 1] += d * (a1 - a0);
+        for (int32_t xi = xai + 2; xi < xbi - 1; xi++) row[xi] += d * s;
+        const float a2 = a1 + (float)(xbi - xai - 3) * s;
+        row[xbi - 1] += d * (1 - a2 - am);
+      }
+      row[xbi] += d * am;
+    }
+    x = xnext;
+  }
+}
+
+// Clips a line to a w x h region before accumulating it. Parts above or below the
+// region are dropped. Parts left of it still cover every pixel to their right, so
+// they are pressed flat against x = 0; parts right of it against x = w, where
+// they only reach the spare cell past the end of the row.
+static void accumulate_clipped(float* acc, uint32_t stride, float w, float h, float x0, float y0, float x1, float y1) {
+  if (y0 == y1 || (y0 <= 0 && y1 <= 0) || (y0 >= h && y1 >= h) || (x0 >= w && x1 >= w)) return;
+
+  const float dxdy = (x1 - x0) / (y1 - y0);
+  if (y0 < 0) { x0 += (0 - y0) * dxdy; y0 = 0; }
+  if (y1 < 0) { x1 += (0 - y1) * dxdy; y1 = 0; }
+  if (y0 > h) { x0 += (h - y0) * dxdy; y0 = h; }
+  if (y1 > h) { x1 += (h - y1) * dxdy; y1 = h; }
+  if (y0 == y1) return;
+
+  // split where the line crosses x = 0 and x = w.
+  float ts[2];
+  int n = 0;
+  if (x0 != x1) {
+    const float bounds[2] = {0, w};
+    for (int i = 0; i < 2; i++) {
+      const float t = (bounds[i] - x0) / (x1 - x0);
+      if (t > 0 && t < 1) ts[n++] = t;
+    }
+    if (n == 2 && ts[0] > ts[1]) {
+      const float t = ts[0]; ts[0] = ts[1]; ts[1] = t;
+    }
+  }
+  float px = x0, py = y0;
+  for (int i = 0; i <= n; i++) {
+    const float nx = (i < n) ? x0 + (x1 - x0) * ts[i] : x1;
+    const float ny = (i < n) ? y0 + (y1 - y0) * ts[i] : y1;
+    if (py != ny) accumulate_line(acc, stride, MIN(MAX(px, 0), w), py, MIN(MAX(nx, 0), w), ny);
+    px = nx;
+    py = ny;
+  }
+}
+
+static uint32_t tiles_across(const Raster* r) {
+  return (r->width + RASTER_TILE - 1) / RASTER_TILE;
+}
+
+static uint32_t tile_count(const Raster* r) {
+  return tiles_across(r) * ((r->height + RASTER_TILE - 1) / RASTER_TILE);
+}
+
+// Blends the shapes of tile t, in document order, using acc as scratch space.
+static void render_tile(Raster* r, uint32_t t, float* acc) {
+  const int32_t tx0 = (int32_t)(t % tiles_across(r)) * RASTER_TILE;
+  const int32_t ty0 = (int32_t)(t / tiles_across(r)) * RASTER_TILE;
+  const int32_t tx1 = (tx0 + RASTER_TILE < r->width) ? tx0 + RASTER_TILE : r->width;
+  const int32_t ty1 = (ty0 + RASTER_TILE < r->height) ? ty0 + RASTER_TILE : r->height;
+
+  for (uint32_t b = r->bin_start[t]; b < r->bin_start[t + 1]; b++) {
+    const RasterShape* shape = &r->shapes[r->bins[b]];
+    // only the part of the tile under the shape is touched.
+    const int32_t x0 = (shape->x0 > tx0) ? shape->x0 : tx0;
+    const int32_t y0 = (shape->y0 > ty0) ? shape->y0 : ty0;
+    const int32_t x1 = (shape->x1 < tx1) ? shape->x1 : tx1;
+    const int32_t y1 = (shape->y1 < ty1) ? shape->y1 : ty1;
+    const uint32_t w = x1 - x0, h = y1 - y0, stride = w + 2;
+
+    memset(acc, 0, (uint64_t)h * stride * sizeof(float));
+    for (uint32_t i = shape->first; i < shape->first + shape->count; i++) {
+      const RasterEdge* e = &r->edges[i];
+      accumulate_clipped(acc, stride, (float)w, (float)h, e->x0 - x0, e->y0 - y0, e->x1 - x0, e->y1 - y0);
+    }
+
+    const float alpha = shape->alpha;
+    const float src[4] = {rgba_red(shape->color) * alpha, rgba_green(shape->color) * alpha, rgba_blue(shape->color) * alpha, 255.0f * alpha};
+    // fully covered pixels, most of a shape, blend in 16.16 fixed point.
+    const uint32_t keep_full = (uint32_t)((1.0f - alpha) * 65536.0f + 0.5f);
+    uint32_t src_full[4];
+    for (int i = 0; i < 4; i++) src_full[i] = (uint32_t)(src[i] * 65536.0f) + 32768;
+
+    for (uint32_t y = 0; y < h; y++) {
+      const float* row = acc + (uint64_t)y * stride;
+      uint8_t* px = r->pixels + ((uint64_t)(y0 + y) * r->width + x0) * 4;
+      float cover = 0;
+      for (uint32_t x = 0; x < w; x++, px += 4) {
+        cover += row[x];
+        const float c = MIN((cover < 0) ? -cover : cover, 1.0f);
+        if (c >= 1.0f - MIN_COVERAGE) {
+          for (int i = 0; i < 4; i++) px[i] = (uint8_t)((src_full[i] + px[i] * keep_full) >> 16);
+        } else if (c >= MIN_COVERAGE) {
+          // source over destination, premultiplied.
+          const float keep = 1.0f - alpha * c;
+          for (int i = 0; i < 4; i++) px[i] = (uint8_t)(src[i] * c + px[i] * keep + 0.5f);
+        }
+      }
+    }
+  }
+}
+
+// Pool task: renders tiles until none are left.
+static void render_tiles(void* arg) {
+  Raster* r = arg;
+  float acc[(RASTER_TILE + 2) * RASTER_TILE];
+  const uint32_t tiles = tile_count(r);
+  for (;;) {
+    const uint32_t t = __atomic_fetch_add(&r->next_tile, 1, __ATOMIC_RELAXED);
+    if (t >= tiles) break;
+    render_tile(r, t, acc);
+  }
+}
+
+// Lists, for every tile, the shapes whose bounds reach into it.
+static int8_t bin_shapes(Raster* r) {
+  const uint32_t across = tiles_across(r);
+  const uint32_t tiles = tile_count(r);
+  if (grow32((void**)&r->bin_start, &r->bin_start_capacity, (uint64_t)tiles + 1, sizeof(uint32_t)) != 0) return -1;
+  memset(r->bin_start, 0, ((uint64_t)tiles + 1) * sizeof(uint32_t));
+
+  // count into bin_start[t + 1], then prefix sums turn counts into offsets.
+  uint64_t total = 0;
+  for (uint32_t s = 0; s < r->shape_count; s++) {
+    const RasterShape* shape = &r->shapes[s];
+    for (int32_t ty = shape->y0 / RASTER_TILE; ty <= (shape->y1 - 1) / RASTER_TILE; ty++) {
+      for (int32_t tx = shape->x0 / RASTER_TILE; tx <= (shape->x1 - 1) / RASTER_TILE; tx++) {
+        r->bin_start[ty * across + tx + 1]++;
+        total++;
+      }
+    }
+  }
+  if (total > UINT32_MAX || grow((void**)&r->bins, &r->bin_capacity, total, sizeof(uint32_t)) != 0) return -1;
+  for (uint32_t t = 0; t < tiles; t++) r->bin_start[t + 1] += r->bin_start[t];
+
+  // bin_start[t] serves as the fill cursor of tile t, which leaves it at the start of t + 1.
+  for (uint32_t s = 0; s < r->shape_count; s++) {
+    const RasterShape* shape = &r->shapes[s];
+    for (int32_t ty = shape->y0 / RASTER_TILE; ty <= (shape->y1 - 1) / RASTER_TILE; ty++) {
+      for (int32_t tx = shape->x0 / RASTER_TILE; tx <= (shape->x1 - 1) / RASTER_TILE; tx++) {
+        r->bins[r->bin_start[ty * across + tx]++] = s;
+      }
+    }
+  }
+  memmove(r->bin_start + 1, r->bin_start, (uint64_t)tiles * sizeof(uint32_t));
+  r->bin_start[0] = 0;
+  return 0;
+}
+
+int8_t raster_render(Raster* r, Pool* pool) {
+  const uint64_t size = (uint64_t)r->width * r->height * 4;
+  if (grow((void**)&r->pixels, &r->pixels_capacity, size, 1) != 0) return -1;
+  memset(r->pixels, 0, size);
+  if (bin_shapes(r) != 0) return -1;
+
+  r->next_tile = 0;
+  if (pool == NULL) {
+    render_tiles(r);
+    return 0;
+  }
+  // one task per thread, each taking tiles as it finishes the previous one.
+  const uint32_t tasks = (pool->thread_count < tile_count(r)) ? pool->thread_count : tile_count(r);
+  for (uint32_t i = 0; i < tasks; i++) {
+    if (pool_submit(pool, render_tiles, r) != 0) break;
+  }
+  pool_wait(pool);
+  // tiles left by a failed submit.
+  render_tiles(r);
+  return 0;
+}
+
+static int8_t append_be32(StrBuilder* out, uint32_t n) {
+  const uint8_t bytes[4] = {n >> 24, (n >> 16) & 0xFF, (n >> 8) & 0xFF, n & 0xFF};
+  return str_builder_append_n(out, (const char*)bytes, 4);
+}
+
+int8_t raster_write_ppm(const Raster* r, StrBuilder* out) {
+  if (str_builder_grow(out, 32 + (uint64_t)r->width * r->height * 3) != 0) return -1;
+  if (str_builder_append_fmt(out, "P6\n%u %u\n255\n", (unsigned)r->width, (unsigned)r->height) != 0) return -1;
+  // premultiplied colour is the colour composited over black.
+  char* rgb = out->str + out->length;
+  const uint8_t* px = r->pixels;
+  for (uint64_t i = 0; i < (uint64_t)r->width * r->height; i++, px += 4) {
+    *rgb++ = (char)px[0];
+    *rgb++ = (char)px[1];
+    *rgb++ = (char)px[2];
+  }
+  out->length = rgb - out->str;
+  out->str[out->length] = '\0';
+  return 0;
+}
+
+// Appends a PNG chunk holding length bytes of data.
+static int8_t png_chunk(StrBuilder* out, const char type[4], const uint8_t* data, uint32_t length) {
+  if (append_be32(out, length) != 0) return -1;
+  const uint64_t start = out->length;
+  if (str_builder_append_n(out, type, 4) != 0 || str_builder_append_n(out, (const char*)data, length) != 0) return -1;
+  return append_be32(out, crc32_update(0, (const uint8_t*)out->str + start, length + 4));
+}
+
+int8_t raster_write_png(const Raster* r, StrBuilder* out) {
+  const uint8_t ihdr[13] = {
+    0, 0, r->width >> 8, r->width & 0xFF,   // big endian width and height
+    0, 0, r->height >> 8, r->height & 0xFF,
+    8, 6, 0, 0, 0 // 8 bit RGBA, deflate, adaptive filtering, no interlace
+  };
+  if (str_builder_append_n(out, "\x89PNG\r\n\x1a\n", 8) != 0 || png_chunk(out, "IHDR", ihdr, sizeof(ihdr)) != 0) return -1;
+
+  // IDAT is streamed, its length is filled in once known.
+  const uint64_t idat = out->length;
+  if (str_builder_append_n(out, "\0\0\0\0IDAT", 8) != 0) return -1;
+  Gzip z;
+  if (zlib_begin(&z, out) != 0) return -1;
+
+  uint8_t chunk[1024];
+  for (uint32_t y = 0; y < r->height; y++) {
+    const uint8_t* px = r->pixels + (uint64_t)y * r->width * 4;
+    uint32_t n = 0;
+    chunk[n++] = 0; // filter type of the row: none.
+    for (uint32_t x = 0; x < r->width; x++, px += 4) {
+      if (n + 4 > sizeof(chunk)) {
+        if (gzip_write(&z, chunk, n) != 0) goto fail;
+        n = 0;
+      }
+      // PNG stores straight alpha.
+      const uint8_t a = px[3];
+      for (int i = 0; i < 3; i++) chunk[n++] = (a == 255 || a == 0) ? px[i] : (uint8_t)((px[i] * 255 + a / 2) / a);
+      chunk[n++] = a;
+    }
+    if (gzip_write(&z, chunk, n) != 0) goto fail;
+  }
+  if (gzip_end(&z) != 0) goto fail;
+  gzip_free(&z);
+
+  const uint64_t length = out->length - idat - 8;
+  if (length > UINT32_MAX) return -1;
+  for (int i = 0; i < 4; i++) out->str[idat + i] = (char)((length >> (24 - 8 * i)) & 0xFF);
+  if (append_be32(out, crc32_update(0, (const uint8_t*)out->str + idat + 4, length + 4)) != 0) return -1;
+  return png_chunk(out, "IEND", (const uint8_t*)"", 0);
+
+fail:
+  gzip_free(&z);
+  return -1;
+}
+
+void raster_free(Raster* r) {
+  free(r->pixels);
+  free(r->edges);
+  free(r->shapes);
+  free(r->bins);
+  free(r->bin_start);
+  *r = (Raster){0};
+}
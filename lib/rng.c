@@ -0,0 +1,75 @@
+#include <stdint.h>
+#include "../include/rng.h"
+
+static uint64_t splitmix64(uint64_t* x) {
+  uint64_t z = (*x += 0x9E3779B97F4A7C15ull);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  return z ^ (z >> 31);
+}
+
+static inline uint64_t rotl(uint64_t x, int k) {
+  return (x << k) | (x >> (64 - k));
+}
+
+void rng_seed(Rng* rng, uint64_t seed) {
+  // splitmix64 never yields four zero words, which is the one state xoshiro cannot leave.
+  for (int i = 0; i < 4; i++) rng->s[i] = splitmix64(&seed);
+}
+
+uint64_t rng_next(Rng* rng) {
+  uint64_t* s = rng->s;
+  const uint64_t result = rotl(s[1] * 5, 7) * 9;
+  const uint64_t t = s[1] << 17;
+
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = rotl(s[3], 45);
+
+  return result;
+}
+
+float rng_float(Rng* rng) {
+  return (rng_next(rng) >> 40) * 0x1.0p-24f;
+}
+
+uint32_t rng_below(Rng* rng, uint32_t n) {
+  // Lemire's multiply and reject.
+  uint64_t m = (rng_next(rng) >> 32) * n;
+  if ((uint32_t)m < n) {
+    uint32_t threshold = -n % n;
+    while ((uint32_t)m < threshold) m = (rng_next(rng) >> 32) * n;
+  }
+  return m >> 32;
+}
+
+void rng_fill_range(Rng* rng, float* out, uint64_t n, float lo, float hi) {
+  const float span = hi - lo;
+  for (uint64_t i = 0; i < n; i++) {
+    out[i] = lo + (rng_next(rng) >> 40) * 0x1.0p-24f * span;
+  }
+}
+
+void rng_stream(const Rng* parent, uint64_t stream, Rng* out) {
+  uint64_t key = parent->s[0] ^ rotl(parent->s[1], 17) ^ rotl(parent->s[2], 31) ^ rotl(parent->s[3], 47);
+  key ^= splitmix64(&stream);
+  rng_seed(out, key);
+}
+
+void rng_jump(Rng* rng) {
+  static const uint64_t JUMP[] = {0x180ec6d33cfd0aba, 0xd5a61266f0c9392c, 0xa9582618e03fc9aa, 0x39abdc4529b1661c};
+  uint64_t s[4] = {0, 0, 0, 0};
+
+  for (int i = 0; i < 4; i++) {
+    for (int b = 0; b < 64; b++) {
+      if (JUMP[i] & (uint64_t)1 << b) {
+        for (int k = 0; k < 4; k++) s[k] ^= rng->s[k];
+      }
+      rng_next(rng);
+    }
+  }
+  for (int k = 0; k < 4; k++) rng->s[k] = s[k];
+}
@@ -0,0 +1,946 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "../include/script.h"
+#include "../include/fmt.h"
+#include "../include/utils.h"
+
+/*
+The bytecode is a sequence of one byte opcodes followed by their operands, stored
+little endian without alignment. The stack holds numbers; text goes straight to the output.
+Jump offsets are relative to the end of the instruction that holds them.
+*/
+enum {
+  OP_END,       //                         end of the script.
+  OP_TEXT,      // u32 offset, u32 length  writes literal text.
+  OP_NUM,       // u16 index               pushes a constant.
+  OP_WIDTH,     //                         pushes the canvas width.
+  OP_HEIGHT,    //                         pushes the canvas height.
+  OP_DENSITY,   //                         replaces the default on top with the requested density, if any.
+  OP_LOAD,      // u8 slot                 pushes a let.
+  OP_STORE,     // u8 slot                 pops into a let.
+  OP_ADD,
+  OP_SUB,
+  OP_MUL,
+  OP_DIV,
+  OP_NEG,
+  OP_RANDOM,    //                         pops b and a, pushes a uniform number in [a, b).
+  OP_ROUND,
+  OP_EMIT,      //                         pops a number and writes it.
+  OP_JUMP,      // i32 offset
+  OP_JUMP_DARK, // i32 offset              jumps when the theme is dark.
+  OP_PICK,      // u16 n, n * i32 offset   jumps to one of n alternatives at random.
+  OP_REPEAT,    // i32 offset              pops a count, skips the loop body when it is below 1.
+  OP_LOOP,      // i32 offset              jumps back to the body until the count runs out.
+  OP_COUNT
+};
+
+// header of a cache file, followed by the code, the numbers and the text.
+typedef struct CacheHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t key;      // hash of the source.
+  uint64_t checksum; // hash of what follows the header.
+  uint32_t code_length;
+  uint32_t text_length;
+  uint16_t number_count;
+  uint8_t let_count;
+  uint8_t padding[5];
+} CacheHeader;
+
+#define CACHE_MAGIC "WKSC"
+
+// ### compiler ###
+
+typedef enum { TYPE_NUMBER, TYPE_TEXT } ValueType;
+
+typedef struct Decl {
+  StrView name;
+  StrView expr;      // source of the expression.
+  uint32_t line;
+  int16_t slot;      // slot of a let, -1 for a def.
+  int8_t expanding;  // set while a def is compiled, to catch definitions that use themselves.
+} Decl;
+
+typedef struct Compiler {
+  const char* name;
+  StrBuilder code;
+  StrBuilder text;
+  double* numbers;
+  uint16_t number_count;
+  uint16_t number_capacity;
+  Decl* decls;
+  uint16_t decl_count;
+  uint16_t decl_capacity;
+  uint8_t let_count; // lets that have been compiled, and so can be used.
+  int depth;         // numbers on the stack at this point of the code.
+  int loops;         // svg_tags[] being compiled, one inside the other.
+  int expansions;    // defs being compiled, one inside the other.
+  int nesting;       // expressions being compiled, one inside the other.
+} Compiler;
+
+// the part of the source being compiled: the document, or the expression of a declaration.
+typedef struct Parser {
+  Compiler* c;
+  const char* at;
+  const char* end;
+  uint32_t line;
+} Parser;
+
+#define MAX_EXPANSIONS 64
+// bounds the recursion of the parser, which would otherwise run out of C stack.
+#define MAX_NESTING 256
+
+static const char* const BUILTINS[] = {
+  "canvas_width", "canvas_height", "density", "random_range", "round", "theme", "text", "svg_tag", "svg_tags",
+};
+
+static int8_t fail(const Parser* p, const char* message) {
+  DEBUG_PRINT("err! script %s:%u: %s.\n", p->c->name, p->line, message);
+  return -1;
+}
+
+static int8_t emit_byte(Compiler* c, uint8_t byte) {
+  return str_builder_append_n(&c->code, (const char*)&byte, 1);
+}
+
+static int8_t emit_u16(Compiler* c, uint16_t n) {
+  return str_builder_append_n(&c->code, (const char*)&n, sizeof(n));
+}
+
+static int8_t emit_u32(Compiler* c, uint32_t n) {
+  return str_builder_append_n(&c->code, (const char*)&n, sizeof(n));
+}
+
+// emits a jump with an offset to be patched, and returns where the offset is, or -1.
+static int64_t emit_jump(Compiler* c, uint8_t op) {
+  if (emit_byte(c, op) != 0) return -1;
+  const int64_t at = c->code.length;
+  return (emit_u32(c, 0) == 0) ? at : -1;
+}
+
+// points the offset at `at` to the current end of the code.
+static void patch_jump(Compiler* c, int64_t at) {
+  const int32_t offset = (int32_t)(c->code.length - (at + sizeof(int32_t)));
+  memcpy(c->code.str + at, &offset, sizeof(offset));
+}
+
+// keeps the stack depth the compiler tracks in line with the code it emits.
+static int8_t push(Parser* p, int n) {
+  p->c->depth += n;
+  return (p->c->depth > SCRIPT_MAX_STACK) ? fail(p, "expression too deep") : 0;
+}
+
+static int8_t emit_text(Parser* p, const char* text, uint64_t length) {
+  Compiler* c = p->c;
+  if (length == 0) return 0;
+  if (c->text.length + length > UINT32_MAX) return fail(p, "too much text");
+  const uint32_t offset = c->text.length;
+  if (str_builder_append_n(&c->text, text, length) != 0 || emit_byte(c, OP_TEXT) != 0 ||
+      emit_u32(c, offset) != 0 || emit_u32(c, length) != 0) {
+    return -1;
+  }
+  return 0;
+}
+
+static int8_t emit_number(Parser* p, double n) {
+  Compiler* c = p->c;
+  uint16_t index = 0;
+  while (index < c->number_count && memcmp(&c->numbers[index], &n, sizeof(n)) != 0) index++;
+  if (index == c->number_count) {
+    if (c->number_count == UINT16_MAX) return fail(p, "too many numbers");
+    if (c->number_count == c->number_capacity) {
+      const uint16_t grown_capacity = (c->number_capacity == 0) ? 16 : (c->number_capacity > UINT16_MAX / 2) ? UINT16_MAX : c->number_capacity * 2;
+      double* grown = (double*)realloc(c->numbers, grown_capacity * sizeof(double));
+      if (grown == NULL) {
+        DEBUG_PRINT("err! emit_number(): failed to allocate memory for the numbers.\n");
+        return -1;
+      }
+      c->numbers = grown;
+      c->number_capacity = grown_capacity;
+    }
+    c->numbers[c->number_count++] = n;
+  }
+  if (emit_byte(c, OP_NUM) != 0 || emit_u16(c, index) != 0) return -1;
+  return push(p, 1);
+}
+
+static int is_ident(char ch, int first) {
+  return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || ch == '_' || (!first && ch >= '0' && ch <= '9');
+}
+
+static void skip_space(Parser* p) {
+  while (p->at < p->end && (*p->at == ' ' || *p->at == '\t')) p->at++;
+}
+
+static int8_t accept(Parser* p, char ch) {
+  skip_space(p);
+  if (p->at < p->end && *p->at == ch) {
+    p->at++;
+    return 1;
+  }
+  return 0;
+}
+
+static int8_t expect(Parser* p, char ch) {
+  if (accept(p, ch)) return 0;
+  char message[32];
+  snprintf(message, sizeof(message), "expected '%c'", ch);
+  return fail(p, message);
+}
+
+static StrView read_ident(Parser* p) {
+  skip_space(p);
+  const char* from = p->at;
+  if (p->at < p->end && is_ident(*p->at, 1)) {
+    while (p->at < p->end && is_ident(*p->at, 0)) p->at++;
+  }
+  return (StrView){from, p->at - from};
+}
+
+static int8_t ident_is(StrView ident, const char* name) {
+  return strlen(name) == ident.length && memcmp(ident.str, name, ident.length) == 0;
+}
+
+// reads a string literal into out, without its escapes.
+static int8_t read_string(Parser* p, StrBuilder* out) {
+  if (expect(p, '"') != 0) return -1;
+  while (p->at < p->end && *p->at != '"') {
+    char ch = *p->at++;
+    if (ch == '\\') {
+      if (p->at == p->end) break;
+      ch = *p->at++;
+      if (ch == 'n') ch = '\n';
+      else if (ch != '"' && ch != '\\') return fail(p, "unknown escape in string");
+    }
+    if (str_builder_append_n(out, &ch, 1) != 0) return -1;
+  }
+  return expect(p, '"');
+}
+
+static int8_t expr(Parser* p, ValueType* type);
+static int8_t template_text(Parser* p, const char* text, uint64_t length);
+
+static int8_t number_expr(Parser* p) {
+  ValueType type;
+  if (expr(p, &type) != 0) return -1;
+  return (type == TYPE_NUMBER) ? 0 : fail(p, "expected a number");
+}
+
+static Decl* find_decl(Compiler* c, StrView name) {
+  for (uint16_t i = 0; i < c->decl_count; i++) {
+    if (c->decls[i].name.length == name.length && memcmp(c->decls[i].name.str, name.str, name.length) == 0) return &c->decls[i];
+  }
+  return NULL;
+}
+
+// compiles the value of a name used without arguments: a builtin or a declaration.
+static int8_t name_value(Parser* p, StrView name, ValueType* type) {
+  Compiler* c = p->c;
+  *type = TYPE_NUMBER;
+  if (ident_is(name, "canvas_width")) return (emit_byte(c, OP_WIDTH) == 0) ? push(p, 1) : -1;
+  if (ident_is(name, "canvas_height")) return (emit_byte(c, OP_HEIGHT) == 0) ? push(p, 1) : -1;
+
+  Decl* d = find_decl(c, name);
+  if (d == NULL) {
+    char message[96];
+    snprintf(message, sizeof(message), "unknown name '%.*s'", (int)name.length, name.str);
+    return fail(p, message);
+  }
+  if (d->slot >= 0) {
+    if (d->slot >= c->let_count) return fail(p, "let used before it is set");
+    if (emit_byte(c, OP_LOAD) != 0 || emit_byte(c, d->slot) != 0) return -1;
+    return push(p, 1);
+  }
+
+  if (d->expanding) return fail(p, "def uses itself");
+  if (c->expansions == MAX_EXPANSIONS) return fail(p, "defs nested too deep");
+  // checked before every expansion, so that the work done never outgrows the limit by much.
+  if (c->code.length > SCRIPT_MAX_CODE) return fail(p, "defs expand to too much code");
+  Parser sub = {c, d->expr.str, d->expr.str + d->expr.length, d->line};
+  d->expanding = 1;
+  c->expansions++;
+  int8_t status = expr(&sub, type);
+  c->expansions--;
+  d->expanding = 0;
+  if (status == 0) {
+    skip_space(&sub);
+    if (sub.at != sub.end) status = fail(&sub, "unexpected text after the expression");
+  }
+  return status;
+}
+
+// theme(light, dark): the alternative that does not apply is jumped over.
+static int8_t theme_call(Parser* p, ValueType* type) {
+  Compiler* c = p->c;
+  ValueType dark_type;
+  const int depth = c->depth;
+
+  const int64_t to_dark = emit_jump(c, OP_JUMP_DARK);
+  if (to_dark == -1 || expr(p, type) != 0 || expect(p, ',') != 0) return -1;
+  const int64_t to_end = emit_jump(c, OP_JUMP);
+  if (to_end == -1) return -1;
+  patch_jump(c, to_dark);
+  c->depth = depth;
+  if (expr(p, &dark_type) != 0) return -1;
+  if (dark_type != *type) return fail(p, "theme() needs two values of the same kind");
+  patch_jump(c, to_end);
+  return expect(p, ')');
+}
+
+// counts the arguments of a call whose '(' has just been read, without compiling them.
+static uint32_t count_args(const Parser* p) {
+  uint32_t count = 1;
+  int nesting = 0;
+  for (const char* at = p->at; at < p->end; at++) {
+    if (*at == '"') {
+      for (at++; at < p->end && *at != '"'; at++) {
+        if (*at == '\\') at++;
+      }
+    } else if (*at == '(' || *at == '[') {
+      nesting++;
+    } else if (*at == ')' || *at == ']') {
+      if (nesting-- == 0) break;
+    } else if (*at == ',' && nesting == 0) {
+      count++;
+    }
+  }
+  return count;
+}
+
+// text(a, b, ...): a table of offsets to the alternatives, each of which jumps to the end.
+static int8_t text_call(Parser* p, ValueType* type) {
+  Compiler* c = p->c;
+  const uint32_t n = count_args(p);
+  if (n > UINT16_MAX) return fail(p, "too many values in text()");
+  if (emit_byte(c, OP_PICK) != 0 || emit_u16(c, n) != 0) return -1;
+  const int64_t table = c->code.length;
+  for (uint32_t i = 0; i < n; i++) {
+    if (emit_u32(c, 0) != 0) return -1;
+  }
+  const int64_t table_end = c->code.length;
+
+  int64_t* to_end = (int64_t*)malloc(n * sizeof(int64_t));
+  if (to_end == NULL) {
+    DEBUG_PRINT("err! text_call(): failed to allocate memory.\n");
+    return -1;
+  }
+  const int depth = c->depth;
+  int8_t status = 0;
+  for (uint32_t i = 0; i < n && status == 0; i++) {
+    ValueType alternative = TYPE_TEXT;
+    const int32_t offset = (int32_t)(c->code.length - table_end);
+    memcpy(c->code.str + table + i * sizeof(int32_t), &offset, sizeof(offset));
+    c->depth = depth;
+    if (i != 0 && expect(p, ',') != 0) status = -1;
+    else if (expr(p, &alternative) != 0) status = -1;
+    else if (i != 0 && alternative != *type) status = fail(p, "text() needs values of the same kind");
+    else if ((to_end[i] = emit_jump(c, OP_JUMP)) == -1) status = -1;
+    if (i == 0) *type = alternative;
+  }
+  if (status == 0) {
+    for (uint32_t i = 0; i < n; i++) patch_jump(c, to_end[i]);
+    status = expect(p, ')');
+  }
+  free(to_end);
+  return status;
+}
+
+// svg_tags[n](x): the count goes to the loop stack, the body writes x.
+static int8_t svg_tags(Parser* p, ValueType* type) {
+  Compiler* c = p->c;
+  ValueType body;
+  *type = TYPE_TEXT;
+  if (expect(p, '[') != 0 || number_expr(p) != 0 || expect(p, ']') != 0 || expect(p, '(') != 0) return -1;
+  if (c->loops == SCRIPT_MAX_LOOPS) return fail(p, "svg_tags[] nested too deep");
+
+  const int64_t skip = emit_jump(c, OP_REPEAT);
+  if (skip == -1) return -1;
+  c->depth--;
+  c->loops++;
+  const int64_t body_start = c->code.length;
+  if (expr(p, &body) != 0) return -1;
+  if (body == TYPE_NUMBER) {
+    if (emit_byte(c, OP_EMIT) != 0) return -1;
+    c->depth--;
+  }
+  const int32_t back = (int32_t)(body_start - (int64_t)(c->code.length + 1 + sizeof(int32_t)));
+  if (emit_byte(c, OP_LOOP) != 0 || emit_u32(c, back) != 0) return -1;
+  patch_jump(c, skip);
+  c->loops--;
+  return expect(p, ')');
+}
+
+static int8_t call(Parser* p, StrView name, ValueType* type) {
+  Compiler* c = p->c;
+  *type = TYPE_NUMBER;
+  if (ident_is(name, "density")) {
+    if (number_expr(p) != 0 || emit_byte(c, OP_DENSITY) != 0) return -1;
+  } else if (ident_is(name, "random_range")) {
+    if (number_expr(p) != 0 || expect(p, ',') != 0 || number_expr(p) != 0 || emit_byte(c, OP_RANDOM) != 0) return -1;
+    c->depth--;
+  } else if (ident_is(name, "round")) {
+    if (number_expr(p) != 0 || emit_byte(c, OP_ROUND) != 0) return -1;
+  } else if (ident_is(name, "theme")) {
+    return theme_call(p, type);
+  } else if (ident_is(name, "text")) {
+    return text_call(p, type);
+  } else if (ident_is(name, "svg_tag")) {
+    StrBuilder text = str_builder_new(64);
+    const uint32_t line = p->line;
+    int8_t status = read_string(p, &text);
+    if (status == 0) status = template_text(p, text.str, text.length);
+    p->line = line;
+    str_builder_free(&text);
+    *type = TYPE_TEXT;
+    if (status != 0) return -1;
+  } else {
+    char message[96];
+    snprintf(message, sizeof(message), "unknown function '%.*s'", (int)name.length, name.str);
+    return fail(p, message);
+  }
+  return expect(p, ')');
+}
+
+static int8_t primary(Parser* p, ValueType* type) {
+  skip_space(p);
+  if (p->at == p->end) return fail(p, "expected an expression");
+
+  const char ch = *p->at;
+  if (ch == '(') {
+    p->at++;
+    return (expr(p, type) == 0) ? expect(p, ')') : -1;
+  }
+  if (ch == '"') {
+    StrBuilder text = str_builder_new(64);
+    int8_t status = read_string(p, &text);
+    if (status == 0) status = emit_text(p, text.str, text.length);
+    str_builder_free(&text);
+    *type = TYPE_TEXT;
+    return status;
+  }
+  if ((ch >= '0' && ch <= '9') || ch == '.') {
+    double n = 0, scale = 1;
+    for (; p->at < p->end && *p->at >= '0' && *p->at <= '9'; p->at++) n = n * 10 + (*p->at - '0');
+    if (p->at < p->end && *p->at == '.') {
+      for (p->at++; p->at < p->end && *p->at >= '0' && *p->at <= '9'; p->at++) n += (*p->at - '0') * (scale /= 10);
+    }
+    *type = TYPE_NUMBER;
+    return emit_number(p, n);
+  }
+
+  const StrView name = read_ident(p);
+  if (name.length == 0) return fail(p, "expected an expression");
+  if (ident_is(name, "svg_tags")) return svg_tags(p, type);
+  if (accept(p, '(')) return call(p, name, type);
+  return name_value(p, name, type);
+}
+
+// every operand goes through here, so it counts the nesting of parentheses, '-' and calls.
+static int8_t unary(Parser* p, ValueType* type) {
+  Compiler* c = p->c;
+  if (c->nesting == MAX_NESTING) return fail(p, "expression nested too deep");
+  c->nesting++;
+  int8_t status;
+  if (!accept(p, '-')) {
+    status = primary(p, type);
+  } else if ((status = unary(p, type)) == 0) {
+    status = (*type == TYPE_NUMBER) ? emit_byte(c, OP_NEG) : fail(p, "'-' needs a number");
+  }
+  c->nesting--;
+  return status;
+}
+
+static int8_t binary(Parser* p, ValueType* type, uint8_t level) {
+  int8_t status = (level == 0) ? unary(p, type) : binary(p, type, level - 1);
+  if (status != 0) return -1;
+  for (;;) {
+    const char* ops = (level == 0) ? "*/" : "+-";
+    skip_space(p);
+    if (p->at == p->end || *p->at == '\0' || strchr(ops, *p->at) == NULL) return 0;
+    const uint8_t op = (*p->at == '*') ? OP_MUL : (*p->at == '/') ? OP_DIV : (*p->at == '+') ? OP_ADD : OP_SUB;
+    p->at++;
+
+    ValueType right;
+    if (*type != TYPE_NUMBER) return fail(p, "arithmetic needs numbers");
+    if (((level == 0) ? unary(p, &right) : binary(p, &right, level - 1)) != 0) return -1;
+    if (right != TYPE_NUMBER) return fail(p, "arithmetic needs numbers");
+    if (emit_byte(p->c, op) != 0) return -1;
+    p->c->depth--;
+  }
+}
+
+static int8_t expr(Parser* p, ValueType* type) {
+  return binary(p, type, 1);
+}
+
+// compiles text with $name placeholders, as found in the document and in svg_tag().
+static int8_t template_text(Parser* p, const char* text, uint64_t length) {
+  uint64_t literal_from = 0;
+  for (uint64_t i = 0; i < length; i++) {
+    if (text[i] == '\n') p->line++;
+    if (text[i] != '$' || i + 1 >= length || !is_ident(text[i + 1], 1)) continue;
+    if (emit_text(p, text + literal_from, i - literal_from) != 0) return -1;
+
+    uint64_t end = i + 1;
+    while (end < length && is_ident(text[end], 0)) end++;
+    ValueType type;
+    if (name_value(p, (StrView){text + i + 1, end - i - 1}, &type) != 0) return -1;
+    if (type == TYPE_NUMBER) {
+      if (emit_byte(p->c, OP_EMIT) != 0) return -1;
+      p->c->depth--;
+    }
+    literal_from = end;
+    i = end - 1;
+  }
+  return emit_text(p, text + literal_from, length - literal_from);
+}
+
+static int8_t add_decl(Parser* p, StrView name, StrView expr_source, int8_t is_let) {
+  Compiler* c = p->c;
+  for (size_t i = 0; i < sizeof(BUILTINS) / sizeof(BUILTINS[0]); i++) {
+    if (ident_is(name, BUILTINS[i])) return fail(p, "a builtin cannot be redeclared");
+  }
+  if (find_decl(c, name) != NULL) return fail(p, "declared twice");
+  if (is_let && c->let_count == SCRIPT_MAX_LETS) return fail(p, "too many lets");
+  if (c->decl_count == UINT16_MAX) return fail(p, "too many declarations");
+
+  if (c->decl_count == c->decl_capacity) {
+    const uint16_t grown_capacity = (c->decl_capacity == 0) ? 16 : (c->decl_capacity > UINT16_MAX / 2) ? UINT16_MAX : c->decl_capacity * 2;
+    Decl* grown = (Decl*)realloc(c->decls, grown_capacity * sizeof(Decl));
+    if (grown == NULL) {
+      DEBUG_PRINT("err! add_decl(): failed to allocate memory for the declarations.\n");
+      return -1;
+    }
+    c->decls = grown;
+    c->decl_capacity = grown_capacity;
+  }
+  // let_count counts the declared lets here; the prologue recounts them as they are compiled.
+  c->decls[c->decl_count++] = (Decl){name, expr_source, p->line, is_let ? c->let_count++ : -1, 0};
+  return 0;
+}
+
+// reads the declarations up to the --- line, and leaves p at the start of the document.
+static int8_t header(Parser* p) {
+  for (p->line = 1; p->at < p->end; p->line++) {
+    const char* line_end = memchr(p->at, '\n', p->end - p->at);
+    if (line_end == NULL) line_end = p->end;
+    const char* content_end = line_end;
+    while (content_end > p->at && (content_end[-1] == ' ' || content_end[-1] == '\t' || content_end[-1] == '\r')) content_end--;
+
+    Parser line = {p->c, p->at, content_end, p->line};
+    p->at = (line_end < p->end) ? line_end + 1 : line_end;
+    skip_space(&line);
+    if (line.at == line.end || *line.at == '#') continue;
+    if (line.end - line.at == 3 && memcmp(line.at, "---", 3) == 0) {
+      p->line++;
+      return 0;
+    }
+
+    const StrView keyword = read_ident(&line);
+    const int8_t is_let = ident_is(keyword, "let");
+    if (!is_let && !ident_is(keyword, "def")) return fail(&line, "expected let, def or ---");
+    const StrView name = read_ident(&line);
+    if (name.length == 0) return fail(&line, "expected a name");
+    if (expect(&line, '=') != 0) return -1;
+    skip_space(&line);
+    if (line.at == line.end) return fail(&line, "expected an expression");
+    if (add_decl(&line, name, (StrView){line.at, line.end - line.at}, is_let) != 0) return -1;
+  }
+  return fail(p, "missing the --- line that ends the declarations");
+}
+
+// the lets, in declaration order, then the document.
+static int8_t compile_script(Parser* p) {
+  Compiler* c = p->c;
+  if (header(p) != 0) return -1;
+
+  c->let_count = 0;
+  for (uint16_t i = 0; i < c->decl_count; i++) {
+    Decl* d = &c->decls[i];
+    if (d->slot < 0) continue;
+    Parser let = {c, d->expr.str, d->expr.str + d->expr.length, d->line};
+    ValueType type;
+    if (expr(&let, &type) != 0) return -1;
+    skip_space(&let);
+    if (let.at != let.end) return fail(&let, "unexpected text after the expression");
+    if (type != TYPE_NUMBER) return fail(&let, "a let must be a number, use def for text");
+    if (emit_byte(c, OP_STORE) != 0 || emit_byte(c, d->slot) != 0) return -1;
+    c->depth--;
+    c->let_count++;
+  }
+
+  if (template_text(p, p->at, p->end - p->at) != 0) return -1;
+  return emit_byte(c, OP_END);
+}
+
+int8_t script_compile(Script* s, StrView source, const char* name) {
+  // the script outlives any render, so it never comes from the caller's arena.
+  Arena* previous = str_use_arena(NULL);
+  Compiler c = {.name = name};
+  c.code = str_builder_new(256);
+  c.text = str_builder_new(256);
+  Parser p = {&c, source.str, source.str + source.length, 1};
+
+  *s = (Script){0};
+  int8_t status = compile_script(&p);
+  if (status == 0 && (c.code.length > UINT32_MAX || c.code.str == NULL || c.text.str == NULL)) status = -1;
+  if (status == 0) {
+    // the builders' buffers are handed over as they are.
+    *s = (Script){(uint8_t*)c.code.str, c.code.length, c.numbers, c.number_count, c.text.str, c.text.length, c.let_count};
+    c.numbers = NULL;
+  } else {
+    str_builder_free(&c.code);
+    str_builder_free(&c.text);
+  }
+  free(c.numbers);
+  free(c.decls);
+  str_use_arena(previous);
+  return status;
+}
+
+// ### interpreter ###
+
+static inline uint16_t read_u16(const uint8_t* at) {
+  uint16_t n;
+  memcpy(&n, at, sizeof(n));
+  return n;
+}
+
+static inline uint32_t read_u32(const uint8_t* at) {
+  uint32_t n;
+  memcpy(&n, at, sizeof(n));
+  return n;
+}
+
+static inline int32_t read_i32(const uint8_t* at) {
+  int32_t n;
+  memcpy(&n, at, sizeof(n));
+  return n;
+}
+
+// whole numbers are written as integers, others with up to two decimals.
+static int8_t append_number(StrBuilder* out, double n) {
+  if (n == floor(n) && fabs(n) < 1e15) return str_builder_append_int(out, (int64_t)n);
+  char digits[FMT_MAX];
+  uint8_t length = fmt_fixed(digits, n, 2);
+  if (memchr(digits, '.', length) != NULL) {
+    while (digits[length - 1] == '0') length--;
+    if (digits[length - 1] == '.') length--;
+  }
+  return str_builder_append_n(out, digits, length);
+}
+
+int8_t script_run(const Script* s, ScriptEnv* env, StrBuilder* out) {
+  // the compiler bounds every one of them.
+  double stack[SCRIPT_MAX_STACK];
+  double lets[SCRIPT_MAX_LETS];
+  uint32_t loops[SCRIPT_MAX_LOOPS];
+  double* sp = stack;
+  uint32_t* lp = loops;
+  const uint8_t* pc = s->code;
+
+  for (;;) {
+    switch (*pc++) {
+      case OP_END:
+        return 0;
+      case OP_TEXT:
+        if (str_builder_append_n(out, s->text + read_u32(pc), read_u32(pc + 4)) != 0) return -1;
+        pc += 8;
+        break;
+      case OP_NUM:
+        *sp++ = s->numbers[read_u16(pc)];
+        pc += 2;
+        break;
+      case OP_WIDTH: *sp++ = env->width; break;
+      case OP_HEIGHT: *sp++ = env->height; break;
+      case OP_DENSITY:
+        if (env->density != 0) sp[-1] = env->density;
+        break;
+      case OP_LOAD: *sp++ = lets[*pc++]; break;
+      case OP_STORE: lets[*pc++] = *--sp; break;
+      case OP_ADD: sp--; sp[-1] += sp[0]; break;
+      case OP_SUB: sp--; sp[-1] -= sp[0]; break;
+      case OP_MUL: sp--; sp[-1] *= sp[0]; break;
+      // dividing by zero gives zero rather than an infinity nobody can draw.
+      case OP_DIV: sp--; sp[-1] = (sp[0] != 0) ? sp[-1] / sp[0] : 0; break;
+      case OP_NEG: sp[-1] = -sp[-1]; break;
+      case OP_RANDOM: sp--; sp[-1] += rng_float(&env->rng) * (sp[0] - sp[-1]); break;
+      case OP_ROUND: sp[-1] = round(sp[-1]); break;
+      case OP_EMIT:
+        if (append_number(out, *--sp) != 0) return -1;
+        break;
+      case OP_JUMP:
+        pc += 4 + read_i32(pc);
+        break;
+      case OP_JUMP_DARK:
+        pc += 4 + (env->dark ? read_i32(pc) : 0);
+        break;
+      case OP_PICK: {
+        const uint8_t* table = pc + 2;
+        const uint16_t n = read_u16(pc);
+        pc = table + n * 4 + read_i32(table + rng_below(&env->rng, n) * 4);
+        break;
+      }
+      case OP_REPEAT: {
+        const double count = *--sp;
+        pc += 4;
+        // NaN and anything below one skip the body.
+        if (count >= 1) *lp++ = (count < UINT32_MAX) ? (uint32_t)count : UINT32_MAX;
+        else pc += read_i32(pc - 4);
+        break;
+      }
+      case OP_LOOP:
+        pc += 4;
+        if (--lp[-1] == 0) {
+          lp--;
+          break;
+        }
+        pc += read_i32(pc - 4);
+        if (out->length > SCRIPT_FLUSH_AT && env->flush != NULL && env->flush(env->flush_ctx) != 0) return -1;
+        break;
+      default:
+        DEBUG_PRINT("err! script_run(): invalid opcode.\n");
+        return -1;
+    }
+  }
+}
+
+// ### cache ###
+
+// Follows every path through the code, from the instruction starts marks, with the numbers
+// on the stack and the loops running at each instruction, as the compiler tracks them.
+// Every path must agree on both at each instruction and keep them within the limits
+// script_run() relies on. Returns 0 on success and -1 on failure.
+static int8_t check_depths(const Script* s, const uint8_t* starts) {
+  int16_t* depths = (int16_t*)malloc(s->code_length * sizeof(int16_t));
+  int8_t* loops = (int8_t*)malloc(s->code_length);
+  uint32_t* pending = (uint32_t*)malloc(s->code_length * sizeof(uint32_t));
+  if (depths == NULL || loops == NULL || pending == NULL) {
+    free(depths);
+    free(loops);
+    free(pending);
+    return -1;
+  }
+  for (uint32_t i = 0; i < s->code_length; i++) depths[i] = -1;
+  depths[0] = 0;
+  loops[0] = 0;
+  uint32_t pending_count = 1;
+  pending[0] = 0;
+
+  int8_t status = 0;
+  while (pending_count > 0 && status == 0) {
+    const uint32_t at = pending[--pending_count];
+    const uint8_t op = s->code[at];
+    int depth = depths[at], loop = loops[at];
+    // numbers popped then pushed, and where the code goes next: on, to a target, or both.
+    int pops = 0, pushes = 0, falls = 1, jumps = 0, loop_on = loop, loop_jump = loop;
+    uint32_t length = 1 + 4;
+    switch (op) {
+      case OP_END: length = 1; falls = 0; break;
+      case OP_TEXT: length = 9; break;
+      case OP_NUM: length = 3; pushes = 1; break;
+      case OP_WIDTH: case OP_HEIGHT: length = 1; pushes = 1; break;
+      case OP_LOAD: length = 2; pushes = 1; break;
+      case OP_STORE: length = 2; pops = 1; break;
+      case OP_DENSITY: case OP_NEG: case OP_ROUND: length = 1; pops = pushes = 1; break;
+      case OP_EMIT: length = 1; pops = 1; break;
+      case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_RANDOM: length = 1; pops = 2; pushes = 1; break;
+      case OP_JUMP: falls = 0; jumps = 1; break;
+      case OP_JUMP_DARK: jumps = 1; break;
+      case OP_PICK: length = 3 + 4 * (uint32_t)read_u16(s->code + at + 1); falls = 0; break;
+      case OP_REPEAT: pops = 1; jumps = 1; loop_on = loop + 1; break;
+      case OP_LOOP: jumps = 1; loop_on = loop - 1; break;
+    }
+    if (depth < pops || depth - pops + pushes > SCRIPT_MAX_STACK || loop_on < 0 || loop_on > SCRIPT_MAX_LOOPS ||
+        (op == OP_PICK && read_u16(s->code + at + 1) == 0)) {
+      status = -1;
+      break;
+    }
+    depth += pushes - pops;
+
+    // at most 1 + UINT16_MAX successors, PICK's targets being read from its table.
+    const uint32_t end = at + length;
+    const uint32_t count = (op == OP_PICK) ? read_u16(s->code + at + 1) : (uint32_t)(falls + jumps);
+    for (uint32_t i = 0; i < count && status == 0; i++) {
+      int64_t next;
+      int next_loop = loop_on;
+      if (op == OP_PICK) {
+        next = end + (int64_t)read_i32(s->code + at + 3 + i * 4);
+      } else if (falls && i == 0) {
+        next = end;
+      } else {
+        next = end + (int64_t)read_i32(s->code + at + 1);
+        next_loop = loop_jump;
+      }
+      if (next >= s->code_length || !starts[next]) {
+        status = -1;
+      } else if (depths[next] == -1) {
+        depths[next] = (int16_t)depth;
+        loops[next] = (int8_t)next_loop;
+        pending[pending_count++] = (uint32_t)next;
+      } else if (depths[next] != depth || loops[next] != next_loop) {
+        status = -1;
+      }
+    }
+  }
+  free(depths);
+  free(loops);
+  free(pending);
+  return status;
+}
+
+// checks that code loaded from the cache only reads and jumps within the script and keeps
+// its stacks within their limits, as the compiler guarantees, so that a damaged or crafted
+// file is recompiled rather than run.
+static int8_t verify(const Script* s) {
+  uint8_t* starts = (uint8_t*)calloc(s->code_length + 1, 1);
+  if (starts == NULL) return -1;
+  int8_t status = 0;
+  uint32_t at = 0;
+  while (at < s->code_length && status == 0) {
+    starts[at] = 1;
+    const uint8_t op = s->code[at++];
+    uint64_t operands = 0;
+    switch (op) {
+      case OP_TEXT: operands = 8; break;
+      case OP_NUM: operands = 2; break;
+      case OP_LOAD: case OP_STORE: operands = 1; break;
+      case OP_JUMP: case OP_JUMP_DARK: case OP_REPEAT: case OP_LOOP: operands = 4; break;
+      case OP_PICK: operands = (at + 2 <= s->code_length) ? 2 + 4 * (uint64_t)read_u16(s->code + at) : 2; break;
+      default: if (op >= OP_COUNT) status = -1;
+    }
+    if (status != 0 || at + operands > s->code_length) {
+      status = -1;
+      break;
+    }
+    if (op == OP_TEXT && (uint64_t)read_u32(s->code + at) + read_u32(s->code + at + 4) > s->text_length) status = -1;
+    if (op == OP_NUM && read_u16(s->code + at) >= s->number_count) status = -1;
+    if ((op == OP_LOAD || op == OP_STORE) && s->code[at] >= s->let_count) status = -1;
+    at += operands;
+  }
+  if (status == 0 && (s->code_length == 0 || s->code[s->code_length - 1] != OP_END || s->let_count > SCRIPT_MAX_LETS)) status = -1;
+
+  // second pass: every jump lands on an instruction.
+  for (at = 0; at < s->code_length && status == 0; at++) {
+    if (!starts[at]) continue;
+    const uint8_t op = s->code[at];
+    const int64_t end = at + 1 + ((op == OP_PICK) ? 2 + 4 * (int64_t)read_u16(s->code + at + 1) : 4);
+    if (op == OP_JUMP || op == OP_JUMP_DARK || op == OP_REPEAT || op == OP_LOOP) {
+      const int64_t target = end + read_i32(s->code + at + 1);
+      if (target < 0 || target >= s->code_length || !starts[target]) status = -1;
+    } else if (op == OP_PICK) {
+      for (uint16_t i = 0; i < read_u16(s->code + at + 1) && status == 0; i++) {
+        const int64_t target = end + read_i32(s->code + at + 3 + i * 4);
+        if (target < 0 || target >= s->code_length || !starts[target]) status = -1;
+      }
+    }
+  }
+  if (status == 0) status = check_depths(s, starts);
+  free(starts);
+  return status;
+}
+
+static int8_t load_cached(Script* s, const char* path, uint64_t key) {
+  String file;
+  CacheHeader h;
+  // a missing entry is the usual case, read_file_content() fails on it without a message.
+  if (read_file_content(path, &file) != 0) return -1;
+
+  int8_t status = -1;
+  *s = (Script){0};
+  if (file.length >= sizeof(h)) {
+    memcpy(&h, file.str, sizeof(h));
+    const uint64_t payload = file.length - sizeof(h);
+    if (memcmp(h.magic, CACHE_MAGIC, 4) == 0 && h.version == SCRIPT_VERSION && h.key == key &&
+        payload == (uint64_t)h.code_length + h.number_count * sizeof(double) + h.text_length &&
+        h.checksum == str_hash((StrView){file.str + sizeof(h), payload})) {
+      s->code = (uint8_t*)malloc(h.code_length + 1);
+      s->numbers = (double*)malloc(h.number_count * sizeof(double) + 1);
+      s->text = (char*)malloc(h.text_length + 1);
+      if (s->code != NULL && s->numbers != NULL && s->text != NULL) {
+        const char* at = file.str + sizeof(h);
+        memcpy(s->code, at, h.code_length);
+        memcpy(s->numbers, at + h.code_length, h.number_count * sizeof(double));
+        memcpy(s->text, at + h.code_length + h.number_count * sizeof(double), h.text_length);
+        s->code_length = h.code_length;
+        s->number_count = h.number_count;
+        s->text_length = h.text_length;
+        s->let_count = h.let_count;
+        status = verify(s);
+      }
+    }
+  }
+  if (status != 0) {
+    DEBUG_PRINT("err! script_load(): ignoring the invalid cache entry %s.\n", path);
+    script_free(s);
+  }
+  free(file.str);
+  return status;
+}
+
+static int8_t store_cached(const Script* s, char* path, uint64_t key) {
+  CacheHeader h = {.version = SCRIPT_VERSION, .key = key};
+  memcpy(h.magic, CACHE_MAGIC, 4);
+  h.code_length = s->code_length;
+  h.text_length = s->text_length;
+  h.number_count = s->number_count;
+  h.let_count = s->let_count;
+
+  Arena* previous = str_use_arena(NULL);
+  StrBuilder out = str_builder_new(sizeof(h) + s->code_length + s->number_count * sizeof(double) + s->text_length);
+  int8_t status = str_builder_append_n(&out, (const char*)&h, sizeof(h));
+  status |= str_builder_append_n(&out, (const char*)s->code, s->code_length);
+  status |= str_builder_append_n(&out, (const char*)s->numbers, s->number_count * sizeof(double));
+  status |= str_builder_append_n(&out, s->text, s->text_length);
+  if (status == 0) {
+    h.checksum = str_hash((StrView){out.str + sizeof(h), out.length - sizeof(h)});
+    memcpy(out.str, &h, sizeof(h));
+    status = (make_parents(path) == 0) ? write_to_file_atomic(path, str_builder_view(&out)) : -1;
+  }
+  str_builder_free(&out);
+  str_use_arena(previous);
+  return (status == 0) ? 0 : -1;
+}
+
+int8_t script_load(Script* s, const char* filename, const char* cache_dir) {
+  String source;
+  if (map_file(filename, &source) != 0) return -1;
+
+  // the version is part of the key, so a new compiler never reads the entries of an old one.
+  const uint64_t key = str_hash(str_view(source)) ^ ((uint64_t)SCRIPT_VERSION * 0x9e3779b97f4a7c15);
+  char path[PATH_MAX];
+  const int8_t cached = cache_dir != NULL &&
+    snprintf(path, sizeof(path), "%s/%016llx.wkc", cache_dir, (unsigned long long)key) < (int)sizeof(path);
+
+  int8_t status = 0;
+  if (!cached || load_cached(s, path, key) != 0) {
+    status = script_compile(s, str_view(source), filename);
+    // a cache that cannot be written only costs the next launch a compile.
+    if (status == 0 && cached && store_cached(s, path, key) != 0) {
+      DEBUG_PRINT("err! script_load(): failed to cache %s in %s.\n", filename, path);
+    }
+  }
+  unmap_file(&source);
+  return status;
+}
+
+const char* script_cache_dir(void) {
+  static char dir[PATH_MAX];
+  const char* env = getenv("WOOTKAS_CACHE");
+  if (env != NULL && env[0] != '\0') return env;
+
+  int n = -1;
+  if ((env = getenv("XDG_CACHE_HOME")) != NULL && env[0] != '\0') n = snprintf(dir, sizeof(dir), "%s/wootkas", env);
+  else if ((env = getenv("HOME")) != NULL && env[0] != '\0') n = snprintf(dir, sizeof(dir), "%s/.cache/wootkas", env);
+  return (n > 0 && n < (int)sizeof(dir)) ? dir : NULL;
+}
+
+void script_free(Script* s) {
+  free(s->code);
+  free(s->numbers);
+  free(s->text);
+  *s = (Script){0};
+}
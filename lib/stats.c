@@ -0,0 +1,58 @@
+#include <stdint.h>
+#include <time.h>
+#include "../include/stats.h"
+#include "../include/strings.h"
+#include "../include/fmt.h"
+
+int8_t stats_enabled = 0;
+StatTimerTotal stats_timers[STAT_TIMER_COUNT];
+uint64_t stats_counters[STAT_COUNTER_COUNT];
+
+static const char* const TIMER_NAMES[STAT_TIMER_COUNT] = {
+  [STAT_RENDER] = "render",
+  [STAT_LOAD] = "load",
+  [STAT_SPLICE] = "splice",
+  [STAT_GEOMETRY] = "geometry",
+  [STAT_FORMAT] = "format",
+  [STAT_WRITE] = "write",
+};
+
+static const char* const COUNTER_NAMES[STAT_COUNTER_COUNT] = {
+  [STAT_STR_ALLOCS] = "str_allocs",
+  [STAT_STR_HEAP_ALLOCS] = "str_heap_allocs",
+  [STAT_STR_BYTES] = "str_bytes",
+  [STAT_FILE_READS] = "file_reads",
+  [STAT_READ_BYTES] = "read_bytes",
+  [STAT_FILE_WRITES] = "file_writes",
+  [STAT_WRITE_BYTES] = "write_bytes",
+};
+
+void stats_enable(void) {
+  stats_enabled = 1;
+}
+
+uint64_t stats_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+int8_t stats_append_json(StrBuilder* out) {
+  int8_t status = str_builder_append(out, STR_LIT("{\"timers\":{"));
+  for (int t = 0; t < STAT_TIMER_COUNT; t++) {
+    const uint64_t calls = __atomic_load_n(&stats_timers[t].calls, __ATOMIC_RELAXED);
+    const uint64_t ns = __atomic_load_n(&stats_timers[t].ns, __ATOMIC_RELAXED);
+    status |= str_builder_append_fmt(out, "%s\"%s\":{\"calls\":", (t == 0) ? "" : ",", TIMER_NAMES[t]);
+    status |= str_builder_append_int(out, (int64_t)calls);
+    status |= str_builder_append(out, STR_LIT(",\"ns\":"));
+    status |= str_builder_append_int(out, (int64_t)ns);
+    status |= str_builder_append(out, STR_LIT("}"));
+  }
+  status |= str_builder_append(out, STR_LIT("},\"counters\":{"));
+  for (int c = 0; c < STAT_COUNTER_COUNT; c++) {
+    status |= str_builder_append_fmt(out, "%s\"%s\":", (c == 0) ? "" : ",", COUNTER_NAMES[c]);
+    status |= str_builder_append_int(out, (int64_t)__atomic_load_n(&stats_counters[c], __ATOMIC_RELAXED));
+  }
+  status |= str_builder_append(out, STR_LIT("}}\n"));
+  return (status == 0) ? 0 : -1;
+}
@@ -3,15 +3,55 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include "../include/strings.h"
+#include "../include/arena.h"
+#include "../include/stats.h"
 #include "../include/utils.h"
 
-typedef struct String {
-  char* str;
-  uint64_t length;
-} String;
+// arena that String memory comes from on this thread; NULL means the heap.
+static _Thread_local Arena* str_arena = NULL;
+
+Arena* str_use_arena(Arena* arena) {
+  Arena* previous = str_arena;
+  str_arena = arena;
+  return previous;
+}
+
+static void count_alloc(uint64_t size) {
+  stats_add(STAT_STR_ALLOCS, 1);
+  stats_add(STAT_STR_HEAP_ALLOCS, str_arena == NULL);
+  stats_add(STAT_STR_BYTES, size);
+}
+
+static void* str_alloc(uint64_t size) {
+  if (stats_enabled) count_alloc(size);
+  return (str_arena != NULL) ? arena_alloc(str_arena, size) : malloc(size);
+}
+
+static void* str_realloc(void* ptr, uint64_t old_size, uint64_t new_size) {
+  if (stats_enabled) count_alloc(new_size);
+  return (str_arena != NULL) ? arena_realloc(str_arena, ptr, old_size, new_size) : realloc(ptr, new_size);
+}
+
+// heap memory is freed, arena memory waits for the arena to be reset.
+static void str_dealloc(void* ptr) {
+  if (str_arena == NULL || !arena_owns(str_arena, ptr)) free(ptr);
+}
 
 String str_from(const char* str) {
-  return (str != NULL) ? (String){strdup(str), strlen(str)} : (String){NULL, 0};
+  return (str != NULL) ? str_from_view(str_view_cstr(str)) : (String){NULL, 0};
+}
+
+String str_from_view(StrView view) {
+  String s = {NULL, view.length};
+  s.str = (char*)str_alloc(s.length + 1);
+  if (s.str == NULL) {
+    DEBUG_PRINT("err! str_from_view(): failed to allocate memory for s.str.\n");
+    return (String){NULL, 0};
+  }
+  memcpy(s.str, view.str, s.length);
+  s.str[s.length] = '\0';
+  return s;
 }
 
 char* str_str(const String s) {
@@ -24,115 +64,252 @@ uint64_t str_len(const String s) {
 
 void str_free(String* s) {
   memset(s->str, 0, s->length);
-  free(s->str);
+  str_dealloc(s->str);
   s->length = 0;
 }
 
-char* str_slice(const String str, uint64_t start, uint64_t end) {
-  String slice = str_from(NULL);
+void str_release(String* s) {
+  str_dealloc(s->str);
+  s->str = NULL;
+  s->length = 0;
+}
+
+String str_slice(StrView str, uint64_t start, uint64_t end) {
+  StrView slice = str_slice_view(str, start, end);
+  return (slice.str != NULL) ? str_from_view(slice) : str_from(NULL);
+}
 
-  if (start == end || end >= str.length || start >= str.length || start < 0 || end < 0) return NULL;
+StrView str_slice_view(StrView str, uint64_t start, uint64_t end) {
+  if (start >= end || end > str.length) return (StrView){NULL, 0};
+  return (StrView){str.str + start, end - start};
+}
 
-  slice.str = (char*)malloc(end - start + 1);
-  if (slice.str == NULL) {
-    DEBUG_PRINT("err! str_slice(): failed to allocate memory for slice.str.\n");
-    return NULL;
+// keys at least this long are searched with Horspool's skip table,
+// shorter ones are cheaper to find with memchr() on their first byte.
+#define HORSPOOL_MIN_KEY 16
+
+int64_t str_find(StrView str, uint64_t look_from, StrView key) {
+  if (look_from > str.length || key.length > str.length - look_from) return -1;
+  if (key.length == 0) return look_from;
+
+  if (key.length < HORSPOOL_MIN_KEY) {
+    // memchr() is vectorized by libc, so most of the haystack is skipped in wide strides.
+    const char* last = str.str + str.length - key.length;
+    for (const char* p = str.str + look_from; p <= last; p++) {
+      p = memchr(p, key.str[0], last - p + 1);
+      if (p == NULL) return -1;
+      if (memcmp(p + 1, key.str + 1, key.length - 1) == 0) return p - str.str;
+    }
+    return -1;
   }
 
-  for (int i = start; i < end; i++) {
-    slice.str[slice.length++] = str.str[i];
+  uint64_t shift[256];
+  for (int i = 0; i < 256; i++) shift[i] = key.length;
+  for (uint64_t i = 0; i < key.length - 1; i++) shift[(uint8_t)key.str[i]] = key.length - 1 - i;
+
+  const char last = key.str[key.length - 1];
+  for (uint64_t i = look_from; i <= str.length - key.length; i += shift[(uint8_t)str.str[i + key.length - 1]]) {
+    if (str.str[i + key.length - 1] == last && memcmp(str.str + i, key.str, key.length - 1) == 0) return i;
   }
-  slice.str[slice.length] = '\0';
-  return slice.str;
+  return -1;
 }
 
 // Returns number of occurances of key in str if key is in str; 0 otherwise.
-uint64_t str_key_frequency(const String str, const String key) {
-  size_t count = 0, k, j;
-  for (size_t i = 0; i < str_len(str); i++) {
-    for (j = 0, k = i; j < str_len(key) && k < str_len(str) && str.str[k] == key.str[j]; k++, j++);
-    if (j == str_len(key)) count++;
-  }
+uint64_t str_key_frequency(StrView str, StrView key) {
+  uint64_t count = 0;
+  if (key.length == 0) return 0;
+  for (int64_t at = str_find(str, 0, key); at != -1; at = str_find(str, at + 1, key)) count++;
   return count;
 }
 
-int8_t str_replace_all(String* str, const String key, const String value) {
-  String buf = str_from(NULL);
-  size_t j, k, key_count = str_key_frequency(*str, key);
+int8_t str_replace_all(String* str, StrView key, StrView value) {
+  int64_t at = (key.length != 0) ? str_find(str_view(*str), 0, key) : -1;
+  if (at == -1) {
+    DEBUG_PRINT("str_replace_all(): key not found.\n");
+    return 2;
+  }
 
-  if (key_count != 0) {
-    buf.str = (char*)malloc(str->length - (key.length - value.length) * key_count + 1);
-    if (buf.str == NULL) {
+  // a single pass: the builder grows as matches are found instead of counting them first.
+  StrBuilder buf = str_builder_new(str->length);
+  uint64_t from = 0;
+  for (; at != -1; at = str_find(str_view(*str), from, key)) {
+    if (str_builder_append_n(&buf, str->str + from, at - from) != 0 || str_builder_append(&buf, value) != 0) {
       DEBUG_PRINT("err! str_replace_all(): failed to allocate memory for buf.str.\n");
+      str_builder_free(&buf);
       return -1;
     }
-
-    for (size_t i = 0; i < str->length; i++) {
-      for (j = 0, k = i; j < key.length && k < str->length && str->str[k] == key.str[j]; k++, j++);
-      if (j == key.length) {
-        for (j = 0; j < value.length; j++) {
-          buf.str[buf.length++] = value.str[j];
-        }
-        i += key.length - 1;
-      } else {
-       buf.str[buf.length++] = str->str[i]; 
-      }
-    }
-    buf.str[buf.length] = '\0';
-  } else {
-    DEBUG_PRINT("str_replace_all(): key not found.\n");
-    return 2;
+    from = at + key.length;
+  }
+  if (str_builder_append_n(&buf, str->str + from, str->length - from) != 0) {
+    DEBUG_PRINT("err! str_replace_all(): failed to allocate memory for buf.str.\n");
+    str_builder_free(&buf);
+    return -1;
   }
 
   str_free(str);
-  *str = buf;
+  *str = str_builder_build(&buf);
 
   return 0;
 }
 
-int64_t str_replace_next(String* str, uint64_t look_from, const String key, const String value) {
-  int64_t start_pos = -1;
-  size_t k, j;
-  for (size_t i = look_from; i < str->length; i++) {
-    for (j = 0, k = i; j < key.length && k < str->length && str->str[k] == key.str[j]; k++, j++);
-    if (j == key.length) {
-      start_pos = i;
-      break;
+int64_t str_replace_next(String* str, uint64_t look_from, StrView key, StrView value) {
+  int64_t start_pos = str_find(str_view(*str), look_from, key);
+  if (start_pos == -1) return -1;
+
+  uint64_t tail = start_pos + key.length;
+  if (value.length > key.length) {
+    // resize in place; realloc() can often extend the block without copying it.
+    char* grown = (char*)str_realloc(str->str, str->length + 1, str->length - key.length + value.length + 1);
+    if (grown == NULL) {
+      DEBUG_PRINT("err! str_replace_next(): failed to allocate memory for str->str.\n");
+      return -1;
     }
+    str->str = grown;
+  }
+  if (value.length != key.length) {
+    memmove(str->str + start_pos + value.length, str->str + tail, str->length - tail);
+    str->length = str->length - key.length + value.length;
+    str->str[str->length] = '\0';
   }
+  memcpy(str->str + start_pos, value.str, value.length);
 
-  String buf = {NULL, 0};
-  if (start_pos != -1) {
-  size_t i, j;
-    if (key.length == value.length) {
-      for (i = start_pos, j = 0; j < value.length; i++, j++) {
-        str->str[i] = value.str[j];
-      }
-    } else {
-      buf.str = (char*)malloc(str->length - key.length + value.length + 1);
-      if (buf.str == NULL) {
-        DEBUG_PRINT("err! str_replace_next(): failed to allocate memory for buf.str.\n");
-        return -1;
-      }
+  return start_pos + value.length;
+}
 
-      for (i = 0; i < start_pos; i++) {
-        buf.str[buf.length++] = str->str[i];
-      }
-      for (i = 0; i < value.length; i++) {
-        buf.str[buf.length++] = value.str[i];
+int8_t str_matcher_build(StrMatcher* m, const StrView keys[], uint16_t key_count) {
+  uint32_t capacity = 1;
+  *m = (StrMatcher){0};
+
+  for (uint16_t k = 0; k < key_count; k++) {
+    capacity += keys[k].length;
+    for (uint64_t i = 0; i < keys[k].length; i++) {
+      uint8_t byte = keys[k].str[i];
+      if (m->classes[byte] == 0) m->classes[byte] = ++m->class_count;
+    }
+  }
+  m->class_count++; // class 0 stands for every byte that is in no key.
+
+  m->next = (int32_t*)calloc((uint64_t)capacity * m->class_count, sizeof(int32_t));
+  m->match = (int32_t*)malloc(capacity * sizeof(int32_t));
+  m->depth = (uint32_t*)calloc(capacity, sizeof(uint32_t));
+  m->key_lengths = (uint64_t*)malloc((key_count + 1) * sizeof(uint64_t));
+  int32_t* fail = (int32_t*)calloc(capacity, sizeof(int32_t));
+  int32_t* queue = (int32_t*)malloc(capacity * sizeof(int32_t));
+  if (m->next == NULL || m->match == NULL || m->depth == NULL || m->key_lengths == NULL || fail == NULL || queue == NULL) {
+    DEBUG_PRINT("err! str_matcher_build(): failed to allocate memory for the automaton.\n");
+    free(fail);
+    free(queue);
+    str_matcher_free(m);
+    return -1;
+  }
+  m->key_count = key_count;
+  m->state_count = 1;
+  m->match[0] = -1;
+
+  // build the trie; a transition to state 0 means there is no edge yet.
+  for (uint16_t k = 0; k < key_count; k++) {
+    int32_t state = 0;
+    m->key_lengths[k] = keys[k].length;
+    if (keys[k].length == 0) continue;
+    for (uint64_t i = 0; i < keys[k].length; i++) {
+      int32_t* edge = &m->next[state * m->class_count + m->classes[(uint8_t)keys[k].str[i]]];
+      if (*edge == 0) {
+        *edge = m->state_count;
+        m->match[m->state_count] = -1;
+        m->depth[m->state_count] = i + 1;
+        m->state_count++;
       }
-      for (i = buf.length - value.length + key.length; i < str->length; i++) {
-        buf.str[buf.length++] = str->str[i];
+      state = *edge;
+    }
+    // with duplicate keys the first one wins.
+    if (m->match[state] == -1) m->match[state] = k;
+  }
+
+  // breadth first, turn the trie into a full automaton through the failure links.
+  uint32_t head = 0, tail = 0;
+  for (uint16_t c = 0; c < m->class_count; c++) {
+    if (m->next[c] != 0) queue[tail++] = m->next[c];
+  }
+  while (head < tail) {
+    int32_t state = queue[head++];
+    // the longest key ending here is either this state's own or its failure state's.
+    if (m->match[state] == -1) m->match[state] = m->match[fail[state]];
+    for (uint16_t c = 0; c < m->class_count; c++) {
+      int32_t* edge = &m->next[state * m->class_count + c];
+      int32_t fallback = m->next[fail[state] * m->class_count + c];
+      if (*edge != 0) {
+        fail[*edge] = fallback;
+        queue[tail++] = *edge;
+      } else {
+        *edge = fallback;
       }
+    }
+  }
+
+  free(fail);
+  free(queue);
+  return 0;
+}
 
-      buf.str[buf.length] = '\0';
-      str_free(str);
-      *str = buf;
+int64_t str_matcher_find(const StrMatcher* m, StrView str, uint64_t look_from, uint16_t* key) {
+  int32_t state = 0;
+  int64_t best_start = -1;
+  int32_t best_key = -1;
+
+  for (uint64_t i = look_from; i < str.length; i++) {
+    state = m->next[state * m->class_count + m->classes[(uint8_t)str.str[i]]];
+    // stop once no partial match can start at or before the best match so far.
+    if (best_start != -1 && i + 1 - m->depth[state] > (uint64_t)best_start) break;
+
+    int32_t k = m->match[state];
+    if (k == -1) continue;
+    int64_t start = i + 1 - m->key_lengths[k];
+    if (best_start == -1 || start < best_start || (start == best_start && m->key_lengths[k] > m->key_lengths[best_key])) {
+      best_start = start;
+      best_key = k;
     }
-    return start_pos + value.length;
-      
   }
-  return -1;
+
+  if (best_start != -1 && key != NULL) *key = best_key;
+  return best_start;
+}
+
+void str_matcher_free(StrMatcher* m) {
+  free(m->next);
+  free(m->match);
+  free(m->depth);
+  free(m->key_lengths);
+  *m = (StrMatcher){0};
+}
+
+int8_t str_replace_multi(String* str, const StrMatcher* m, const StrView values[]) {
+  uint16_t key;
+  int64_t at = str_matcher_find(m, str_view(*str), 0, &key);
+  if (at == -1) {
+    DEBUG_PRINT("str_replace_multi(): no key found.\n");
+    return 2;
+  }
+
+  StrBuilder buf = str_builder_new(str->length);
+  uint64_t from = 0;
+  for (; at != -1; at = str_matcher_find(m, str_view(*str), from, &key)) {
+    if (str_builder_append_n(&buf, str->str + from, at - from) != 0 || str_builder_append(&buf, values[key]) != 0) {
+      DEBUG_PRINT("err! str_replace_multi(): failed to allocate memory for buf.str.\n");
+      str_builder_free(&buf);
+      return -1;
+    }
+    from = at + m->key_lengths[key];
+  }
+  if (str_builder_append_n(&buf, str->str + from, str->length - from) != 0) {
+    DEBUG_PRINT("err! str_replace_multi(): failed to allocate memory for buf.str.\n");
+    str_builder_free(&buf);
+    return -1;
+  }
+
+  str_free(str);
+  *str = str_builder_build(&buf);
+
+  return 0;
 }
 
 // Returns a composed string, ie; works like sprintf(),
@@ -154,7 +331,7 @@ String str_compose(const char *format, ...) {
       return result;
     }
 
-    result.str = (char *)malloc(result.length + 1);
+    result.str = (char *)str_alloc(result.length + 1);
     if (!result.str) {
       DEBUG_PRINT("Error: str_compose(): Memory allocation failed.\n");
       return result;
@@ -166,3 +343,161 @@ String str_compose(const char *format, ...) {
 
     return result;
 }
+
+StrBuilder str_builder_new(uint64_t capacity) {
+  StrBuilder sb = {NULL, 0, 0};
+  str_builder_reserve(&sb, capacity);
+  return sb;
+}
+
+int8_t str_builder_reserve(StrBuilder* sb, uint64_t capacity) {
+  if (sb->str != NULL && capacity <= sb->capacity) return 0;
+
+  // one extra byte for the null terminator.
+  char* grown = (char*)str_realloc(sb->str, (sb->str != NULL) ? sb->capacity + 1 : 0, capacity + 1);
+  if (grown == NULL) {
+    DEBUG_PRINT("err! str_builder_reserve(): failed to allocate memory for sb->str.\n");
+    return -1;
+  }
+  grown[sb->length] = '\0';
+  sb->str = grown;
+  sb->capacity = capacity;
+  return 0;
+}
+
+int8_t str_builder_grow(StrBuilder* sb, uint64_t additional) {
+  uint64_t needed = sb->length + additional;
+  if (sb->str != NULL && needed <= sb->capacity) return 0;
+
+  uint64_t capacity = (sb->capacity < 64) ? 64 : sb->capacity;
+  while (capacity < needed) capacity *= 2;
+  return str_builder_reserve(sb, capacity);
+}
+
+int8_t str_builder_append_n(StrBuilder* sb, const char* s, uint64_t n) {
+  if (str_builder_grow(sb, n) != 0) return -1;
+  memcpy(sb->str + sb->length, s, n);
+  sb->length += n;
+  sb->str[sb->length] = '\0';
+  return 0;
+}
+
+int8_t str_builder_append(StrBuilder* sb, StrView s) {
+  return str_builder_append_n(sb, s.str, s.length);
+}
+
+int8_t str_builder_append_cstr(StrBuilder* sb, const char* s) {
+  return str_builder_append_n(sb, s, strlen(s));
+}
+
+int8_t str_builder_append_fmt(StrBuilder* sb, const char* format, ...) {
+  va_list args;
+
+  if (str_builder_grow(sb, 0) != 0) return -1;
+
+  // Try to format straight into the spare room; only measure-and-retry when it does not fit.
+  uint64_t room = sb->capacity - sb->length + 1;
+  va_start(args, format);
+  int written = vsnprintf(sb->str + sb->length, room, format, args);
+  va_end(args);
+
+  if (written < 0) {
+    DEBUG_PRINT("Error: str_builder_append_fmt(): Error during formatting.\n");
+    sb->str[sb->length] = '\0';
+    return -1;
+  }
+
+  if ((uint64_t)written >= room) {
+    if (str_builder_grow(sb, written) != 0) {
+      sb->str[sb->length] = '\0';
+      return -1;
+    }
+    va_start(args, format);
+    vsnprintf(sb->str + sb->length, written + 1, format, args);
+    va_end(args);
+  }
+
+  sb->length += written;
+  return 0;
+}
+
+String str_builder_build(StrBuilder* sb) {
+  String built = {sb->str, sb->length};
+  *sb = (StrBuilder){NULL, 0, 0};
+  return built;
+}
+
+void str_builder_free(StrBuilder* sb) {
+  str_dealloc(sb->str);
+  *sb = (StrBuilder){NULL, 0, 0};
+}
+
+StrChain str_chain_new(uint64_t capacity) {
+  return (StrChain){.text = str_builder_new(capacity)};
+}
+
+static int8_t push_part(StrChain* chain, StrChainPart part) {
+  if (chain->count == chain->capacity) {
+    const uint32_t grown_capacity = (chain->capacity == 0) ? 16 : chain->capacity * 2;
+    StrChainPart* grown = (StrChainPart*)str_realloc(chain->parts, chain->capacity * sizeof(StrChainPart), grown_capacity * sizeof(StrChainPart));
+    if (grown == NULL) {
+      DEBUG_PRINT("err! str_chain_append_ref(): failed to allocate memory for chain->parts.\n");
+      return -1;
+    }
+    chain->parts = grown;
+    chain->capacity = grown_capacity;
+  }
+  chain->parts[chain->count++] = part;
+  chain->length += part.length;
+  return 0;
+}
+
+// text is referred to by offset, it can still move while the chain is being built.
+static int8_t flush_text(StrChain* chain) {
+  const uint64_t pending = chain->text.length - chain->flushed;
+  if (pending == 0) return 0;
+  if (push_part(chain, (StrChainPart){NULL, chain->flushed, pending}) != 0) return -1;
+  chain->flushed = chain->text.length;
+  return 0;
+}
+
+int8_t str_chain_append_ref(StrChain* chain, StrView view) {
+  if (view.length == 0) return 0;
+  if (flush_text(chain) != 0) return -1;
+  return push_part(chain, (StrChainPart){view.str, 0, view.length});
+}
+
+int8_t str_chain_end(StrChain* chain) {
+  return flush_text(chain);
+}
+
+void str_chain_clear(StrChain* chain) {
+  chain->text.length = 0;
+  if (chain->text.str != NULL) chain->text.str[0] = '\0';
+  chain->count = 0;
+  chain->flushed = 0;
+  chain->length = 0;
+}
+
+int8_t str_chain_join(const StrChain* chain, StrBuilder* out) {
+  if (str_builder_reserve(out, out->length + chain->length) != 0) return -1;
+  for (uint32_t i = 0; i < chain->count; i++) {
+    if (str_builder_append(out, str_chain_part(chain, i)) != 0) return -1;
+  }
+  return 0;
+}
+
+uint64_t str_hash(StrView str) {
+  uint64_t hash = 0xcbf29ce484222325;
+  for (uint64_t i = 0; i < str.length; i++) {
+    hash ^= (unsigned char)str.str[i];
+    hash *= 0x100000001b3;
+  }
+  return hash;
+}
+
+void str_chain_free(StrChain* chain) {
+  str_builder_free(&chain->text);
+  str_dealloc(chain->parts);
+  *chain = (StrChain){0};
+}
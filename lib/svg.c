@@ -0,0 +1,161 @@
+#include <stdint.h>
+#include "../include/svg.h"
+#include "../include/fmt.h"
+
+// longest output of one emitter call besides its fixed text.
+#define SVG_POINT_MAX (2 * FMT_MAX + 2)
+
+// Writes "x,y" without going through the builder's bounds checks for each part.
+static void put_point(StrBuilder* out, float x, float y, uint8_t precision) {
+  out->length += fmt_fixed(out->str + out->length, x, precision);
+  out->str[out->length++] = ',';
+  out->length += fmt_fixed(out->str + out->length, y, precision);
+}
+
+static void put_lit(StrBuilder* out, StrView lit) {
+  memcpy(out->str + out->length, lit.str, lit.length);
+  out->length += lit.length;
+}
+
+int8_t svg_hsla(StrBuilder* out, Hsla color, uint8_t precision) {
+  if (str_builder_grow(out, 4 * FMT_MAX + 16) != 0) return -1;
+  put_lit(out, STR_LIT("hsla("));
+  out->length += fmt_fixed(out->str + out->length, color.h, precision);
+  out->str[out->length++] = ',';
+  out->length += fmt_fixed(out->str + out->length, color.s, 0);
+  put_lit(out, STR_LIT("%,"));
+  out->length += fmt_fixed(out->str + out->length, color.l, 0);
+  put_lit(out, STR_LIT("%,"));
+  out->length += fmt_fixed(out->str + out->length, color.a, precision);
+  out->str[out->length++] = ')';
+  out->str[out->length] = '\0';
+  return 0;
+}
+
+// Writes the #rrggbb colour the hsla() of svg_hsla() is drawn with, taken from the
+// palette when there is one; the alpha is left out.
+static int8_t put_hex(SvgPath* p, Hsla fill) {
+  const Rgba color = (p->palette != NULL) ? palette_rgba(p->palette, fill, p->color_precision) :
+    color_from_hsla(fill, p->color_precision);
+  return color_hex(p->out, color);
+}
+
+// Writes a number of compact path data, after a separator unless its sign is one.
+static void put_short(StrBuilder* out, int64_t key, uint8_t precision, int8_t separate) {
+  if (separate && key >= 0) out->str[out->length++] = ' ';
+  out->length += fmt_key_short(out->str + out->length, key, precision);
+}
+
+// Appends `attribute="opacity"` in the shortest form.
+static int8_t put_opacity(StrBuilder* out, StrView attribute, float opacity, uint8_t precision) {
+  if (str_builder_grow(out, attribute.length + FMT_MAX + 2) != 0) return -1;
+  put_lit(out, attribute);
+  put_short(out, fmt_fixed_key(opacity, precision), precision, 0);
+  out->str[out->length++] = '"';
+  out->str[out->length] = '\0';
+  return 0;
+}
+
+int8_t svg_path_fill(SvgPath* p, Hsla fill) {
+  return p->compact ? put_hex(p, fill) : svg_hsla(p->out, fill, p->color_precision);
+}
+
+int8_t svg_group_begin(StrBuilder* out, float opacity, uint8_t precision) {
+  if (put_opacity(out, STR_LIT("<g fill-opacity=\""), opacity, precision) != 0) return -1;
+  return str_builder_append(out, STR_LIT(">\n"));
+}
+
+int8_t svg_group_end(StrBuilder* out) {
+  return str_builder_append(out, STR_LIT("</g>\n"));
+}
+
+int8_t svg_path_begin(SvgPath* p, Hsla fill) {
+  p->command = 0;
+  if (p->compact) {
+    if (str_builder_append(p->out, STR_LIT("<path fill=\"")) != 0 || put_hex(p, fill) != 0) return -1;
+    if (str_builder_append(p->out, STR_LIT("\"")) != 0) return -1;
+    if (fmt_fixed_key(fill.a, p->color_precision) != fmt_fixed_key(p->opacity, p->color_precision) &&
+        put_opacity(p->out, STR_LIT(" fill-opacity=\""), fill.a, p->color_precision) != 0) return -1;
+    return str_builder_append(p->out, STR_LIT(" d=\""));
+  }
+  if (str_builder_append(p->out, STR_LIT("<path style=\"fill:")) != 0) return -1;
+  if (svg_hsla(p->out, fill, p->color_precision) != 0) return -1;
+  return str_builder_append(p->out, STR_LIT(";stroke:none;fill-opacity:1\" d=\""));
+}
+
+int8_t svg_path_move(SvgPath* p, float x, float y) {
+  if (str_builder_grow(p->out, SVG_POINT_MAX + 2) != 0) return -1;
+  if (p->compact) {
+    p->x = fmt_fixed_key(x, p->coord_precision);
+    p->y = fmt_fixed_key(y, p->coord_precision);
+    p->out->str[p->out->length++] = 'M';
+    put_short(p->out, p->x, p->coord_precision, 0);
+    put_short(p->out, p->y, p->coord_precision, 1);
+    p->out->str[p->out->length] = '\0';
+    p->command = 'M';
+    return 0;
+  }
+  put_lit(p->out, STR_LIT("M "));
+  put_point(p->out, x, y, p->coord_precision);
+  p->out->str[p->out->length] = '\0';
+  return 0;
+}
+
+// Relative to the current point as written, so that the offsets add up to the absolute
+// coordinates exactly; a command following another c leaves its letter out.
+static void put_relative_cubic(SvgPath* p, const float coords[6]) {
+  const int8_t repeated = p->command == 'c';
+  if (!repeated) p->out->str[p->out->length++] = 'c';
+  for (int i = 0; i < 6; i++) {
+    const int64_t key = fmt_fixed_key(coords[i], p->coord_precision);
+    put_short(p->out, key - ((i % 2 == 0) ? p->x : p->y), p->coord_precision, repeated || i != 0);
+    if (i == 4) p->x = key;
+    if (i == 5) p->y = key;
+  }
+  p->out->str[p->out->length] = '\0';
+  p->command = 'c';
+}
+
+int8_t svg_path_cubic(SvgPath* p, float x1, float y1, float x2, float y2, float x, float y) {
+  if (str_builder_grow(p->out, 3 * SVG_POINT_MAX + 5) != 0) return -1;
+  if (p->compact) {
+    const float coords[6] = {x1, y1, x2, y2, x, y};
+    put_relative_cubic(p, coords);
+    return 0;
+  }
+  put_lit(p->out, STR_LIT(" C "));
+  put_point(p->out, x1, y1, p->coord_precision);
+  p->out->str[p->out->length++] = ' ';
+  put_point(p->out, x2, y2, p->coord_precision);
+  p->out->str[p->out->length++] = ' ';
+  put_point(p->out, x, y, p->coord_precision);
+  p->out->str[p->out->length] = '\0';
+  return 0;
+}
+
+int8_t svg_path_close(SvgPath* p) {
+  return str_builder_append(p->out, p->compact ? STR_LIT("z\"/>\n") : STR_LIT(" Z\"/>\n"));
+}
+
+int8_t svg_path_close_open(SvgPath* p) {
+  return str_builder_append(p->out, p->compact ? STR_LIT("z\">\n") : STR_LIT(" Z\">\n"));
+}
+
+int8_t svg_path_end(SvgPath* p) {
+  return str_builder_append(p->out, STR_LIT("</path>\n"));
+}
+
+int8_t svg_animate(StrBuilder* out, StrView attribute, StrView key_times, StrView values, double seconds) {
+  if (str_builder_grow(out, attribute.length + key_times.length + values.length + FMT_MAX + 128) != 0) return -1;
+  put_lit(out, STR_LIT("<animate attributeName=\""));
+  put_lit(out, attribute);
+  put_lit(out, STR_LIT("\" dur=\""));
+  out->length += fmt_fixed(out->str + out->length, seconds, 3);
+  put_lit(out, STR_LIT("s\" repeatCount=\"indefinite\" calcMode=\"discrete\" keyTimes=\""));
+  put_lit(out, key_times);
+  put_lit(out, STR_LIT("\" values=\""));
+  put_lit(out, values);
+  put_lit(out, STR_LIT("\"/>\n"));
+  out->str[out->length] = '\0';
+  return 0;
+}
@@ -0,0 +1,160 @@
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include "../include/stats.h"
+#include "../include/template.h"
+#include "../include/utils.h"
+
+static int8_t push_segment(Template* t, uint32_t* capacity, uint64_t offset, uint64_t length, int16_t slot) {
+  if (length == 0 && slot == TEMPLATE_LITERAL) return 0;
+
+  if (t->count == *capacity) {
+    uint32_t grown_capacity = (*capacity == 0) ? 16 : *capacity * 2;
+    TemplateSegment* grown = (TemplateSegment*)realloc(t->segments, grown_capacity * sizeof(TemplateSegment));
+    if (grown == NULL) {
+      DEBUG_PRINT("err! push_segment(): failed to allocate memory for t->segments.\n");
+      return -1;
+    }
+    t->segments = grown;
+    *capacity = grown_capacity;
+  }
+  t->segments[t->count++] = (TemplateSegment){offset, length, slot};
+  return 0;
+}
+
+static int8_t compile(Template* t, String source, int8_t mapped, const StrView keys[], uint16_t key_count) {
+  StrMatcher matcher;
+  uint32_t capacity = 0;
+  uint16_t slot;
+
+  *t = (Template){0};
+  t->source = source;
+  t->mapped = mapped;
+  t->keys = keys;
+  t->key_count = key_count;
+
+  if (str_matcher_build(&matcher, keys, key_count) != 0) {
+    template_free(t);
+    return -1;
+  }
+
+  // every key is found in one pass over the preset; the longest key wins, so "$A" never shadows "$AB".
+  uint64_t literal_from = 0;
+  for (int64_t at = str_matcher_find(&matcher, str_view(source), 0, &slot); at != -1; at = str_matcher_find(&matcher, str_view(source), literal_from, &slot)) {
+    if (push_segment(t, &capacity, literal_from, at - literal_from, TEMPLATE_LITERAL) != 0 ||
+        push_segment(t, &capacity, at, keys[slot].length, slot) != 0) {
+      str_matcher_free(&matcher);
+      template_free(t);
+      return -1;
+    }
+    literal_from = at + keys[slot].length;
+  }
+  str_matcher_free(&matcher);
+
+  if (push_segment(t, &capacity, literal_from, source.length - literal_from, TEMPLATE_LITERAL) != 0) {
+    template_free(t);
+    return -1;
+  }
+  return 0;
+}
+
+int8_t template_compile(Template* t, String source, const StrView keys[], uint16_t key_count) {
+  return compile(t, source, 0, keys, key_count);
+}
+
+int8_t template_load(Template* t, const char* filename, const StrView keys[], uint16_t key_count) {
+  STATS_SCOPE(STAT_LOAD);
+  struct stat st;
+  String source = str_from(NULL);
+
+  if (stat(filename, &st) != 0 || map_file(filename, &source) != 0) {
+    DEBUG_PRINT("err! template_load(): failed to map %s.\n", filename);
+    return -1;
+  }
+  if (compile(t, source, 1, keys, key_count) != 0) return -1;
+
+  t->filename = filename;
+  t->mtime = st.st_mtim;
+  t->size = st.st_size;
+  return 0;
+}
+
+int8_t template_stale(const Template* t) {
+  struct stat st;
+
+  if (t->filename == NULL) return 1;
+  if (stat(t->filename, &st) != 0) {
+    DEBUG_PRINT("err! template_stale(): failed to stat %s.\n", t->filename);
+    return -1;
+  }
+  return !(st.st_mtim.tv_sec == t->mtime.tv_sec && st.st_mtim.tv_nsec == t->mtime.tv_nsec && (uint64_t)st.st_size == t->size);
+}
+
+int8_t template_refresh(Template* t, const char* filename, const StrView keys[], uint16_t key_count) {
+  const int8_t stale = template_stale(t);
+  if (stale <= 0) return stale;
+
+  // compile into a scratch template so a failed reload keeps the old one usable.
+  Template fresh;
+  if (template_load(&fresh, filename, keys, key_count) != 0) return -1;
+  template_free(t);
+  *t = fresh;
+  return 1;
+}
+
+int8_t template_acquire(Template* t, pthread_rwlock_t* lock, const char* filename, const StrView keys[], uint16_t key_count) {
+  pthread_rwlock_rdlock(lock);
+  const int8_t stale = template_stale(t);
+  if (stale == 0) return 0;
+  pthread_rwlock_unlock(lock);
+  if (stale < 0) return -1;
+
+  // another thread may have reloaded it meanwhile, template_refresh() checks again.
+  pthread_rwlock_wrlock(lock);
+  const int8_t loaded = template_refresh(t, filename, keys, key_count);
+  pthread_rwlock_unlock(lock);
+  if (loaded < 0) return -1;
+  pthread_rwlock_rdlock(lock);
+  return 0;
+}
+
+uint64_t template_literal_length(const Template* t) {
+  uint64_t length = 0;
+  for (uint32_t i = 0; i < t->count; i++) {
+    if (t->segments[i].slot == TEMPLATE_LITERAL) length += t->segments[i].length;
+  }
+  return length;
+}
+
+int8_t template_render(const Template* t, StrBuilder* out, TemplateFill fill, void* ctx) {
+  for (uint32_t i = 0; i < t->count; i++) {
+    const TemplateSegment* seg = &t->segments[i];
+    int8_t status = (seg->slot == TEMPLATE_LITERAL)
+      ? str_builder_append(out, (StrView){t->source.str + seg->offset, seg->length})
+      : fill(out, seg->slot, ctx);
+    if (status != 0) return -1;
+  }
+  return 0;
+}
+
+int8_t template_render_chain(const Template* t, StrChain* chain, TemplateFill fill, void* ctx) {
+  for (uint32_t i = 0; i < t->count; i++) {
+    const TemplateSegment* seg = &t->segments[i];
+    int8_t status = (seg->slot == TEMPLATE_LITERAL)
+      ? str_chain_append_ref(chain, (StrView){t->source.str + seg->offset, seg->length})
+      : fill(&chain->text, seg->slot, ctx);
+    if (status != 0) return -1;
+  }
+  return str_chain_end(chain);
+}
+
+void template_free(Template* t) {
+  if (t->mapped) {
+    unmap_file(&t->source);
+  } else if (t->source.str != NULL) {
+    str_release(&t->source);
+  }
+  free(t->segments);
+  *t = (Template){0};
+}
@@ -2,7 +2,19 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/sendfile.h>
 #include "../include/strings.h"
+#include "../include/rng.h"
+#include "../include/stats.h"
+#include "../include/utils.h"
 #include <math.h>
 
 // Reads given character sequence file int *read_content.
@@ -39,26 +51,220 @@ int8_t read_file_content(const char* filename, String* read_content) {
 
     read_content->str[read_size] = '\0';
     read_content->length = read_size;
+    stats_add(STAT_FILE_READS, 1);
+    stats_add(STAT_READ_BYTES, read_size);
 
     fclose(fp);
     return 0;
 }
 
+// Reads the file behind fd, of the given size, into a null-terminated heap buffer.
+// A file truncated meanwhile only gives what is left of it.
+// Returns 0 on success and -1 on failure.
+static int8_t read_fd(int fd, uint64_t size, String* content) {
+    char* buffer = (char*)malloc(size + 1);
+    if (buffer == NULL) {
+        return -1;
+    }
+    uint64_t length = 0;
+    while (length < size) {
+        ssize_t n = pread(fd, buffer + length, size - length, length);
+        if (n == -1 && errno == EINTR) continue;
+        if (n == -1) {
+            free(buffer);
+            return -1;
+        }
+        if (n == 0) break;
+        length += n;
+    }
+    buffer[length] = '\0';
+    *content = (String){buffer, length};
+    return 0;
+}
+
+// Maps filename read-only into *content instead of copying it, unless it is small.
+// Returns 0 on success and -1 on failure.
+int8_t map_file(const char* filename, String* content) {
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    // small files, like presets being edited, are copied: a mapping would fault once
+    // an editor truncates the file in place.
+    if (st.st_size < MAP_FILE_MIN) {
+        const int8_t status = read_fd(fd, (uint64_t)st.st_size, content);
+        close(fd);
+        if (status != 0) return -1;
+    } else {
+        char* mapped = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED) {
+            return -1;
+        }
+        *content = (String){mapped, (uint64_t)st.st_size};
+    }
+    stats_add(STAT_FILE_READS, 1);
+    stats_add(STAT_READ_BYTES, content->length);
+    return 0;
+}
+
+// Unmaps or frees what map_file() loaded and resets its fields.
+void unmap_file(String* content) {
+    if (content->str != NULL) {
+        if (content->length < MAP_FILE_MIN) free(content->str);
+        else munmap(content->str, content->length);
+    }
+    *content = (String){NULL, 0};
+}
+
+int8_t write_all(int fd, StrView content) {
+    uint64_t written = 0;
+    while (written < content.length) {
+        ssize_t n = write(fd, content.str + written, content.length - written);
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) break;
+        written += n;
+    }
+    stats_add(STAT_FILE_WRITES, 1);
+    stats_add(STAT_WRITE_BYTES, written);
+    return (written == content.length) ? 0 : -1;
+}
+
+// most bytes handed to one sendfile(2) call, which moves at most about 2GB at once.
+#define SENDFILE_CHUNK (1 << 30)
+
+int8_t write_from_fd(int fd, int from) {
+    uint64_t written = 0;
+    ssize_t n;
+    while ((n = sendfile(fd, from, NULL, SENDFILE_CHUNK)) != 0) {
+        if (n == -1 && errno == EINTR) continue;
+        if (n == -1) break;
+        written += n;
+    }
+    // files sendfile() does not support are copied through a buffer.
+    if (n == -1 && written == 0 && (errno == EINVAL || errno == ENOSYS)) {
+        char buffer[1 << 16];
+        while ((n = read(from, buffer, sizeof(buffer))) != 0) {
+            if (n == -1 && errno == EINTR) continue;
+            if (n == -1 || write_all(fd, (StrView){buffer, (uint64_t)n}) != 0) return -1;
+        }
+        return 0;
+    }
+    stats_add(STAT_FILE_WRITES, 1);
+    stats_add(STAT_WRITE_BYTES, written);
+    return (n == 0) ? 0 : -1;
+}
+
 // Writes given content to filename.
 // returns 0 on success and -1 on failure.
-int8_t write_to_file(const char* filename, const String content) {
-    FILE* fp = fopen(filename, "w");
-    if (fp == NULL) {
+// Uses plain write(2) rather than stdio, so that writing allocates nothing.
+int8_t write_to_file(const char* filename, StrView content) {
+    int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
         return -1;    
     }
     
-    size_t written = fwrite(content.str, sizeof(char), content.length, fp);
-    fclose(fp);
+    int8_t status = write_all(fd, content);
+    close(fd);
     
-    return (written == str_len(content)) ? 0 : -1;   
+    return status;   
+}
+
+// parts handed to one writev(2) call; IOV_MAX is 1024 on Linux but only visible to X/Open code.
+#define WRITEV_BATCH 1024
+
+// The parts are written WRITEV_BATCH at a time.
+int8_t write_chain(int fd, const StrChain* chain) {
+    struct iovec iov[WRITEV_BATCH];
+    uint64_t written = 0;
+    uint32_t next = 0;  // first part not handed to writev() yet.
+    int count = 0;
+    int first = 0;      // first iov entry not completely written.
+
+    while (first < count || next < chain->count) {
+        // refill the free end of the batch.
+        if (first == count) first = count = 0;
+        while (count < WRITEV_BATCH && next < chain->count) {
+            StrView part = str_chain_part(chain, next++);
+            iov[count++] = (struct iovec){(void*)part.str, part.length};
+        }
+
+        ssize_t n = writev(fd, iov + first, count - first);
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) break;
+        written += n;
+        // skip what was written, the last entry may have been written in part.
+        for (; first < count && (size_t)n >= iov[first].iov_len; first++) n -= iov[first].iov_len;
+        if (first < count) {
+            iov[first].iov_base = (char*)iov[first].iov_base + n;
+            iov[first].iov_len -= n;
+        }
+    }
+    stats_add(STAT_FILE_WRITES, 1);
+    stats_add(STAT_WRITE_BYTES, written);
+    return (written == chain->length) ? 0 : -1;
+}
+
+int8_t atomic_file_open(AtomicFile* file, const char* filename) {
+    // the temporary file sits next to the target, rename(2) is only atomic within a filesystem.
+    static const char suffix[] = ".XXXXXX";
+    const size_t length = strlen(filename);
+    if (length + sizeof(suffix) > sizeof(file->tmp)) {
+        return -1;
+    }
+    memcpy(file->tmp, filename, length);
+    memcpy(file->tmp + length, suffix, sizeof(suffix));
+
+    file->fd = mkstemp(file->tmp);
+    if (file->fd == -1) {
+        return -1;
+    }
+    // mkstemp creates the file private to the user, make it look like any other output.
+    if (fchmod(file->fd, 0644) != 0) {
+        close(file->fd);
+        unlink(file->tmp);
+        return -1;
+    }
+    return 0;
+}
+
+int8_t atomic_file_commit(AtomicFile* file, const char* filename, int8_t status) {
+    if (close(file->fd) != 0) status = -1;
+    if (status == 0 && rename(file->tmp, filename) != 0) status = -1;
+    if (status != 0) unlink(file->tmp);
+    file->fd = -1;
+    return status;
+}
+
+int8_t write_to_file_atomic(const char* filename, StrView content) {
+    AtomicFile file;
+    if (atomic_file_open(&file, filename) != 0) {
+        return -1;
+    }
+    return atomic_file_commit(&file, filename, write_all(file.fd, content));
 }
 
-String greet() {
+int8_t make_parents(char* path) {
+    for (char* slash = strchr(path, '/'); slash != NULL; slash = strchr(slash + 1, '/')) {
+        if (slash == path) continue; // the root always exists.
+        *slash = '\0';
+        const int failed = mkdir(path, 0777) != 0 && errno != EEXIST;
+        *slash = '/';
+        if (failed) {
+            DEBUG_PRINT("err! make_parents(): failed to create the directories of %s.\n", path);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+StrView greet() {
     time_t now;
     now = time(NULL);
     struct tm *local = localtime(&now);
@@ -66,51 +272,50 @@ String greet() {
     int hour = local->tm_hour;
 
     if (hour >= 5 && hour < 12) {
-        return str_from("Good morning!");
+        return STR_LIT("Good morning!");
     } else if (hour >= 12 && hour < 17) {
-        return str_from("Good afternoon!");
+        return STR_LIT("Good afternoon!");
     } else if (hour >= 17 && hour < 21) {
-        return str_from("Good evening!");
+        return STR_LIT("Good evening!");
     } else {
-        return str_from("Good night!");
-    }
-    return str_from("oops! something happened!");
-}
-
-String get_quote() {
-    char* quotes[] = {
-        "Focus on progress, not perfection.",
-        "Small steps every day lead to big results.",
-        "Success is the sum of small efforts, repeated daily.",
-        "Start where you are. Use what you have. Do what you can.",
-        "Discipline is the bridge between goals and accomplishment.",
-        "Don’t wish for it. Work for it.",
-        "You don’t have to be perfect to be amazing.",
-        "Dream big. Start small. Act now.",
-        "Your future depends on what you do today.",
-        "Push yourself, because no one else is going to do it for you."
+        return STR_LIT("Good night!");
+    }
+    return STR_LIT("oops! something happened!");
+}
+
+StrView get_quote(Rng* rng) {
+    static const StrView quotes[] = {
+        STR_LIT("Focus on progress, not perfection."),
+        STR_LIT("Small steps every day lead to big results."),
+        STR_LIT("Success is the sum of small efforts, repeated daily."),
+        STR_LIT("Start where you are. Use what you have. Do what you can."),
+        STR_LIT("Discipline is the bridge between goals and accomplishment."),
+        STR_LIT("Don’t wish for it. Work for it."),
+        STR_LIT("You don’t have to be perfect to be amazing."),
+        STR_LIT("Dream big. Start small. Act now."),
+        STR_LIT("Your future depends on what you do today."),
+        STR_LIT("Push yourself, because no one else is going to do it for you.")
     };
     
     int num_quotes = sizeof(quotes) / sizeof(quotes[0]);
-    int index = rand() % num_quotes;
-    return str_from(quotes[index]);
+    int index = rng_below(rng, num_quotes);
+    return quotes[index];
 }
 
 // returns a random number between x and y.
-float rand_range(float x, float y) {
+float rand_range(Rng* rng, float x, float y) {
     if (x > y) {
         float temp = x;
         x = y;
         y = temp;
     }
-    return x + ((float)rand() / RAND_MAX) * (y - x);
+    return x + rng_float(rng) * (y - x);
 }
 
 // matrix transformation functions.
-typedef struct {float x; float y;} Point;
-
-Point rand_point(Point begin, Point end) {
-    return (Point) {rand_range(begin.x, end.x), rand_range(begin.y, end.y)};
+Point rand_point(Rng* rng, Point begin, Point end) {
+    const float x = rand_range(rng, begin.x, end.x);
+    return (Point) {x, rand_range(rng, begin.y, end.y)};
 }
 
 // Function to compute the centroid of the shape
@@ -127,11 +332,8 @@ Point get_centroid(int row, int col, int C[][col]) {
 }
 
 // Function to rotate a single point around a given origin
-static void rotate_point(int *x, int *y, Point centroid, double angle_degrees) {
-    double angle_radians = angle_degrees * M_PI / 180.0;
-    double sin_angle = sin(angle_radians);
-    double cos_angle = cos(angle_radians);
-
+// sin and cos of the angle are computed once by the caller for the whole shape.
+static void rotate_point(int *x, int *y, Point centroid, double sin_angle, double cos_angle) {
     int translated_x = *x - centroid.x;
     int translated_y = *y - centroid.y;
 
@@ -147,10 +349,13 @@ static void rotate_point(int *x, int *y, Point centroid, double angle_degrees) {
 // Function to rotate the matrix around its center
 void transform_rotate(int row, int col, int C[][col], double angle_degrees) {
     Point centroid = get_centroid(row, col, C);
+    double angle_radians = angle_degrees * M_PI / 180.0;
+    double sin_angle = sin(angle_radians);
+    double cos_angle = cos(angle_radians);
 
     for (int i = 0; i < row; i++) {
         for (int j = 0; j < col; j += 2) { // Only x, y pairs
-            rotate_point(&C[i][j], &C[i][j + 1], centroid, angle_degrees);
+            rotate_point(&C[i][j], &C[i][j + 1], centroid, sin_angle, cos_angle);
         }
     }
 }
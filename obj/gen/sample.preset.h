@@ -0,0 +1,101 @@
+/*
+Generated by tools/presetgen.c from assets/sample.preset, do not edit.
+Include it after the SLOT_* constants and fill_slot() of its preset.
+*/
+
+// str_hash() of the built-in copy of the preset.
+#define BUILTIN_PRESET_HASH 0x21568c5f201b4494ULL
+
+// Renders the built-in copy of the preset into chain and ends it: the literal text
+// is referenced, the placeholders are filled in document order.
+// Returns 0 on success and -1 on failure.
+static inline int8_t render_builtin(StrChain* chain, void* ctx) {
+    if (str_chain_append_ref(chain, STR_LIT(
+        "<\?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"no\" \?>\n"
+        "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"1920\" height=\"1080\" viewBox=\"0 0 1920 1080\">\n"
+        "<rect fill=\"rgb(238,238,238)\" x=\"0\" y=\"0\" width=\"1920\" height=\"1080\"/>\n"
+        "<circle fill=\"")) != 0) return -1;
+    if (fill_slot(&chain->text, SLOT_COLOR, ctx) != 0) return -1;
+    if (str_chain_append_ref(chain, STR_LIT(
+        "\" cx=\"")) != 0) return -1;
+    if (fill_slot(&chain->text, SLOT_X, ctx) != 0) return -1;
+    if (str_chain_append_ref(chain, STR_LIT(
+        "\" cy=\"")) != 0) return -1;
+    if (fill_slot(&chain->text, SLOT_Y, ctx) != 0) return -1;
+    if (str_chain_append_ref(chain, STR_LIT(
+        "\" r=\"")) != 0) return -1;
+    if (fill_slot(&chain->text, SLOT_RADIUS, ctx) != 0) return -1;
+    if (str_chain_append_ref(chain, STR_LIT(
+        "\"/>\n"
+        "<circle fill=\"")) != 0) return -1;
+    if (fill_slot(&chain->text, SLOT_COLOR, ctx) != 0) return -1;
+    if (str_chain_append_ref(chain, STR_LIT(
+        "\" cx=\"")) != 0) return -1;
+    if (fill_slot(&chain->text, SLOT_X, ctx) != 0) return -1;
+    if (str_chain_append_ref(chain, STR_LIT(
+        "\" cy=\"")) != 0) return -1;
+    if (fill_slot(&chain->text, SLOT_Y, ctx) != 0) return -1;
+    if (str_chain_append_ref(chain, STR_LIT(
+        "\" r=\"")) != 0) return -1;
+    if (fill_slot(&chain->text, SLOT_RADIUS, ctx) != 0) return -1;
+    if (str_chain_append_ref(chain, STR_LIT(
+        "\"/>\n"
+        "<circle fill=\"")) != 0) return -1;
+    if (fill_slot(&chain->text, SLOT_COLOR, ctx) != 0) return -1;
+    if (str_chain_append_ref(chain, STR_LIT(
+        "\" cx=\"")) != 0) return -1;
+    if (fill_slot(&chain->text, SLOT_X, ctx) != 0) return -1;
+    if (str_chain_append_ref(chain, STR_LIT(
+        "\" cy=\"")) != 0) return -1;
+    if (fill_slot(&chain->text, SLOT_Y, ctx) != 0) return -1;
+    if (str_chain_append_ref(chain, STR_LIT(
+        "\" r=\"")) != 0) return -1;
+    if (fill_slot(&chain->text, SLOT_RADIUS, ctx) != 0) return -1;
+    if (str_chain_append_ref(chain, STR_LIT(
+        "\"/>\n"
+        "<circle fill=\"")) != 0) return -1;
+    if (fill_slot(&chain->text, SLOT_COLOR, ctx) != 0) return -1;
+    if (str_chain_append_ref(chain, STR_LIT(
+        "\" cx=\"")) != 0) return -1;
+    if (fill_slot(&chain->text, SLOT_X, ctx) != 0) return -1;
+    if (str_chain_append_ref(chain, STR_LIT(
+        "\" cy=\"")) != 0) return -1;
+    if (fill_slot(&chain->text, SLOT_Y, ctx) != 0) return -1;
+    if (str_chain_append_ref(chain, STR_LIT(
+        "\" r=\"")) != 0) return -1;
+    if (fill_slot(&chain->text, SLOT_RADIUS, ctx) != 0) return -1;
+    if (str_chain_append_ref(chain, STR_LIT(
+        "\"/>\n"
+        "<circle fill=\"")) != 0) return -1;
+    if (fill_slot(&chain->text, SLOT_COLOR, ctx) != 0) return -1;
+    if (str_chain_append_ref(chain, STR_LIT(
+        "\" cx=\"")) != 0) return -1;
+    if (fill_slot(&chain->text, SLOT_X, ctx) != 0) return -1;
+    if (str_chain_append_ref(chain, STR_LIT(
+        "\" cy=\"")) != 0) return -1;
+    if (fill_slot(&chain->text, SLOT_Y, ctx) != 0) return -1;
+    if (str_chain_append_ref(chain, STR_LIT(
+        "\" r=\"")) != 0) return -1;
+    if (fill_slot(&chain->text, SLOT_RADIUS, ctx) != 0) return -1;
+    if (str_chain_append_ref(chain, STR_LIT(
+        "\"/>\n"
+        "<circle fill=\"")) != 0) return -1;
+    if (fill_slot(&chain->text, SLOT_COLOR, ctx) != 0) return -1;
+    if (str_chain_append_ref(chain, STR_LIT(
+        "\" cx=\"")) != 0) return -1;
+    if (fill_slot(&chain->text, SLOT_X, ctx) != 0) return -1;
+    if (str_chain_append_ref(chain, STR_LIT(
+        "\" cy=\"")) != 0) return -1;
+    if (fill_slot(&chain->text, SLOT_Y, ctx) != 0) return -1;
+    if (str_chain_append_ref(chain, STR_LIT(
+        "\" r=\"")) != 0) return -1;
+    if (fill_slot(&chain->text, SLOT_RADIUS, ctx) != 0) return -1;
+    if (str_chain_append_ref(chain, STR_LIT(
+        "\"/>\n"
+        "<text style=\"fill: rgb(51, 51, 51); font-family: Arial, sans-serif; font-size: 53px; white-space: pre; text-anchor: middle;\" x=\"996.143\" y=\"539.106\">")) != 0) return -1;
+    if (fill_slot(&chain->text, SLOT_GREETING, ctx) != 0) return -1;
+    if (str_chain_append_ref(chain, STR_LIT(
+        "</text>\n"
+        "</svg>\n")) != 0) return -1;
+    return str_chain_end(chain);
+}
@@ -0,0 +1,44 @@
+/*
+Generated by tools/presetgen.c from assets/triogons.preset, do not edit.
+Include it after the SLOT_* constants and fill_slot() of its preset.
+*/
+
+// str_hash() of the built-in copy of the preset.
+#define BUILTIN_PRESET_HASH 0x425d08ba1b1de0a0ULL
+
+// Renders the built-in copy of the preset into chain and ends it: the literal text
+// is referenced, the placeholders are filled in document order.
+// Returns 0 on success and -1 on failure.
+static inline int8_t render_builtin(StrChain* chain, void* ctx) {
+    if (str_chain_append_ref(chain, STR_LIT(
+        "<\?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"no\" \?>\n"
+        "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"")) != 0) return -1;
+    if (fill_slot(&chain->text, SLOT_CANVAS_WIDTH, ctx) != 0) return -1;
+    if (str_chain_append_ref(chain, STR_LIT(
+        "\" height=\"")) != 0) return -1;
+    if (fill_slot(&chain->text, SLOT_CANVAS_HEIGHT, ctx) != 0) return -1;
+    if (str_chain_append_ref(chain, STR_LIT(
+        "\" viewBox=\"0 0 ")) != 0) return -1;
+    if (fill_slot(&chain->text, SLOT_CANVAS_WIDTH, ctx) != 0) return -1;
+    if (str_chain_append_ref(chain, STR_LIT(
+        " ")) != 0) return -1;
+    if (fill_slot(&chain->text, SLOT_CANVAS_HEIGHT, ctx) != 0) return -1;
+    if (str_chain_append_ref(chain, STR_LIT(
+        "\">\n"
+        "<rect x=\"0\" y=\"0\" width=\"")) != 0) return -1;
+    if (fill_slot(&chain->text, SLOT_CANVAS_WIDTH, ctx) != 0) return -1;
+    if (str_chain_append_ref(chain, STR_LIT(
+        "\" height=\"")) != 0) return -1;
+    if (fill_slot(&chain->text, SLOT_CANVAS_HEIGHT, ctx) != 0) return -1;
+    if (str_chain_append_ref(chain, STR_LIT(
+        "\" style=\"fill: ")) != 0) return -1;
+    if (fill_slot(&chain->text, SLOT_THEME, ctx) != 0) return -1;
+    if (str_chain_append_ref(chain, STR_LIT(
+        ";\"/>\n")) != 0) return -1;
+    if (fill_slot(&chain->text, SLOT_TRIOGONS, ctx) != 0) return -1;
+    if (str_chain_append_ref(chain, STR_LIT(
+        "\n"
+        "</svg>\n"
+        "\n")) != 0) return -1;
+    return str_chain_end(chain);
+}
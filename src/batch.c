@@ -0,0 +1,265 @@
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include "../include/batch.h"
+#include "../include/pool.h"
+#include "../include/fmt.h"
+#include "../include/strings.h"
+#include "../include/template.h"
+#include "../include/utils.h"
+
+static const StrView OUT_KEYS[] = BATCH_OUT_KEYS;
+enum {SLOT_PRESET, SLOT_THEME, SLOT_WIDTH, SLOT_HEIGHT, SLOT_SEED};
+
+// One render of the batch: a cell of the job matrix, or all the sizes of a preset
+// that renders them in one pass.
+typedef struct {
+    const Batch* batch;
+    const BatchPreset* preset;
+    Theme theme;
+    uint16_t size; // index in batch->sizes; size_count for all of them.
+    uint64_t seed;
+    int8_t status;
+} BatchJob;
+
+// Values of the job being rendered, used to fill the output pattern.
+typedef struct {
+    const BatchPreset* preset;
+    RenderParams params;
+} JobValues;
+
+// Grows items to hold count + more elements of size bytes, NULL on failure.
+static void* batch_grow(void* items, uint64_t count, uint64_t more, size_t size) {
+    void* grown = realloc(items, (count + more) * size);
+    if (grown == NULL) DEBUG_PRINT("err! batch: failed to allocate memory for the job matrix.\n");
+    return grown;
+}
+
+// Returns the length of the list item starting at s.
+static size_t item_length(const char* s) {
+    const char* comma = strchr(s, ',');
+    return (comma != NULL) ? (size_t)(comma - s) : strlen(s);
+}
+
+int8_t batch_add_presets(Batch* b, const char* list, const BatchPreset registry[], uint16_t registry_count) {
+    for (const char* s = list; ; s++) {
+        const size_t n = item_length(s);
+        uint16_t i = 0;
+        while (i < registry_count && !(strlen(registry[i].name) == n && strncmp(registry[i].name, s, n) == 0)) i++;
+        if (i == registry_count) {
+            DEBUG_PRINT("err! batch: unknown preset %.*s.\n", (int)n, s);
+            return -1;
+        }
+        const BatchPreset** grown = batch_grow(b->presets, b->preset_count, 1, sizeof(*grown));
+        if (grown == NULL) return -1;
+        b->presets = grown;
+        b->presets[b->preset_count++] = &registry[i];
+        s += n;
+        if (*s == '\0') return 0;
+    }
+}
+
+int8_t batch_add_themes(Batch* b, const char* list) {
+    for (const char* s = list; ; s++) {
+        const size_t n = item_length(s);
+        Theme theme;
+        if (n == 5 && strncmp(s, "lumos", n) == 0) {
+            theme = Lumos;
+        } else if (n == 4 && strncmp(s, "noir", n) == 0) {
+            theme = Noir;
+        } else {
+            DEBUG_PRINT("err! batch: unknown theme %.*s.\n", (int)n, s);
+            return -1;
+        }
+        Theme* grown = batch_grow(b->themes, b->theme_count, 1, sizeof(*grown));
+        if (grown == NULL) return -1;
+        b->themes = grown;
+        b->themes[b->theme_count++] = theme;
+        s += n;
+        if (*s == '\0') return 0;
+    }
+}
+
+int8_t batch_add_sizes(Batch* b, const char* list) {
+    for (const char* s = list; ; s++) {
+        char* end;
+        const unsigned long width = strtoul(s, &end, 10);
+        const char* x = end;
+        const unsigned long height = (*x == 'x') ? strtoul(x + 1, &end, 10) : 0;
+        if (end == s || *x != 'x' || end == x + 1 || (*end != ',' && *end != '\0') ||
+                width == 0 || height == 0 || width > UINT16_MAX || height > UINT16_MAX) {
+            DEBUG_PRINT("err! batch: invalid size %.*s, expected WIDTHxHEIGHT.\n", (int)item_length(s), s);
+            return -1;
+        }
+        BatchSize* grown = batch_grow(b->sizes, b->size_count, 1, sizeof(*grown));
+        if (grown == NULL) return -1;
+        b->sizes = grown;
+        b->sizes[b->size_count++] = (BatchSize){(uint16_t)width, (uint16_t)height};
+        s = end;
+        if (*s == '\0') return 0;
+    }
+}
+
+int8_t batch_add_seeds(Batch* b, const char* list) {
+    for (const char* s = list; ; s++) {
+        char* end;
+        const uint64_t first = strtoull(s, &end, 0);
+        uint64_t last = first;
+        const char* dash = end;
+        if (end != s && *dash == '-') last = strtoull(dash + 1, &end, 0);
+        if (end == s || end == dash + 1 || (*end != ',' && *end != '\0') || last < first || last - first >= UINT32_MAX - b->seed_count) {
+            DEBUG_PRINT("err! batch: invalid seeds %.*s.\n", (int)item_length(s), s);
+            return -1;
+        }
+        uint64_t* grown = batch_grow(b->seeds, b->seed_count, last - first + 1, sizeof(*grown));
+        if (grown == NULL) return -1;
+        b->seeds = grown;
+        for (uint64_t seed = first; ; seed++) {
+            b->seeds[b->seed_count++] = seed;
+            if (seed == last) break;
+        }
+        s = end;
+        if (*s == '\0') return 0;
+    }
+}
+
+int8_t batch_set_out(Batch* b, const char* pattern) {
+    String source = str_from(pattern);
+    if (source.str == NULL) return -1;
+    template_free(&b->out);
+    return template_compile(&b->out, source, OUT_KEYS, sizeof(OUT_KEYS) / sizeof(OUT_KEYS[0]));
+}
+
+uint64_t batch_job_count(const Batch* b) {
+    return (uint64_t)b->preset_count * b->theme_count * b->size_count * b->seed_count;
+}
+
+static int8_t fill_out(StrBuilder* out, uint16_t slot, void* ctx) {
+    const JobValues* job = ctx;
+    switch (slot) {
+        case SLOT_PRESET: return str_builder_append_cstr(out, job->preset->name);
+        case SLOT_THEME: return str_builder_append(out, (job->params.theme == Noir) ? STR_LIT("noir") : STR_LIT("lumos"));
+        case SLOT_WIDTH: return str_builder_append_int(out, job->params.width);
+        case SLOT_HEIGHT: return str_builder_append_int(out, job->params.height);
+        case SLOT_SEED: {
+            char digits[FMT_MAX];
+            return str_builder_append_n(out, digits, fmt_uint(digits, job->params.seed));
+        }
+    }
+    return -1;
+}
+
+// Appends the output path of the job described by values to paths, followed by a null
+// byte, and creates its missing directories. Returns 0 on success and -1 on failure.
+static int8_t add_path(const Batch* b, const JobValues* values, StrBuilder* paths) {
+    const uint64_t start = paths->length;
+    if (template_render(&b->out, paths, fill_out, (void*)values) != 0 || paths->length == start) return -1;
+    if (make_parents(paths->str + start) != 0) return -1;
+    return str_builder_append_n(paths, "", 1);
+}
+
+// Renders every size of the job from one pass of its preset.
+static int8_t run_sizes(const BatchJob* job, JobValues* values, StrBuilder* paths) {
+    const Batch* b = job->batch;
+    RenderSize* sizes = (RenderSize*)malloc(b->size_count * sizeof(RenderSize));
+    if (sizes == NULL) {
+        DEBUG_PRINT("err! batch: failed to allocate memory for %u sizes.\n", b->size_count);
+        return -1;
+    }
+    int8_t status = 0;
+    // the paths go into one buffer, which may move while it grows; they are located once it is complete.
+    uint64_t start = 0;
+    for (uint16_t k = 0; k < b->size_count && status == 0; k++) {
+        values->params.width = b->sizes[k].width;
+        values->params.height = b->sizes[k].height;
+        sizes[k] = (RenderSize){b->sizes[k].width, b->sizes[k].height, NULL};
+        status = add_path(b, values, paths);
+    }
+    for (uint16_t k = 0; k < b->size_count && status == 0; k++) {
+        sizes[k].path = paths->str + start;
+        start += strlen(sizes[k].path) + 1;
+    }
+    if (status == 0) {
+        status = preset_render_sizes_cached(b->cache, job->preset->render_sizes, job->preset->content, &values->params, sizes, b->size_count);
+    }
+    free(sizes);
+    return status;
+}
+
+// Renders the job into its output paths. Runs on any thread.
+static void run_job(void* arg) {
+    BatchJob* job = arg;
+    const Batch* b = job->batch;
+    JobValues values = {job->preset, {0, 0, job->theme, job->seed, b->density, NULL, NULL, job->preset->script, b->compact, 0,
+        b->accents, b->accent_count}};
+
+    StrBuilder paths = str_builder_new(template_literal_length(&b->out) + 32);
+    if (job->size == b->size_count) {
+        job->status = run_sizes(job, &values, &paths);
+    } else {
+        values.params.width = b->sizes[job->size].width;
+        values.params.height = b->sizes[job->size].height;
+        job->status = -1;
+        if (add_path(b, &values, &paths) == 0) {
+            values.params.path = paths.str;
+            job->status = preset_render_cached(b->cache, values.preset->render, values.preset->content, &values.params);
+        }
+    }
+    str_builder_free(&paths);
+}
+
+// Returns whether the preset renders all the sizes of the batch in one job.
+static int8_t renders_sizes(const Batch* b, const BatchPreset* preset) {
+    return preset->render_sizes != NULL && b->size_count > 1;
+}
+
+int8_t batch_run(const Batch* b, Pool* pool, BatchReport* report) {
+    struct timespec start, end;
+    *report = (BatchReport){batch_job_count(b), 0, 0};
+    if (report->jobs == 0) return 0;
+
+    BatchJob* jobs = (BatchJob*)malloc(report->jobs * sizeof(BatchJob));
+    if (jobs == NULL) {
+        DEBUG_PRINT("err! batch_run(): failed to allocate memory for %llu jobs.\n", (unsigned long long)report->jobs);
+        return -1;
+    }
+
+    // the seed varies fastest, so neighbouring jobs share a preset and a size.
+    uint64_t job_count = 0;
+    for (uint16_t p = 0; p < b->preset_count; p++) {
+        const int8_t all_sizes = renders_sizes(b, b->presets[p]);
+        for (uint16_t t = 0; t < b->theme_count; t++) {
+            for (uint16_t z = 0; z < (all_sizes ? 1 : b->size_count); z++) {
+                for (uint32_t s = 0; s < b->seed_count; s++) {
+                    const uint16_t size = all_sizes ? b->size_count : z;
+                    jobs[job_count++] = (BatchJob){b, b->presets[p], b->themes[t], size, b->seeds[s], -1};
+                }
+            }
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint64_t i = 0; i < job_count; i++) {
+        if (pool == NULL || pool_submit(pool, run_job, &jobs[i]) != 0) run_job(&jobs[i]);
+    }
+    if (pool != NULL) pool_wait(pool);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    // a job of every size fails as a whole.
+    for (uint64_t i = 0; i < job_count; i++) {
+        if (jobs[i].status != 0) report->failed += (jobs[i].size == b->size_count) ? b->size_count : 1;
+    }
+    report->seconds = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+    free(jobs);
+    return (report->failed == 0) ? 0 : -1;
+}
+
+void batch_free(Batch* b) {
+    free(b->presets);
+    free(b->themes);
+    free(b->sizes);
+    free(b->seeds);
+    template_free(&b->out);
+    *b = (Batch){0};
+}
@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../include/cache.h"
+#include "../include/presets.h"
+#include "../include/strings.h"
+#include "../include/utils.h"
+
+// A size of a wallpaper missing from the cache, rendered into its entry.
+typedef struct {
+    uint16_t size;   // index in the sizes asked for.
+    uint64_t key;
+    const char* ext; // NULL when the size cannot be cached.
+    char path[PATH_MAX];
+} MissingSize;
+
+int8_t preset_content_hash(const char* preset, const char* filename, uint64_t builtin, uint64_t* hash) {
+    uint64_t content = builtin;
+    if (filename != NULL) {
+        String file;
+        if (map_file(filename, &file) != 0) {
+            DEBUG_PRINT("err! preset_content_hash(): failed to read %s.\n", filename);
+            return -1;
+        }
+        content = str_hash(str_view(file));
+        unmap_file(&file);
+    }
+    char text[256];
+    const int n = snprintf(text, sizeof(text), "%s %016llx", preset, (unsigned long long)content);
+    if (n <= 0 || n >= (int)sizeof(text)) return -1;
+    *hash = str_hash((StrView){text, (uint64_t)n});
+    return 0;
+}
+
+// Hashes everything the render of params into a file of extension ext depends on.
+// Returns 0 on success and -1 on failure.
+static int8_t render_key(PresetContent content, const RenderParams* params, const char* ext, uint64_t* key) {
+    uint64_t preset;
+    if (content(params, &preset) != 0) return -1;
+    char text[256];
+    const int n = snprintf(text, sizeof(text), "%d %016llx %llu %ux%u %d %u %d %s", RENDER_CACHE_VERSION,
+        (unsigned long long)preset, (unsigned long long)params->seed, params->width, params->height,
+        (int)params->theme, params->density, (int)params->compact, ext);
+    if (n <= 0 || n >= (int)sizeof(text)) return -1;
+    *key = str_hash((StrView){text, (uint64_t)n});
+    return 0;
+}
+
+// Opens the entry of key just rendered, then adds it to the cache; it stays readable
+// even if another process evicts it right away. Returns the entry open for reading, -1 on failure.
+static int add_entry(Cache* cache, uint64_t key, const char* ext) {
+    char path[PATH_MAX];
+    if (cache_entry_path(cache, key, ext, path) != 0) return -1;
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    // an entry the index does not record is still a good render, only not kept.
+    if (fd != -1 && cache_insert(cache, key, ext) != 0) DEBUG_PRINT("err! cache: failed to record %s.\n", path);
+    return fd;
+}
+
+int8_t preset_render_cached(Cache* cache, PresetRender render, PresetContent content, const RenderParams* params) {
+    if (cache == NULL) return render(params);
+    const char* ext = preset_output_ext(params);
+    uint64_t key;
+    char entry[PATH_MAX];
+    if (render_key(content, params, ext, &key) != 0 || cache_entry_path(cache, key, ext, entry) != 0) return render(params);
+
+    int fd;
+    if (cache_lookup(cache, key, &fd) != 0) {
+        RenderParams into_entry = *params;
+        into_entry.path = entry;
+        into_entry.fd = 0;
+        fd = (render(&into_entry) == 0) ? add_entry(cache, key, ext) : -1;
+        if (fd == -1) return render(params);
+    }
+    const int8_t status = preset_sink_copy(params, fd);
+    close(fd);
+    return status;
+}
+
+int8_t preset_render_sizes_cached(Cache* cache, PresetRenderSizes render_sizes, PresetContent content,
+        const RenderParams* params, const RenderSize sizes[], uint16_t count) {
+    if (cache == NULL) return render_sizes(params, sizes, count);
+    MissingSize* missing = (MissingSize*)malloc(count * sizeof(MissingSize));
+    RenderSize* rendered = (RenderSize*)malloc(count * sizeof(RenderSize));
+    if (missing == NULL || rendered == NULL) {
+        free(missing);
+        free(rendered);
+        return render_sizes(params, sizes, count);
+    }
+
+    // the sizes found in the cache are copied right away.
+    int8_t status = 0;
+    uint16_t missing_count = 0;
+    RenderParams size_params = *params;
+    for (uint16_t k = 0; k < count; k++) {
+        size_params.width = sizes[k].width;
+        size_params.height = sizes[k].height;
+        size_params.path = sizes[k].path;
+        MissingSize* m = &missing[missing_count];
+        m->ext = preset_output_ext(&size_params);
+        int fd = -1;
+        const int8_t keyed = render_key(content, &size_params, m->ext, &m->key) == 0 &&
+            cache_entry_path(cache, m->key, m->ext, m->path) == 0;
+        if (keyed && cache_lookup(cache, m->key, &fd) == 0) {
+            if (preset_sink_copy(&size_params, fd) != 0) status = -1;
+            close(fd);
+            continue;
+        }
+        // a size that cannot be keyed is rendered with the others, straight into its path.
+        rendered[missing_count++] = (RenderSize){sizes[k].width, sizes[k].height, keyed ? m->path : sizes[k].path};
+        m->size = k;
+        if (!keyed) m->ext = NULL;
+    }
+
+    // then the others are rendered together into their entries, and copied too.
+    uint16_t failed = 0;
+    const int8_t fresh = missing_count != 0 && render_sizes(params, rendered, missing_count) == 0;
+    for (uint16_t i = 0; i < missing_count; i++) {
+        const uint16_t k = missing[i].size;
+        if (missing[i].ext == NULL) {
+            if (!fresh) rendered[failed++] = sizes[k];
+            continue;
+        }
+        const int fd = fresh ? add_entry(cache, missing[i].key, missing[i].ext) : -1;
+        if (fd == -1) {
+            rendered[failed++] = sizes[k];
+            continue;
+        }
+        size_params.width = sizes[k].width;
+        size_params.height = sizes[k].height;
+        size_params.path = sizes[k].path;
+        if (preset_sink_copy(&size_params, fd) != 0) status = -1;
+        close(fd);
+    }
+    // sizes are rendered over into their paths when the cache cannot be written; `rendered`
+    // is reused for them, its entries are read before being overwritten.
+    if (failed != 0 && render_sizes(params, rendered, failed) != 0) status = -1;
+
+    free(missing);
+    free(rendered);
+    return status;
+}
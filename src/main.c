@@ -1,16 +1,530 @@
 // this program is unfinished.
+#include <stdio.h>
 #include <time.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <errno.h>
+#include <dirent.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include "../include/batch.h"
+#include "../include/cache.h"
+#include "../include/color.h"
+#include "../include/pool.h"
+#include "../include/presets.h"
+#include "../include/rng.h"
+#include "../include/script.h"
+#include "../include/serve.h"
+#include "../include/stats.h"
+#include "../include/strings.h"
 
-typedef enum {Lumos, Noir} Theme;
+// presets built into the program; batches can also name the scripts found next to the presets.
+static const BatchPreset PRESETS[] = {
+    {"triogons", triogons, NULL, triogons_sizes, triogons_content},
+    {"sample", sample, NULL, NULL, sample_content},
+};
+#define PRESET_COUNT (uint16_t)(sizeof(PRESETS) / sizeof(PRESETS[0]))
 
-extern void sample();
-extern void triogons(uint16_t width, uint16_t height, Theme theme);
+// where scripts are looked for when --assets is not given.
+#define SCRIPT_DIR "assets"
+#define SCRIPT_EXT ".wks"
 
-int main(int argc, char** argv) {
-    srand(time(NULL));
-    triogons(1600, 900, Lumos);
-    return 0;
+// default seconds between two wallpapers of the daemon.
+#define DAEMON_INTERVAL 900
+
+// getopt value of the options that have no short form.
+#define OPT_STATS 256
+#define OPT_ASSETS 257
+#define OPT_SCRIPT 258
+#define OPT_ANIMATE 259
+#define OPT_FPS 260
+#define OPT_CACHE 261
+#define OPT_CACHE_SIZE 262
+#define OPT_COMPACT 263
+#define OPT_SERVE 264
+#define OPT_ACCENT 265
+
+// frames per second of an animation when --fps is not given.
+#define ANIMATION_FPS 30
+
+// renders are cached in this directory of the cache directory, see script_cache_dir().
+#define RENDER_CACHE_DIR "renders"
+// megabytes of renders kept when --cache-size is not given.
+#define RENDER_CACHE_MB 512
+
+static void usage(const char* name) {
+    fprintf(stderr,
+        "usage: %s [--seed N] [--threads N] [--density N] [--out PATH] [--daemon [--interval SECONDS]] [--assets DIR] [--script FILE]\n"
+        "       %*s [--compact] [--accent LIST] [--cache [--cache-size MB]] [--stats]\n"
+        "       %s --animate FRAMES [--fps N] [--seed N] [--threads N] [--density N] [--out PATH] [--compact]\n"
+        "       %s --batch [--presets LIST] [--themes LIST] [--sizes LIST] [--seeds LIST] [--out PATTERN] [--compact] [--cache]\n"
+        "       %s --serve PORT [--seed N] [--threads N] [--assets DIR] [--accent LIST] [--cache]\n"
+        "  -s, --seed N         seed of the random number generator; the same seed renders the same wallpaper\n"
+        "  -j, --threads N      threads used to render, defaults to the number of CPUs\n"
+        "  -d, --density N      number of shapes, random when not given\n"
+        "  -o, --out PATH       file the wallpaper replaces atomically (default out.svg); - streams the SVG\n"
+        "                       to stdout, pipes and other non regular files are streamed to as well;\n"
+        "                       paths ending in .svgz are gzipped, in .png or .ppm rasterized\n"
+        "  -D, --daemon         stay in the foreground and render a new wallpaper every interval\n"
+        "  -i, --interval N     seconds between two wallpapers, implies --daemon (default %d)\n"
+        "  -b, --batch          render every combination of presets, themes, sizes and seeds\n"
+        "  -p, --presets LIST   triogons,sample or the name of a script in the assets (default triogons)\n"
+        "  -t, --themes LIST    lumos,noir (default lumos)\n"
+        "  -z, --sizes LIST     WIDTHxHEIGHT,... (default 1600x900); triogons renders every size of a seed\n"
+        "                       from one set of shapes, so they all show the same wallpaper\n"
+        "  -S, --seeds LIST     seeds and ranges of seeds, eg. 1-500,1000 (default --seed)\n"
+        "  -o, --out PATTERN    in batches, output path of each job with {preset} {theme} {width} {height} {seed}\n"
+        "                       (default " BATCH_OUT_DEFAULT ")\n"
+        "      --assets DIR     load the presets from DIR/<preset>.preset instead of the built-in copies,\n"
+        "                       edits are picked up by the next render; DIR/<name>" SCRIPT_EXT " scripts become presets\n"
+        "      --script FILE    render the preset script FILE instead of triogons, see include/script.h;\n"
+        "                       compiled scripts are cached in $WOOTKAS_CACHE or ~/.cache/wootkas\n"
+        "      --animate N      render N frames of drifting triogons: one SVG animated with SMIL, or one\n"
+        "                       file per frame when --out has " ANIMATION_FRAME_KEY ", eg. frames/" ANIMATION_FRAME_KEY ".svg\n"
+        "      --fps N          frames per second of the animation (default %d)\n"
+        "      --compact        write shorter SVG that renders the same: relative path data, hex colours\n"
+        "                       and the opacity of the triogons set once\n"
+        "      --accent LIST    #rrggbb,... up to %d colours, not grey; triogons draws its hues around theirs\n"
+        "      --cache          copy renders and batch jobs made before, by any run, from the cache of\n"
+        "                       renders in the cache directory above, and add the new ones to it\n"
+        "      --cache-size MB  size the cache is kept under, least recently used renders out first (default %d)\n"
+        "      --serve PORT     render previews on request over HTTP on 127.0.0.1:PORT, 0 picks a free port;\n"
+        "                       eg. curl 'http://127.0.0.1:PORT/render?preset=triogons&theme=noir&size=1920x1080&seed=7',\n"
+        "                       GET / lists the parameters and endpoints\n"
+        "      --stats          print the time spent in each stage and the allocations and I/O as JSON on exit\n"
+        "the batch options imply --batch.\n",
+        name, (int)strlen(name), "", name, name, name, DAEMON_INTERVAL, ANIMATION_FPS, PALETTE_MAX_ACCENTS, RENDER_CACHE_MB);
+}
+
+// Fills registry with the built-in presets followed by the scripts in dir, named after their file.
+// A missing dir only leaves the built-in presets. Returns 0 on success and -1 on failure.
+static int8_t load_registry(const char* dir, BatchPreset** registry, uint16_t* count) {
+    *count = 0;
+    *registry = (BatchPreset*)malloc(sizeof(PRESETS));
+    if (*registry == NULL) return -1;
+    memcpy(*registry, PRESETS, sizeof(PRESETS));
+    *count = PRESET_COUNT;
+
+    DIR* d = opendir(dir);
+    if (d == NULL) return 0;
+    int8_t status = 0;
+    for (struct dirent* entry = readdir(d); entry != NULL && status == 0; entry = readdir(d)) {
+        const size_t length = strlen(entry->d_name);
+        const size_t ext = strlen(SCRIPT_EXT);
+        if (length <= ext || strcmp(entry->d_name + length - ext, SCRIPT_EXT) != 0) continue;
+
+        BatchPreset* grown = (*count < UINT16_MAX) ? (BatchPreset*)realloc(*registry, (*count + 1) * sizeof(BatchPreset)) : NULL;
+        char* name = strndup(entry->d_name, length - ext);
+        char* script = (char*)malloc(strlen(dir) + 1 + length + 1);
+        if (grown != NULL) *registry = grown;
+        if (grown == NULL || name == NULL || script == NULL) {
+            free(name);
+            free(script);
+            status = -1;
+            break;
+        }
+        sprintf(script, "%s/%s", dir, entry->d_name);
+        (*registry)[(*count)++] = (BatchPreset){name, scripted, script, NULL, scripted_content};
+    }
+    closedir(d);
+    return status;
 }
 
+static void free_registry(BatchPreset* registry, uint16_t count) {
+    for (uint16_t i = PRESET_COUNT; i < count; i++) {
+        free((char*)registry[i].name);
+        free((char*)registry[i].script);
+    }
+    free(registry);
+}
+
+// Fills the lists left empty with their defaults, renders the batch and reports its throughput.
+static int8_t run_batch(Batch* batch, const char* out, uint64_t seed, uint32_t density, Pool* pool) {
+    if ((batch->preset_count == 0 && batch_add_presets(batch, "triogons", PRESETS, PRESET_COUNT) != 0) ||
+        (batch->theme_count == 0 && batch_add_themes(batch, "lumos") != 0) ||
+        (batch->size_count == 0 && batch_add_sizes(batch, "1600x900") != 0) ||
+        batch_set_out(batch, (out != NULL) ? out : BATCH_OUT_DEFAULT) != 0) {
+        return -1;
+    }
+    if (batch->seed_count == 0) {
+        uint64_t* seeds = (uint64_t*)malloc(sizeof(uint64_t));
+        if (seeds == NULL) return -1;
+        seeds[0] = seed;
+        batch->seeds = seeds;
+        batch->seed_count = 1;
+    }
+    batch->density = density;
+
+    BatchReport report;
+    const int8_t status = batch_run(batch, pool, &report);
+    fprintf(stderr, "%llu jobs in %.3fs, %.1f jobs/s, %llu failed\n",
+        (unsigned long long)report.jobs, report.seconds,
+        (report.seconds > 0) ? (double)report.jobs / report.seconds : 0.0,
+        (unsigned long long)report.failed);
+    return status;
+}
+
+// Renders the animation and reports its sustained frame rate.
+static int8_t run_animation(const RenderParams* params, const Animation* animation) {
+    AnimationReport report;
+    const int8_t status = triogons_animate(params, animation, &report);
+    fprintf(stderr, "%u frames in %.3fs, %.1f frames/s, %.1f%% of the shapes formatted again\n",
+        report.frames, report.seconds,
+        (report.seconds > 0) ? report.frames / report.seconds : 0.0,
+        (report.shapes > 0) ? 100.0 * report.reformatted / report.shapes : 0.0);
+    return status;
+}
+
+// Opens the cache of renders in the cache directory, bounded to `mb` megabytes.
+// Returns 0 on success and -1 on failure.
+static int8_t open_render_cache(Cache* cache, unsigned long mb) {
+    const char* dir = script_cache_dir();
+    char path[PATH_MAX];
+    if (dir == NULL) {
+        fprintf(stderr, "no cache directory, set $WOOTKAS_CACHE\n");
+        return -1;
+    }
+    const int n = snprintf(path, sizeof(path), "%s/" RENDER_CACHE_DIR, dir);
+    if (n <= 0 || n >= (int)sizeof(path)) return -1;
+    return cache_open(cache, path, (uint64_t)mb << 20);
+}
+
+// Prints how often the renders of this run, and of every run sharing the cache, were found in it.
+static void report_cache(Cache* cache) {
+    CacheCounters own, all;
+    cache_counters(cache, &own, &all);
+    fprintf(stderr, "cache: %llu hits, %llu misses, %llu evicted; %llu hits and %llu misses over every run\n",
+        (unsigned long long)own.hits, (unsigned long long)own.misses, (unsigned long long)own.evictions,
+        (unsigned long long)all.hits, (unsigned long long)all.misses);
+}
+
+// Renders a wallpaper into params.path now and then every `interval` seconds,
+// until one of `signals` (blocked by the caller in every thread) arrives.
+// Tick k renders with the k-th seed drawn from params.seed, so a run can be replayed.
+// The preset stays compiled and its memory is reused, so nothing is allocated between ticks.
+static int8_t run_daemon(const BatchPreset* preset, Cache* cache, RenderParams params, uint32_t interval, const sigset_t* signals) {
+    const int timer = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    const int stop = signalfd(-1, signals, SFD_CLOEXEC);
+    const struct itimerspec every = {{interval, 0}, {interval, 0}};
+    if (timer == -1 || stop == -1 || timerfd_settime(timer, 0, &every, NULL) != 0) {
+        fprintf(stderr, "failed to set up the daemon timer: %s\n", strerror(errno));
+        if (timer != -1) close(timer);
+        if (stop != -1) close(stop);
+        return -1;
+    }
+
+    Rng ticks;
+    rng_seed(&ticks, params.seed);
+    struct pollfd fds[2] = {{timer, POLLIN, 0}, {stop, POLLIN, 0}};
+    int8_t status = 0;
+    for (;;) {
+        params.seed = rng_next(&ticks);
+        if (preset_render_cached(cache, preset->render, preset->content, &params) == 0) {
+            fprintf(stderr, "seed: %llu\n", (unsigned long long)params.seed);
+        } else {
+            fprintf(stderr, "failed to render the wallpaper with seed %llu\n", (unsigned long long)params.seed);
+        }
+
+        // sleeps in poll(2) until the next tick, so an idle daemon uses no CPU.
+        if (poll(fds, 2, -1) == -1) {
+            if (errno == EINTR) continue;
+            status = -1;
+            break;
+        }
+        if (fds[1].revents != 0) break;
+        uint64_t expirations; // ticks missed while rendering collapse into one.
+        if (read(timer, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+            status = -1;
+            break;
+        }
+    }
+    close(timer);
+    close(stop);
+    return status;
+}
+
+int main(int argc, char** argv) {
+    static const struct option options[] = {
+        {"seed", required_argument, NULL, 's'},
+        {"threads", required_argument, NULL, 'j'},
+        {"density", required_argument, NULL, 'd'},
+        {"batch", no_argument, NULL, 'b'},
+        {"presets", required_argument, NULL, 'p'},
+        {"themes", required_argument, NULL, 't'},
+        {"sizes", required_argument, NULL, 'z'},
+        {"seeds", required_argument, NULL, 'S'},
+        {"out", required_argument, NULL, 'o'},
+        {"daemon", no_argument, NULL, 'D'},
+        {"interval", required_argument, NULL, 'i'},
+        {"stats", no_argument, NULL, OPT_STATS},
+        {"assets", required_argument, NULL, OPT_ASSETS},
+        {"script", required_argument, NULL, OPT_SCRIPT},
+        {"animate", required_argument, NULL, OPT_ANIMATE},
+        {"fps", required_argument, NULL, OPT_FPS},
+        {"cache", no_argument, NULL, OPT_CACHE},
+        {"cache-size", required_argument, NULL, OPT_CACHE_SIZE},
+        {"compact", no_argument, NULL, OPT_COMPACT},
+        {"serve", required_argument, NULL, OPT_SERVE},
+        {"accent", required_argument, NULL, OPT_ACCENT},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+    // without --seed every run is different; the seed is printed so a run can be reproduced.
+    uint64_t seed = (uint64_t)time(NULL) ^ ((uint64_t)getpid() << 32);
+    int seeded = 0;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned long density = 0;
+    int batching = 0;
+    Batch batch = {0};
+    const char* out = NULL;
+    int daemonize = 0;
+    unsigned long interval = DAEMON_INTERVAL;
+    const char* script = NULL;
+    Animation animation = {0, ANIMATION_FPS};
+    int caching = 0;
+    unsigned long cache_mb = RENDER_CACHE_MB;
+    int8_t compact = 0;
+    int serving = 0;
+    unsigned long port = 0;
+    Rgba accents[PALETTE_MAX_ACCENTS];
+    uint8_t accent_count = 0;
+    // preset names are looked up once --assets is known, after every option is read.
+    StrBuilder preset_names = str_builder_new(64);
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "s:j:d:bp:t:z:S:o:Di:h", options, NULL)) != -1) {
+        switch (opt) {
+            case 's': {
+                char* end;
+                seed = strtoull(optarg, &end, 0);
+                if (*optarg == '\0' || *end != '\0') {
+                    fprintf(stderr, "invalid seed: %s\n", optarg);
+                    return 1;
+                }
+                seeded = 1;
+                break;
+            }
+            case 'j': {
+                char* end;
+                threads = strtol(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0' || threads < 1 || threads > UINT16_MAX) {
+                    fprintf(stderr, "invalid thread count: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            }
+            case 'd': {
+                char* end;
+                density = strtoul(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0' || density > UINT32_MAX) {
+                    fprintf(stderr, "invalid density: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            }
+            case 'b':
+                batching = 1;
+                break;
+            case 'o':
+                out = optarg;
+                break;
+            case 'i': {
+                char* end;
+                interval = strtoul(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0' || interval == 0 || interval > UINT32_MAX) {
+                    fprintf(stderr, "invalid interval: %s\n", optarg);
+                    return 1;
+                }
+                daemonize = 1;
+                break;
+            }
+            case 'D':
+                daemonize = 1;
+                break;
+            case 'p':
+                if ((preset_names.length != 0 && str_builder_append(&preset_names, STR_LIT(",")) != 0) ||
+                    str_builder_append_cstr(&preset_names, optarg) != 0) {
+                    str_builder_free(&preset_names);
+                    batch_free(&batch);
+                    return 1;
+                }
+                batching = 1;
+                break;
+            case 't':
+            case 'z':
+            case 'S': {
+                const int8_t status =
+                    (opt == 't') ? batch_add_themes(&batch, optarg) :
+                    (opt == 'z') ? batch_add_sizes(&batch, optarg) :
+                    batch_add_seeds(&batch, optarg);
+                if (status != 0) {
+                    str_builder_free(&preset_names);
+                    batch_free(&batch);
+                    return 1;
+                }
+                batching = 1;
+                break;
+            }
+            case OPT_STATS:
+                stats_enable();
+                break;
+            case OPT_ASSETS:
+                preset_dir = optarg;
+                break;
+            case OPT_SCRIPT:
+                script = optarg;
+                break;
+            case OPT_ANIMATE:
+            case OPT_FPS: {
+                char* end;
+                const unsigned long n = strtoul(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0' || n == 0 || n > ((opt == OPT_FPS) ? UINT16_MAX : UINT32_MAX)) {
+                    fprintf(stderr, "invalid %s: %s\n", (opt == OPT_FPS) ? "frame rate" : "frame count", optarg);
+                    return 1;
+                }
+                if (opt == OPT_FPS) animation.fps = (uint16_t)n;
+                else animation.frames = (uint32_t)n;
+                break;
+            }
+            case OPT_CACHE:
+                caching = 1;
+                break;
+            case OPT_CACHE_SIZE: {
+                char* end;
+                cache_mb = strtoul(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0' || cache_mb == 0 || cache_mb > UINT32_MAX) {
+                    fprintf(stderr, "invalid cache size: %s\n", optarg);
+                    return 1;
+                }
+                caching = 1;
+                break;
+            }
+            case OPT_COMPACT:
+                compact = 1;
+                break;
+            case OPT_SERVE: {
+                char* end;
+                port = strtoul(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0' || port > UINT16_MAX) {
+                    fprintf(stderr, "invalid port: %s\n", optarg);
+                    return 1;
+                }
+                serving = 1;
+                break;
+            }
+            case OPT_ACCENT:
+                if (palette_parse_accents((StrView){optarg, strlen(optarg)}, accents, &accent_count) != 0) {
+                    fprintf(stderr, "invalid accents: %s, at most %d colours that are not grey\n", optarg, PALETTE_MAX_ACCENTS);
+                    str_builder_free(&preset_names);
+                    batch_free(&batch);
+                    return 1;
+                }
+                break;
+            case 'h':
+                usage(argv[0]);
+                str_builder_free(&preset_names);
+                batch_free(&batch);
+                return 0;
+            default:
+                usage(argv[0]);
+                str_builder_free(&preset_names);
+                batch_free(&batch);
+                return 1;
+        }
+    }
+    const char* error = NULL;
+    if (batching && daemonize) error = "--daemon cannot be combined with a batch";
+    // the jobs of a batch run concurrently, their documents would interleave.
+    if (batching && out != NULL && strcmp(out, "-") == 0) error = "a batch cannot be streamed to stdout";
+    if (batching && script != NULL) error = "--script cannot be combined with a batch, name the script with --presets";
+    if (animation.frames != 0 && (batching || daemonize || script != NULL)) error = "--animate cannot be combined with a batch, --daemon or --script";
+    if (animation.frames != 0 && caching) error = "animations are not cached, --animate cannot be combined with --cache";
+    if (serving && (batching || daemonize || animation.frames != 0 || out != NULL || script != NULL)) {
+        error = "--serve cannot be combined with a batch, --daemon, --animate, --out or --script";
+    }
+    BatchPreset* registry = NULL;
+    uint16_t registry_count = 0;
+    if (error == NULL && (preset_names.length != 0 || serving)) {
+        if (load_registry((preset_dir != NULL) ? preset_dir : SCRIPT_DIR, &registry, &registry_count) != 0) {
+            error = "failed to list the preset scripts";
+        } else if (preset_names.length != 0 && batch_add_presets(&batch, preset_names.str, registry, registry_count) != 0) {
+            error = "";
+        }
+    }
+    // the scripts are compiled before the first request instead of by it.
+    for (uint16_t i = 0; error == NULL && serving && i < registry_count; i++) {
+        if (registry[i].script != NULL && scripted_load(registry[i].script) != 0) {
+            fprintf(stderr, "failed to compile %s, it is compiled again when requested\n", registry[i].script);
+        }
+    }
+    str_builder_free(&preset_names);
+    if (error != NULL) {
+        if (error[0] != '\0') fprintf(stderr, "%s\n", error);
+        free_registry(registry, registry_count);
+        batch_free(&batch);
+        return 1;
+    }
+    if (!seeded && batch.seed_count == 0 && !daemonize && !serving) fprintf(stderr, "seed: %llu\n", (unsigned long long)seed);
+
+    // a cache that cannot be opened only costs the renders it would have saved.
+    Cache render_cache;
+    Cache* cache = NULL;
+    if (caching) {
+        if (open_render_cache(&render_cache, cache_mb) == 0) cache = &render_cache;
+        else fprintf(stderr, "failed to open the cache, rendering without it\n");
+    }
+    batch.cache = cache;
+    batch.compact = compact;
+    batch.accents = accents;
+    batch.accent_count = accent_count;
+
+    // the daemon and the server stop on these, through a signalfd; they are blocked before
+    // the pool starts so that its threads inherit the mask and never take them.
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    if (daemonize || serving) sigprocmask(SIG_BLOCK, &signals, NULL);
+
+    // a single thread renders on the caller, no pool needed.
+    Pool pool;
+    Pool* workers = NULL;
+    if (threads > 1 && pool_init(&pool, (uint16_t)threads) == 0) workers = &pool;
+
+    int8_t status;
+    const RenderParams params = {1600, 900, Lumos, seed, (uint32_t)density, workers, out, script, compact, 0, accents, accent_count};
+    const BatchPreset script_preset = {"script", scripted, script, NULL, scripted_content};
+    const BatchPreset* preset = (script != NULL) ? &script_preset : &PRESETS[0];
+    if (batching) {
+        status = run_batch(&batch, out, seed, (uint32_t)density, workers);
+    } else if (animation.frames != 0) {
+        status = run_animation(&params, &animation);
+    } else if (serving) {
+        const ServeOptions serve_options = {(uint16_t)port, registry, registry_count, workers, cache, seed, accents, accent_count};
+        status = serve(&serve_options, &signals);
+    } else if (daemonize) {
+        status = run_daemon(preset, cache, params, (uint32_t)interval, &signals);
+    } else {
+        status = preset_render_cached(cache, preset->render, preset->content, &params);
+    }
+
+    if (workers != NULL) pool_destroy(workers);
+    batch_free(&batch);
+    free_registry(registry, registry_count);
+    if (cache != NULL) {
+        report_cache(cache);
+        cache_close(cache);
+    }
+
+    if (stats_enabled) {
+        StrBuilder report = str_builder_new(1024);
+        if (stats_append_json(&report) == 0) fputs(report.str, stderr);
+        str_builder_free(&report);
+    }
+    return (status == 0) ? 0 : 1;
+}
@@ -0,0 +1,197 @@
+#include <ctype.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "../include/presets.h"
+#include "../include/raster.h"
+#include "../include/stats.h"
+#include "../include/strings.h"
+#include "../include/utils.h"
+
+typedef enum {OUTPUT_SVG, OUTPUT_SVGZ, OUTPUT_PNG, OUTPUT_PPM} OutputFormat;
+
+const char* preset_dir = NULL;
+
+// shapes and pixels of the last bitmap of this thread, reused by the next one.
+static _Thread_local Raster raster;
+
+// frees the raster of a thread when it exits.
+static pthread_key_t thread_state;
+static pthread_once_t thread_state_once = PTHREAD_ONCE_INIT;
+
+static void release_thread_state(void* unused) {
+    (void)unused;
+    raster_free(&raster);
+}
+
+static void create_thread_state(void) {
+    pthread_key_create(&thread_state, release_thread_state);
+}
+
+static int8_t has_extension(const char* path, const char* ext) {
+    const size_t length = strlen(path), n = strlen(ext);
+    if (length < n) return 0;
+    for (size_t i = 0; i < n; i++) {
+        if (tolower((unsigned char)path[length - n + i]) != ext[i]) return 0;
+    }
+    return 1;
+}
+
+static OutputFormat output_format(const char* path) {
+    if (has_extension(path, ".png")) return OUTPUT_PNG;
+    if (has_extension(path, ".ppm")) return OUTPUT_PPM;
+    if (has_extension(path, ".svgz")) return OUTPUT_SVGZ;
+    return OUTPUT_SVG;
+}
+
+static const char* output_path(const RenderParams* params) {
+    return (params->path != NULL) ? params->path : "out.svg";
+}
+
+static const char* const OUTPUT_EXTS[] = {
+    [OUTPUT_SVG] = ".svg", [OUTPUT_SVGZ] = ".svgz", [OUTPUT_PNG] = ".png", [OUTPUT_PPM] = ".ppm"
+};
+
+const char* preset_output_ext(const RenderParams* params) {
+    return OUTPUT_EXTS[output_format(output_path(params))];
+}
+
+// Rasterizes the whole document in the chain of sink, with the shapes it splices, and replaces path with the bitmap.
+static int8_t output_bitmap(const RenderParams* params, const char* path, const PresetSink* sink, OutputFormat format) {
+    const StrChain* svg = &sink->chain;
+    pthread_once(&thread_state_once, create_thread_state);
+    pthread_setspecific(thread_state, &raster);
+    // the parser needs the document in one piece.
+    StrBuilder document = str_builder_new(svg->length);
+    if (str_chain_join(svg, &document) != 0 ||
+        raster_parse_svg_spliced(&raster, str_builder_view(&document), sink->splice_at, sink->splice, sink->splice_arg) != 0 ||
+        raster_render(&raster, params->pool) != 0) {
+        DEBUG_PRINT("Err: preset_sink_close(): failed to rasterize %s\n", path);
+        str_builder_free(&document);
+        return -1;
+    }
+    str_builder_free(&document);
+
+    // allocated like the SVG itself, from the arena of the render when there is one.
+    StrBuilder image = str_builder_new((uint64_t)raster.width * raster.height * ((format == OUTPUT_PNG) ? 4 : 3) + 1024);
+    int8_t status = (format == OUTPUT_PNG) ? raster_write_png(&raster, &image) : raster_write_ppm(&raster, &image);
+    if (status == 0) {
+        status = (params->fd != 0) ? write_all(params->fd, str_builder_view(&image)) : write_to_file_atomic(path, str_builder_view(&image));
+    }
+    str_builder_free(&image);
+    return status;
+}
+
+// Opens the output of params for streaming into sink->fd: params->fd and "-", stdout, are
+// used as they are, regular files are replaced atomically and other ones are written in place.
+static int8_t open_stream(PresetSink* sink, const RenderParams* params) {
+    const char* path = output_path(params);
+    if (params->fd != 0 || strcmp(path, "-") == 0) {
+        sink->fd = (params->fd != 0) ? params->fd : STDOUT_FILENO;
+        return 0;
+    }
+    // pipes, sockets and devices cannot be renamed over, they are written as they are.
+    struct stat st;
+    if (stat(path, &st) == 0 && !S_ISREG(st.st_mode)) {
+        sink->fd = open(path, O_WRONLY);
+    } else if (atomic_file_open(&sink->file, path) == 0) {
+        sink->fd = sink->file.fd;
+        sink->replacing = 1;
+    }
+    return (sink->fd != -1) ? 0 : -1;
+}
+
+// Ends what open_stream() started; a replaced file is only replaced if status is 0.
+static int8_t close_stream(PresetSink* sink, const RenderParams* params, int8_t status) {
+    if (sink->replacing) return atomic_file_commit(&sink->file, output_path(params), status);
+    if (params->fd == 0 && sink->fd != STDOUT_FILENO && close(sink->fd) != 0) status = -1;
+    return status;
+}
+
+int8_t preset_sink_open(PresetSink* sink, const RenderParams* params) {
+    const char* path = output_path(params);
+    *sink = (PresetSink){.chain = str_chain_new(256), .fd = -1};
+    sink->file.fd = -1;
+
+    const OutputFormat format = output_format(path);
+    if (format != OUTPUT_SVG && format != OUTPUT_SVGZ) return 0;
+    if (format == OUTPUT_SVGZ) {
+        sink->gzipped = 1;
+        sink->packed = str_builder_new(64 * 1024);
+        if (gzip_begin(&sink->gzip, &sink->packed) != 0) {
+            str_builder_free(&sink->packed);
+            str_chain_free(&sink->chain);
+            return -1;
+        }
+    }
+    if (open_stream(sink, params) != 0) {
+        DEBUG_PRINT("Err: preset_sink_open(): failed to open %s\n", path);
+        if (sink->gzipped) {
+            gzip_free(&sink->gzip);
+            str_builder_free(&sink->packed);
+        }
+        str_chain_free(&sink->chain);
+        return -1;
+    }
+    return 0;
+}
+
+// Compresses the parts of an ended chain and writes out what the encoder has packed so far.
+static int8_t write_gzipped(PresetSink* sink) {
+    for (uint32_t i = 0; i < sink->chain.count; i++) {
+        const StrView part = str_chain_part(&sink->chain, i);
+        if (gzip_write(&sink->gzip, (const uint8_t*)part.str, part.length) != 0) return -1;
+    }
+    // the encoder holds input back until it fills a block, small flushes may have nothing to write.
+    if (sink->packed.length != 0 && write_all(sink->fd, str_builder_view(&sink->packed)) != 0) return -1;
+    sink->packed.length = 0;
+    return 0;
+}
+
+void preset_sink_splice(PresetSink* sink, RasterSplice splice, void* arg) {
+    sink->splice = splice;
+    sink->splice_arg = arg;
+    // the parts so far, and the text appended since the last one.
+    sink->splice_at = sink->chain.length + sink->chain.text.length - sink->chain.flushed;
+}
+
+int8_t preset_sink_flush(PresetSink* sink) {
+    if (!preset_sink_streams(sink)) return 0;
+    STATS_SCOPE(STAT_WRITE);
+    if (str_chain_end(&sink->chain) != 0) return -1;
+    if ((sink->gzipped ? write_gzipped(sink) : write_chain(sink->fd, &sink->chain)) != 0) return -1;
+    str_chain_clear(&sink->chain);
+    return 0;
+}
+
+int8_t preset_sink_close(PresetSink* sink, const RenderParams* params, int8_t status) {
+    const char* path = output_path(params);
+    if (status == 0) status = preset_sink_flush(sink);
+    if (sink->gzipped) {
+        if (status == 0 && (gzip_end(&sink->gzip) != 0 || write_all(sink->fd, str_builder_view(&sink->packed)) != 0)) status = -1;
+        gzip_free(&sink->gzip);
+        str_builder_free(&sink->packed);
+    }
+
+    if (preset_sink_streams(sink)) {
+        status = close_stream(sink, params, status);
+    } else if (status == 0) {
+        STATS_SCOPE(STAT_WRITE);
+        status = output_bitmap(params, path, sink, output_format(path));
+    }
+    if (status != 0) DEBUG_PRINT("Err: preset_sink_close(): failed to write %s\n", path);
+    str_chain_free(&sink->chain);
+    return status;
+}
+
+int8_t preset_sink_copy(const RenderParams* params, int fd) {
+    STATS_SCOPE(STAT_WRITE);
+    const char* path = output_path(params);
+    PresetSink sink = {.fd = -1};
+    int8_t status = -1;
+    if (open_stream(&sink, params) == 0) status = close_stream(&sink, params, write_from_fd(sink.fd, fd));
+    if (status != 0) DEBUG_PRINT("Err: preset_sink_copy(): failed to write %s\n", path);
+    return status;
+}
@@ -1,16 +1,144 @@
+#include <stdio.h>
+#include <limits.h>
+#include <pthread.h>
+#include "../include/arena.h"
+#include "../include/fmt.h"
+#include "../include/placement.h"
+#include "../include/presets.h"
+#include "../include/rng.h"
+#include "../include/stats.h"
 #include "../include/strings.h"
+#include "../include/template.h"
 #include "../include/utils.h"
 
-void sample() {
-    String file = str_from(NULL);
-    read_file_content("assets/sample.preset", &file);
+// placeholders of sample.preset. The copy in assets/ is built in by tools/presetgen.c;
+// a custom one in preset_dir is compiled once at runtime and reused until it changes.
+#define PRESET_FILE "sample.preset"
+enum {SLOT_COLOR, SLOT_RADIUS, SLOT_GREETING, SLOT_X, SLOT_Y};
+static const StrView PRESET_KEYS[] = {STR_LIT("$color"), STR_LIT("$radius"), STR_LIT("$greeting"), STR_LIT("$x"), STR_LIT("$y")};
+static Template preset;
+static char preset_path[PATH_MAX];
+static pthread_once_t preset_path_once = PTHREAD_ONCE_INIT;
+// taken for writing only while the preset is reloaded, renders hold it for reading.
+static pthread_rwlock_t preset_lock = PTHREAD_RWLOCK_INITIALIZER;
+// every allocation of a render comes from here and is dropped at once when it ends.
+static _Thread_local Arena arena;
+// centers of the circles, kept between renders.
+static _Thread_local Placement placement;
 
-    size_t pos = 0;
+// size of sample.preset, circles are kept this far from its edges.
+#define CANVAS_WIDTH 1920
+#define CANVAS_HEIGHT 1080
+#define MAX_RADIUS 80
+// minimum distance between two centers, in canvas units (see placement_spacing()).
+#define SPACING 14
 
-    for (pos = 0; pos != -1; pos = str_replace_next(&file, pos, str_from("$color"), str_compose("hsl(%f,%d\%,%d\%)", rand_range(0, 360), (int)rand_range(15, 50), (int)rand_range(68, 86))));
-    for (pos = 0; pos != -1; pos = str_replace_next(&file, pos, str_from("$radius"), str_compose("%d", (int)rand_range(35, 80))));
-    for (pos = 0; pos != -1; pos = str_replace_next(&file, pos, str_from("$greeting"), get_quote()));
+typedef struct SampleCtx {
+    Rng rng;
+    Point center;    // of the circle being filled, placed by whichever of its $x and $y comes first.
+    uint8_t written; // coordinates of center written so far, SLOT_X and SLOT_Y bits.
+} SampleCtx;
 
-    write_to_file("out.svg", file);
-    str_free(&file);
+// frees the arena of a thread when it exits.
+static pthread_key_t thread_state;
+static pthread_once_t thread_state_once = PTHREAD_ONCE_INIT;
+
+static void release_thread_state(void* unused) {
+    (void)unused;
+    arena_free(&arena);
+    placement_free(&placement);
+}
+
+static void create_thread_state(void) {
+    pthread_key_create(&thread_state, release_thread_state);
+}
+
+static int8_t fill_slot(StrBuilder* out, uint16_t slot, void* ctx) {
+    SampleCtx* sc = ctx;
+    Rng* rng = &sc->rng;
+    switch (slot) {
+        case SLOT_COLOR: {
+            // drawn one by one, argument evaluation order is unspecified.
+            const float hue = rand_range(rng, 0, 360);
+            const int saturation = (int)rand_range(rng, 15, 50);
+            const int lightness = (int)rand_range(rng, 68, 86);
+            return str_builder_append_fmt(out, "hsl(%f,%d%%,%d%%)", hue, saturation, lightness);
+        }
+        case SLOT_RADIUS:
+            return str_builder_append_fmt(out, "%d", (int)rand_range(rng, 35, 80));
+        case SLOT_GREETING:
+            return str_builder_append(out, get_quote(rng));
+        case SLOT_X:
+        case SLOT_Y: {
+            // a coordinate written again belongs to the next circle.
+            const uint8_t bit = 1 << (slot - SLOT_X);
+            if (sc->written == 0 || (sc->written & bit)) {
+                sc->center = placement_next(&placement);
+                sc->written = 0;
+            }
+            sc->written |= bit;
+            return str_builder_append_fixed(out, (slot == SLOT_X) ? sc->center.x : sc->center.y, 2);
+        }
+    }
+    return -1;
+}
+
+// render_builtin(), calling fill_slot() for each placeholder of the built-in preset.
+#include "gen/sample.preset.h"
+
+static void build_preset_path(void) {
+    snprintf(preset_path, sizeof(preset_path), "%s/" PRESET_FILE, preset_dir);
+}
+
+// The render only depends on params and the preset, custom or built in.
+int8_t sample_content(const RenderParams* params, uint64_t* hash) {
+    (void)params;
+    if (preset_dir == NULL) return preset_content_hash("sample", NULL, BUILTIN_PRESET_HASH, hash);
+    pthread_once(&preset_path_once, build_preset_path);
+    return preset_content_hash("sample", preset_path, BUILTIN_PRESET_HASH, hash);
+}
+
+// Renders the sample preset. Only the seed and path of params are used.
+int8_t sample(const RenderParams* params) {
+    STATS_SCOPE(STAT_RENDER);
+    SampleCtx ctx = {0};
+    rng_seed(&ctx.rng, params->seed);
+
+    // the centers draw from their own stream, the other slots keep drawing from ctx.rng.
+    Rng placement_rng;
+    rng_stream(&ctx.rng, 0, &placement_rng);
+    const Point begin = {MAX_RADIUS, MAX_RADIUS}, end = {CANVAS_WIDTH - MAX_RADIUS, CANVAS_HEIGHT - MAX_RADIUS};
+    if (placement_begin(&placement, &placement_rng, begin, end, placement_spacing(CANVAS_WIDTH, CANVAS_HEIGHT, SPACING), 0) != 0) {
+        return -1;
+    }
+
+    // a custom preset is held for reading until the document is written.
+    const int8_t custom = preset_dir != NULL;
+    if (custom) {
+        pthread_once(&preset_path_once, build_preset_path);
+        if (template_acquire(&preset, &preset_lock, preset_path, PRESET_KEYS, sizeof(PRESET_KEYS) / sizeof(PRESET_KEYS[0])) != 0) {
+            DEBUG_PRINT("Err: sample(): error while accessing file\n");
+            return -1;
+        }
+    }
+
+    pthread_once(&thread_state_once, create_thread_state);
+    pthread_setspecific(thread_state, &arena);
+
+    int8_t status = -1;
+    Arena* previous = str_use_arena(&arena);
+    PresetSink sink;
+    if (preset_sink_open(&sink, params) == 0) {
+        int8_t spliced;
+        {
+            STATS_SCOPE(STAT_SPLICE);
+            spliced = custom ? template_render_chain(&preset, &sink.chain, fill_slot, &ctx) : render_builtin(&sink.chain, &ctx);
+        }
+        if (spliced != 0) DEBUG_PRINT("Err: sample(): failed to render the preset\n");
+        status = preset_sink_close(&sink, params, spliced);
+    }
+    if (custom) pthread_rwlock_unlock(&preset_lock);
+    str_use_arena(previous);
+    arena_reset(&arena);
+    return status;
 }
@@ -0,0 +1,158 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "../include/arena.h"
+#include "../include/presets.h"
+#include "../include/script.h"
+#include "../include/stats.h"
+#include "../include/strings.h"
+#include "../include/utils.h"
+
+// A script compiled for the process, reloaded when its file changes.
+typedef struct LoadedScript {
+    char* filename;
+    Script script;
+    struct timespec mtime;
+    uint64_t size;
+    struct LoadedScript* next;
+} LoadedScript;
+
+// scripts loaded so far; they stay loaded until the process exits.
+static LoadedScript* scripts;
+// taken for writing only while a script is loaded, renders hold it for reading.
+static pthread_rwlock_t scripts_lock = PTHREAD_RWLOCK_INITIALIZER;
+// every allocation of a render comes from here and is dropped at once when it ends.
+static _Thread_local Arena arena;
+
+// frees the arena of a thread when it exits.
+static pthread_key_t thread_state;
+static pthread_once_t thread_state_once = PTHREAD_ONCE_INIT;
+
+static void release_thread_state(void* unused) {
+    (void)unused;
+    arena_free(&arena);
+}
+
+static void create_thread_state(void) {
+    pthread_key_create(&thread_state, release_thread_state);
+}
+
+static LoadedScript* find_script(const char* filename) {
+    for (LoadedScript* s = scripts; s != NULL; s = s->next) {
+        if (strcmp(s->filename, filename) == 0) return s;
+    }
+    return NULL;
+}
+
+static int8_t script_fresh(const LoadedScript* s, const struct stat* st) {
+    return s != NULL && st->st_mtim.tv_sec == s->mtime.tv_sec && st->st_mtim.tv_nsec == s->mtime.tv_nsec && (uint64_t)st->st_size == s->size;
+}
+
+// Loads filename, or reloads it if it changed since. Called with scripts_lock held for writing.
+// A failed reload keeps the previous version usable.
+static int8_t refresh_script(const char* filename) {
+    STATS_SCOPE(STAT_LOAD);
+    struct stat st;
+    if (stat(filename, &st) != 0) {
+        DEBUG_PRINT("err! scripted(): failed to stat %s.\n", filename);
+        return -1;
+    }
+    LoadedScript* s = find_script(filename);
+    if (script_fresh(s, &st)) return 0;
+
+    Script fresh;
+    if (script_load(&fresh, filename, script_cache_dir()) != 0) return -1;
+    if (s == NULL) {
+        s = (LoadedScript*)calloc(1, sizeof(LoadedScript));
+        char* name = strdup(filename);
+        if (s == NULL || name == NULL) {
+            DEBUG_PRINT("err! scripted(): failed to allocate memory for %s.\n", filename);
+            free(s);
+            free(name);
+            script_free(&fresh);
+            return -1;
+        }
+        s->filename = name;
+        s->next = scripts;
+        scripts = s;
+    }
+    script_free(&s->script);
+    s->script = fresh;
+    s->mtime = st.st_mtim;
+    s->size = st.st_size;
+    return 0;
+}
+
+// Returns the compiled script of filename, with scripts_lock held for reading; NULL on failure.
+static const Script* acquire_script(const char* filename) {
+    struct stat st;
+    pthread_rwlock_rdlock(&scripts_lock);
+    const LoadedScript* s = find_script(filename);
+    if (stat(filename, &st) == 0 && script_fresh(s, &st)) return &s->script;
+    pthread_rwlock_unlock(&scripts_lock);
+
+    // another thread may have loaded it meanwhile, refresh_script() checks again.
+    pthread_rwlock_wrlock(&scripts_lock);
+    const int8_t loaded = refresh_script(filename);
+    pthread_rwlock_unlock(&scripts_lock);
+    if (loaded != 0) return NULL;
+    pthread_rwlock_rdlock(&scripts_lock);
+    return &find_script(filename)->script;
+}
+
+int8_t scripted_load(const char* filename) {
+    pthread_rwlock_wrlock(&scripts_lock);
+    const int8_t loaded = refresh_script(filename);
+    pthread_rwlock_unlock(&scripts_lock);
+    return loaded;
+}
+
+// hands the document generated so far to the sink between repetitions.
+static int8_t flush_sink(void* ctx) {
+    return preset_sink_flush(ctx);
+}
+
+// The script is hashed as it is on disk, whatever version of it is loaded.
+int8_t scripted_content(const RenderParams* params, uint64_t* hash) {
+    if (params->script == NULL) return -1;
+    return preset_content_hash("script", params->script, 0, hash);
+}
+
+// Renders the script at params->script.
+int8_t scripted(const RenderParams* params) {
+    STATS_SCOPE(STAT_RENDER);
+    if (params->script == NULL) {
+        DEBUG_PRINT("Err: scripted(): no script to render\n");
+        return -1;
+    }
+    const Script* script = acquire_script(params->script);
+    if (script == NULL) {
+        DEBUG_PRINT("Err: scripted(): failed to load %s\n", params->script);
+        return -1;
+    }
+
+    pthread_once(&thread_state_once, create_thread_state);
+    pthread_setspecific(thread_state, &arena);
+
+    int8_t status = -1;
+    Arena* previous = str_use_arena(&arena);
+    PresetSink sink;
+    if (preset_sink_open(&sink, params) == 0) {
+        ScriptEnv env = {params->width, params->height, params->theme == Noir, params->density, {{0}}, flush_sink, &sink};
+        rng_seed(&env.rng, params->seed);
+        int8_t spliced;
+        {
+            STATS_SCOPE(STAT_SPLICE);
+            spliced = script_run(script, &env, &sink.chain.text);
+            if (spliced == 0) spliced = str_chain_end(&sink.chain);
+        }
+        if (spliced != 0) DEBUG_PRINT("Err: scripted(): failed to run %s\n", params->script);
+        status = preset_sink_close(&sink, params, spliced);
+    }
+    pthread_rwlock_unlock(&scripts_lock);
+    str_use_arena(previous);
+    arena_reset(&arena);
+    return status;
+}
@@ -0,0 +1,650 @@
+#define _GNU_SOURCE // memfd_create(2)
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include "../include/cache.h"
+#include "../include/color.h"
+#include "../include/http.h"
+#include "../include/pool.h"
+#include "../include/rng.h"
+#include "../include/serve.h"
+#include "../include/stats.h"
+#include "../include/strings.h"
+#include "../include/utils.h"
+
+// connections beyond this are closed as soon as they are accepted.
+#define MAX_CONNECTIONS 256
+// longest request head; longer ones are answered with 431.
+#define REQUEST_MAX 8192
+// latencies the percentiles of /stats are taken over, the latest ones.
+#define LATENCY_SAMPLES 4096
+#define MAX_SIDE 8192
+#define MAX_DENSITY 100000
+#define EPOLL_EVENTS 64
+
+static const char HELP[] =
+    "GET /render   renders a wallpaper; every parameter is optional:\n"
+    "              preset=NAME theme=lumos|noir size=WIDTHxHEIGHT seed=N density=N compact=1 format=svg|svgz|png\n"
+    "              accent=RRGGBB,... not grey (the shapes take hues around theirs, '#' written %23 if at all)\n"
+    "GET /presets  the names of the presets, as a JSON array\n"
+    "GET /stats    requests, renders and the p50, p99 and worst latency of both, as JSON\n";
+
+typedef enum {READING, RENDERING, WRITING, CLOSED} ConnState;
+
+typedef struct Server Server;
+
+typedef struct Conn {
+    Server* server;
+    int fd;
+    int body;             // memfd renders are written into, reused by every request.
+    ConnState state;
+    uint32_t events;      // what epoll waits for; 0 while rendering.
+    char in[REQUEST_MAX]; // bytes received and not parsed yet.
+    uint32_t in_length;
+    StrBuilder out;       // head of the response, followed by the whole body when it is not rendered.
+    uint64_t out_sent;
+    off_t body_length;    // of the rendered body still to send after out, 0 when there is none.
+    off_t body_sent;
+    int8_t keep_alive;    // of the request being answered.
+    int8_t head_only;
+    int8_t peer_closed;   // the peer sent everything it will; pipelined requests are still answered.
+    int8_t hung_up;       // the peer went away while rendering; closed once the render ends.
+    uint64_t started;     // when the request being answered was read.
+    // the render in flight.
+    const BatchPreset* preset;
+    RenderParams params;
+    Rgba accents[PALETTE_MAX_ACCENTS]; // params.accents, when the request gives some.
+    int8_t render_status;
+    uint64_t render_ns;
+    struct Conn* prev;    // in the list of open connections.
+    struct Conn* next;
+    struct Conn* done;    // in the list of finished renders, then of closed connections.
+} Conn;
+
+// Latencies of the last LATENCY_SAMPLES requests, in microseconds.
+typedef struct Latency {
+    uint32_t samples[LATENCY_SAMPLES];
+    uint64_t count;
+    uint32_t max;
+} Latency;
+
+struct Server {
+    const ServeOptions* options;
+    int epoll;
+    int listener;       // -1 once closed.
+    int wakeup;         // eventfd written by every finished render.
+    int stop;           // signalfd of the signals stopping the server.
+    Rng seeds;
+    pthread_mutex_t lock;
+    Conn* done;         // renders finished and not answered yet, guarded by lock.
+    Conn* open;
+    Conn* graveyard;    // closed during an epoll batch, freed after it.
+    uint32_t connections;
+    uint64_t requests;
+    uint64_t renders;
+    uint64_t failed;
+    Latency render_latency;
+    Latency response_latency;
+};
+
+static void record_latency(Latency* l, uint64_t ns) {
+    const uint64_t us = ns / 1000;
+    const uint32_t sample = (us > UINT32_MAX) ? UINT32_MAX : (uint32_t)us;
+    l->samples[l->count++ % LATENCY_SAMPLES] = sample;
+    if (sample > l->max) l->max = sample;
+}
+
+static int compare_samples(const void* a, const void* b) {
+    const uint32_t x = *(const uint32_t*)a;
+    const uint32_t y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+// Appends the percentiles of l, nearest rank, as a JSON object in milliseconds.
+static int8_t append_latency(StrBuilder* out, const Latency* l) {
+    const uint32_t n = (l->count < LATENCY_SAMPLES) ? (uint32_t)l->count : LATENCY_SAMPLES;
+    double p50 = 0, p99 = 0;
+    if (n != 0) {
+        uint32_t* sorted = (uint32_t*)malloc(n * sizeof(uint32_t));
+        if (sorted == NULL) return -1;
+        memcpy(sorted, l->samples, n * sizeof(uint32_t));
+        qsort(sorted, n, sizeof(uint32_t), compare_samples);
+        p50 = sorted[(n * 50 + 99) / 100 - 1] / 1000.0;
+        p99 = sorted[(n * 99 + 99) / 100 - 1] / 1000.0;
+        free(sorted);
+    }
+    return str_builder_append_fmt(out, "{\"samples\": %llu, \"p50\": %.3f, \"p99\": %.3f, \"max\": %.3f}",
+        (unsigned long long)l->count, p50, p99, l->max / 1000.0);
+}
+
+// Appends s as a JSON string.
+static int8_t append_json_string(StrBuilder* out, const char* s) {
+    if (str_builder_append(out, STR_LIT("\"")) != 0) return -1;
+    for (; *s != '\0'; s++) {
+        int8_t status;
+        if (*s == '"' || *s == '\\') status = str_builder_append_fmt(out, "\\%c", *s);
+        else if ((unsigned char)*s < 0x20) status = str_builder_append_fmt(out, "\\u%04x", (unsigned char)*s);
+        else status = str_builder_append_n(out, s, 1);
+        if (status != 0) return -1;
+    }
+    return str_builder_append(out, STR_LIT("\""));
+}
+
+// Changes what epoll waits for on the connection.
+static void watch(Conn* c, uint32_t events) {
+    if (c->events == events) return;
+    struct epoll_event event = {.events = events, .data.ptr = c};
+    if (epoll_ctl(c->server->epoll, EPOLL_CTL_MOD, c->fd, &event) == 0) c->events = events;
+}
+
+static void close_conn(Server* s, Conn* c) {
+    if (c->prev != NULL) c->prev->next = c->next;
+    else s->open = c->next;
+    if (c->next != NULL) c->next->prev = c->prev;
+    s->connections--;
+    // closing the socket also removes it from the epoll set.
+    close(c->fd);
+    close(c->body);
+    str_builder_free(&c->out);
+    c->state = CLOSED;
+    // events of this batch may still refer to it.
+    c->done = s->graveyard;
+    s->graveyard = c;
+}
+
+// Queues a response whose body, if any, is in memory.
+static int8_t respond(Conn* c, uint16_t status, const char* content_type, StrView body, StrView extra) {
+    c->out.length = 0;
+    c->out_sent = 0;
+    c->body_length = c->body_sent = 0;
+    c->state = WRITING;
+    record_latency(&c->server->response_latency, stats_now() - c->started);
+    if (http_response_head(&c->out, status, content_type, body.length, c->keep_alive, extra) != 0) return -1;
+    return c->head_only ? 0 : str_builder_append(&c->out, body);
+}
+
+static int8_t respond_text(Conn* c, uint16_t status, const char* text) {
+    return respond(c, status, "text/plain; charset=utf-8", str_view_cstr(text), STR_LIT(""));
+}
+
+static int8_t respond_json(Conn* c, StrBuilder* json) {
+    const int8_t status = respond(c, 200, "application/json", str_builder_view(json), STR_LIT("Cache-Control: no-store\r\n"));
+    str_builder_free(json);
+    return status;
+}
+
+static int8_t respond_presets(Conn* c) {
+    const ServeOptions* o = c->server->options;
+    StrBuilder json = str_builder_new(256);
+    int8_t status = str_builder_append(&json, STR_LIT("["));
+    for (uint16_t i = 0; i < o->preset_count && status == 0; i++) {
+        if (i != 0) status = str_builder_append(&json, STR_LIT(", "));
+        if (status == 0) status = append_json_string(&json, o->presets[i].name);
+    }
+    if (status == 0) status = str_builder_append(&json, STR_LIT("]\n"));
+    if (status != 0) {
+        str_builder_free(&json);
+        return -1;
+    }
+    return respond_json(c, &json);
+}
+
+static int8_t respond_stats(Conn* c) {
+    const Server* s = c->server;
+    StrBuilder json = str_builder_new(512);
+    int8_t status = str_builder_append_fmt(&json, "{\"requests\": %llu, \"renders\": %llu, \"failed\": %llu, \"connections\": %u, \"render_ms\": ",
+        (unsigned long long)s->requests, (unsigned long long)s->renders, (unsigned long long)s->failed, s->connections);
+    if (status == 0) status = append_latency(&json, &s->render_latency);
+    if (status == 0) status = str_builder_append(&json, STR_LIT(", \"response_ms\": "));
+    if (status == 0) status = append_latency(&json, &s->response_latency);
+    if (status == 0 && s->options->cache != NULL) {
+        // the render tasks on the pool update them meanwhile.
+        CacheCounters own, all;
+        cache_counters(s->options->cache, &own, &all);
+        status = str_builder_append_fmt(&json, ", \"cache\": {\"hits\": %llu, \"misses\": %llu}",
+            (unsigned long long)own.hits, (unsigned long long)own.misses);
+    }
+    if (status == 0) status = str_builder_append(&json, STR_LIT("}\n"));
+    if (status != 0) {
+        str_builder_free(&json);
+        return -1;
+    }
+    return respond_json(c, &json);
+}
+
+// Runs on the pool: renders into the memfd of the connection, then hands it back to the server thread.
+static void render_task(void* arg) {
+    Conn* c = (Conn*)arg;
+    Server* s = c->server;
+    const uint64_t begin = stats_now();
+    c->render_status = preset_render_cached(s->options->cache, c->preset->render, c->preset->content, &c->params);
+    c->render_ns = stats_now() - begin;
+
+    pthread_mutex_lock(&s->lock);
+    c->done = s->done;
+    s->done = c;
+    pthread_mutex_unlock(&s->lock);
+    const uint64_t one = 1;
+    if (write(s->wakeup, &one, sizeof(one)) != sizeof(one)) DEBUG_PRINT("err! render_task(): failed to wake the server up.\n");
+}
+
+// Reads an unsigned number of at most max from value. Returns 0 on success and -1 on failure.
+static int8_t parse_number(const char* value, uint64_t max, uint64_t* n) {
+    char* end;
+    errno = 0;
+    *n = strtoull(value, &end, 0);
+    return (*value >= '0' && *value <= '9' && *end == '\0' && errno == 0 && *n <= max) ? 0 : -1;
+}
+
+// Fills the params of a render from the query string, or returns a reason to reject it.
+static const char* parse_render(Conn* c, StrView query) {
+    Server* s = c->server;
+    const ServeOptions* o = s->options;
+    RenderParams* params = &c->params;
+    *params = (RenderParams){1600, 900, Lumos, 0, 0, NULL, "preview.svg", NULL, 0, c->body, o->accents, o->accent_count};
+    c->preset = &o->presets[0];
+    char value[256];
+    uint64_t n;
+
+    int8_t found = http_query_param(query, "preset", value, sizeof(value));
+    if (found == 1) {
+        c->preset = NULL;
+        for (uint16_t i = 0; i < o->preset_count && c->preset == NULL; i++) {
+            if (strcmp(o->presets[i].name, value) == 0) c->preset = &o->presets[i];
+        }
+        if (c->preset == NULL) return "unknown preset, see /presets\n";
+    }
+    if (found == -1) return "malformed preset\n";
+    params->script = c->preset->script;
+
+    found = http_query_param(query, "theme", value, sizeof(value));
+    if (found == 1 && strcmp(value, "lumos") != 0 && strcmp(value, "noir") != 0) return "theme is lumos or noir\n";
+    if (found == -1) return "malformed theme\n";
+    if (found == 1) params->theme = (strcmp(value, "noir") == 0) ? Noir : Lumos;
+
+    found = http_query_param(query, "size", value, sizeof(value));
+    if (found == 1) {
+        char* x = strchr(value, 'x');
+        uint64_t width, height;
+        if (x == NULL) return "size is WIDTHxHEIGHT\n";
+        *x = '\0';
+        if (parse_number(value, MAX_SIDE, &width) != 0 || parse_number(x + 1, MAX_SIDE, &height) != 0 || width == 0 || height == 0) {
+            return "size is WIDTHxHEIGHT, at most 8192 a side\n";
+        }
+        params->width = (uint16_t)width;
+        params->height = (uint16_t)height;
+    }
+    if (found == -1) return "malformed size\n";
+
+    found = http_query_param(query, "seed", value, sizeof(value));
+    if (found == 1 && parse_number(value, UINT64_MAX, &params->seed) != 0) return "invalid seed\n";
+    if (found == -1) return "malformed seed\n";
+    // a seed drawn for the request is sent back in X-Seed, so the render can be asked for again.
+    if (found == 0) params->seed = rng_next(&s->seeds);
+
+    found = http_query_param(query, "density", value, sizeof(value));
+    if (found == 1 && parse_number(value, MAX_DENSITY, &n) != 0) return "density is at most 100000\n";
+    if (found == -1) return "malformed density\n";
+    if (found == 1) params->density = (uint32_t)n;
+
+    found = http_query_param(query, "compact", value, sizeof(value));
+    if (found == 1 && strcmp(value, "0") != 0 && strcmp(value, "1") != 0) return "compact is 0 or 1\n";
+    if (found == -1) return "malformed compact\n";
+    params->compact = found == 1 && value[0] == '1';
+
+    found = http_query_param(query, "accent", value, sizeof(value));
+    if (found == 1) {
+        if (palette_parse_accents((StrView){value, strlen(value)}, c->accents, &params->accent_count) != 0) {
+            return "accent is a list of at most 8 rrggbb colours that are not grey\n";
+        }
+        params->accents = c->accents;
+    }
+    if (found == -1) return "malformed accent\n";
+
+    found = http_query_param(query, "format", value, sizeof(value));
+    if (found == 1) {
+        if (strcmp(value, "svgz") == 0) params->path = "preview.svgz";
+        else if (strcmp(value, "png") == 0) params->path = "preview.png";
+        else if (strcmp(value, "svg") != 0) return "format is svg, svgz or png\n";
+    }
+    if (found == -1) return "malformed format\n";
+    return NULL;
+}
+
+// Starts rendering the wallpaper a /render request asks for.
+static int8_t start_render(Conn* c, StrView query) {
+    const char* rejected = parse_render(c, query);
+    if (rejected != NULL) return respond_text(c, 400, rejected);
+    // the memfd is emptied rather than created again for every render.
+    if (ftruncate(c->body, 0) != 0 || lseek(c->body, 0, SEEK_SET) != 0) return respond_text(c, 500, "failed to render\n");
+
+    c->state = RENDERING;
+    watch(c, 0);
+    Pool* pool = c->server->options->pool;
+    if (pool == NULL || pool_submit(pool, render_task, c) != 0) render_task(c);
+    return 0;
+}
+
+// Answers a finished render.
+static int8_t finish_render(Conn* c) {
+    Server* s = c->server;
+    s->renders++;
+    record_latency(&s->render_latency, c->render_ns);
+    struct stat st;
+    if (c->render_status != 0 || fstat(c->body, &st) != 0) {
+        s->failed++;
+        return respond_text(c, 500, "failed to render\n");
+    }
+
+    const char* ext = preset_output_ext(&c->params);
+    const int8_t png = strcmp(ext, ".png") == 0;
+    const int8_t gzipped = strcmp(ext, ".svgz") == 0;
+    char extra[256];
+    const int n = snprintf(extra, sizeof(extra), "X-Seed: %llu\r\nX-Render-Ms: %.3f\r\nCache-Control: no-store\r\n%s",
+        (unsigned long long)c->params.seed, c->render_ns / 1e6, gzipped ? "Content-Encoding: gzip\r\n" : "");
+    if (n <= 0 || n >= (int)sizeof(extra)) return -1;
+
+    c->out.length = 0;
+    c->out_sent = 0;
+    c->body_length = c->head_only ? 0 : st.st_size;
+    c->body_sent = 0;
+    c->state = WRITING;
+    record_latency(&s->response_latency, stats_now() - c->started);
+    return http_response_head(&c->out, 200, png ? "image/png" : "image/svg+xml", (uint64_t)st.st_size, c->keep_alive,
+        (StrView){extra, (uint64_t)n});
+}
+
+// Answers the request at the start of the input of c, which is complete.
+static int8_t handle_request(Conn* c, const HttpRequest* req) {
+    Server* s = c->server;
+    s->requests++;
+    c->started = stats_now();
+    c->keep_alive = req->keep_alive;
+    c->head_only = req->method.length == 4 && memcmp(req->method.str, "HEAD", 4) == 0;
+    const int8_t get = req->method.length == 3 && memcmp(req->method.str, "GET", 3) == 0;
+
+    if (!get && !c->head_only) {
+        c->keep_alive = req->keep_alive && !req->has_body;
+        return respond(c, 405, "text/plain; charset=utf-8", STR_LIT("only GET and HEAD are served\n"), STR_LIT("Allow: GET, HEAD\r\n"));
+    }
+    // the body is not read, so whatever follows it cannot be parsed.
+    if (req->has_body) {
+        c->keep_alive = 0;
+        return respond_text(c, 400, "requests with a body are not served\n");
+    }
+
+    const StrView path = req->path;
+    if (path.length == 1) return respond_text(c, 200, HELP);
+    if (path.length == 7 && memcmp(path.str, "/render", 7) == 0) return start_render(c, req->query);
+    if (path.length == 8 && memcmp(path.str, "/presets", 8) == 0) return respond_presets(c);
+    if (path.length == 6 && memcmp(path.str, "/stats", 6) == 0) return respond_stats(c);
+    return respond_text(c, 404, "not found, see /\n");
+}
+
+// Sends what is left of the response. Returns 1 once it is sent, 0 if the socket is full and -1 on failure.
+static int8_t send_response(Conn* c) {
+    while (c->out_sent < c->out.length) {
+        const ssize_t n = send(c->fd, c->out.str + c->out_sent, c->out.length - c->out_sent, MSG_NOSIGNAL);
+        if (n == -1 && errno == EINTR) continue;
+        if (n == -1) return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+        c->out_sent += n;
+    }
+    while (c->body_sent < c->body_length) {
+        // straight from the memfd to the socket, the render is never copied through user space.
+        const ssize_t n = sendfile(c->fd, c->body, &c->body_sent, c->body_length - c->body_sent);
+        if (n == -1 && errno == EINTR) continue;
+        if (n == -1) return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+        if (n == 0) return -1;
+    }
+    return 1;
+}
+
+// Moves the connection on as far as it can go without blocking: sends the response,
+// answers the requests already received, then reads more. Closes it when it is done or fails.
+static void advance(Conn* c) {
+    Server* s = c->server;
+    for (;;) {
+        if (c->state == RENDERING) return;
+        if (c->state == WRITING) {
+            const int8_t sent = send_response(c);
+            if (sent == 0) {
+                watch(c, EPOLLOUT);
+                return;
+            }
+            if (sent == -1 || !c->keep_alive) {
+                // closing with unread input resets the connection, which can make the peer
+                // drop the response; what has already arrived is read and discarded first.
+                shutdown(c->fd, SHUT_WR);
+                for (int k = 0; k < 16 && recv(c->fd, c->in, REQUEST_MAX, MSG_DONTWAIT) > 0; k++) {}
+                close_conn(s, c);
+                return;
+            }
+            c->state = READING;
+        }
+
+        HttpRequest req;
+        const int8_t parsed = http_parse_request((StrView){c->in, c->in_length}, &req);
+        if (parsed == 1) {
+            const int8_t status = handle_request(c, &req);
+            // the request is dropped once answered, the views into it are not used after.
+            c->in_length -= (uint32_t)req.length;
+            memmove(c->in, c->in + req.length, c->in_length);
+            if (status != 0) {
+                close_conn(s, c);
+                return;
+            }
+            continue;
+        }
+        if (parsed == -1 || c->in_length == REQUEST_MAX) {
+            c->started = stats_now();
+            c->keep_alive = 0;
+            c->head_only = 0;
+            if ((parsed == -1 ? respond_text(c, 400, "malformed request\n") : respond_text(c, 431, "request head too large\n")) != 0) {
+                close_conn(s, c);
+                return;
+            }
+            continue;
+        }
+        if (c->peer_closed) {
+            close_conn(s, c);
+            return;
+        }
+
+        const ssize_t n = recv(c->fd, c->in + c->in_length, REQUEST_MAX - c->in_length, 0);
+        if (n == -1 && errno == EINTR) continue;
+        if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            watch(c, EPOLLIN);
+            return;
+        }
+        if (n == -1) {
+            close_conn(s, c);
+            return;
+        }
+        if (n == 0) c->peer_closed = 1;
+        c->in_length += (uint32_t)n;
+    }
+}
+
+static void accept_conns(Server* s) {
+    for (;;) {
+        const int fd = accept4(s->listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            return;
+        }
+        if (s->connections == MAX_CONNECTIONS) {
+            close(fd);
+            continue;
+        }
+        // responses are written whole, Nagle would only delay their last segment.
+        const int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        Conn* c = (Conn*)malloc(sizeof(Conn));
+        if (c == NULL) {
+            close(fd);
+            continue;
+        }
+        *c = (Conn){.server = s, .fd = fd, .state = READING, .events = EPOLLIN};
+        c->body = memfd_create("wootkas-preview", MFD_CLOEXEC);
+        c->out = str_builder_new(1024);
+        struct epoll_event event = {.events = EPOLLIN, .data.ptr = c};
+        if (c->body == -1 || c->out.str == NULL || epoll_ctl(s->epoll, EPOLL_CTL_ADD, fd, &event) != 0) {
+            DEBUG_PRINT("err! serve(): failed to set up a connection.\n");
+            if (c->body != -1) close(c->body);
+            str_builder_free(&c->out);
+            close(fd);
+            free(c);
+            continue;
+        }
+        c->next = s->open;
+        if (s->open != NULL) s->open->prev = c;
+        s->open = c;
+        s->connections++;
+    }
+}
+
+// Answers the renders finished since the last wakeup.
+static void answer_renders(Server* s) {
+    uint64_t count;
+    if (read(s->wakeup, &count, sizeof(count)) != sizeof(count)) return;
+    pthread_mutex_lock(&s->lock);
+    Conn* done = s->done;
+    s->done = NULL;
+    pthread_mutex_unlock(&s->lock);
+
+    while (done != NULL) {
+        Conn* c = done;
+        done = c->done;
+        if (c->hung_up) {
+            s->renders++;
+            record_latency(&s->render_latency, c->render_ns);
+            close_conn(s, c);
+        } else if (finish_render(c) != 0) {
+            close_conn(s, c);
+        } else {
+            advance(c);
+        }
+    }
+}
+
+static void free_graveyard(Server* s) {
+    while (s->graveyard != NULL) {
+        Conn* c = s->graveyard;
+        s->graveyard = c->done;
+        free(c);
+    }
+}
+
+// Opens the loopback listener on port. Returns the socket, -1 on failure.
+static int listen_loopback(uint16_t port) {
+    const int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1) return -1;
+    const int one = 1;
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(port), .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+    socklen_t length = sizeof(addr);
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) != 0 ||
+        bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0 ||
+        getsockname(fd, (struct sockaddr*)&addr, &length) != 0) {
+        close(fd);
+        return -1;
+    }
+    fprintf(stderr, "serving on http://127.0.0.1:%u\n", ntohs(addr.sin_port));
+    return fd;
+}
+
+int8_t serve(const ServeOptions* options, const sigset_t* signals) {
+    Server* s = (Server*)calloc(1, sizeof(Server));
+    if (s == NULL) return -1;
+    s->options = options;
+    rng_seed(&s->seeds, options->seed);
+    // a peer closing mid-response must not kill the server; sendfile(2) has no MSG_NOSIGNAL.
+    signal(SIGPIPE, SIG_IGN);
+
+    s->listener = listen_loopback(options->port);
+    s->epoll = epoll_create1(EPOLL_CLOEXEC);
+    s->wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    s->stop = signalfd(-1, signals, SFD_CLOEXEC);
+    int* watched[] = {&s->listener, &s->wakeup, &s->stop};
+    int8_t status = (s->listener != -1 && s->epoll != -1 && s->wakeup != -1 && s->stop != -1) ? 0 : -1;
+    for (int i = 0; i < 3 && status == 0; i++) {
+        struct epoll_event event = {.events = EPOLLIN, .data.ptr = watched[i]};
+        if (epoll_ctl(s->epoll, EPOLL_CTL_ADD, *watched[i], &event) != 0) status = -1;
+    }
+    if (status != 0 || pthread_mutex_init(&s->lock, NULL) != 0) {
+        fprintf(stderr, "failed to start the server: %s\n", strerror(errno));
+        for (int i = 0; i < 3; i++) {
+            if (*watched[i] != -1) close(*watched[i]);
+        }
+        if (s->epoll != -1) close(s->epoll);
+        free(s);
+        return -1;
+    }
+
+    struct epoll_event events[EPOLL_EVENTS];
+    int8_t running = 1;
+    while (running) {
+        const int count = epoll_wait(s->epoll, events, EPOLL_EVENTS, -1);
+        if (count == -1) {
+            if (errno == EINTR) continue;
+            status = -1;
+            break;
+        }
+        for (int i = 0; i < count; i++) {
+            void* ptr = events[i].data.ptr;
+            if (ptr == &s->stop) {
+                running = 0;
+            } else if (ptr == &s->listener) {
+                accept_conns(s);
+            } else if (ptr == &s->wakeup) {
+                answer_renders(s);
+            } else {
+                Conn* c = (Conn*)ptr;
+                if (c->state == CLOSED || c->hung_up) continue;
+                if (c->state == RENDERING) {
+                    // only a hang up is reported while rendering; the render finishes first.
+                    if (events[i].events & (EPOLLHUP | EPOLLERR)) {
+                        c->hung_up = 1;
+                        epoll_ctl(s->epoll, EPOLL_CTL_DEL, c->fd, NULL);
+                    }
+                } else if (events[i].events & EPOLLERR) {
+                    close_conn(s, c);
+                } else {
+                    advance(c);
+                }
+            }
+        }
+        free_graveyard(s);
+    }
+
+    // renders in flight are waited for, their connections closed with the others.
+    close(s->listener);
+    if (options->pool != NULL) pool_wait(options->pool);
+    pthread_mutex_lock(&s->lock);
+    s->done = NULL;
+    pthread_mutex_unlock(&s->lock);
+    while (s->open != NULL) close_conn(s, s->open);
+    free_graveyard(s);
+    fprintf(stderr, "%llu requests, %llu renders, %llu failed\n",
+        (unsigned long long)s->requests, (unsigned long long)s->renders, (unsigned long long)s->failed);
+
+    pthread_mutex_destroy(&s->lock);
+    close(s->wakeup);
+    close(s->stop);
+    close(s->epoll);
+    free(s);
+    return status;
+}
@@ -4,50 +4,285 @@ based on Bézier curves—and write them into an SVG file. The shapes are genera
 random transformations (positioning, scaling, rotation) to ensure visual diversity.
 
 Functions:
-    * `void create_triogon(origin)`: Generates a single triogon with randomized attributes.
+    * `void create_triogon(chunk, rng, origin)`: Adds a single triogon with randomized attributes to a chunk.
+        - chunk: range of shapes the triogon belongs to
+        - rng: random number generator of this triogon
         - origin: Starting point of a triogon
 
-    * `void triogons(width, height, theme)`: generate multiple triogons and writes the SVG file.
-        - width: width of the canvas
-        - height: height of the canvas
-        - theme: (Lumos or Noir) choose whether to use light(Lumos) or dark(Noir) style.
+    * `void emit_triogon(chunk, s)`: Appends the <path/> tag of triogon s once the chunk is transformed.
+
+    * `void triogons(params)`: generate multiple triogons and writes the SVG file.
+        - params: canvas size, theme (Lumos or Noir), seed, density, accents and an optional thread pool.
+
+    * `void triogons_sizes(params, sizes, count)`: renders the same triogons at several sizes.
+
+Origins are spread as blue noise by a Placement, so shapes cover the canvas evenly
+instead of piling up where independent random points happen to cluster.
+
+Shapes are created on a reference canvas and fitted to the canvas rendered, so that a
+seed gives the same wallpaper at every size; triogons_sizes() renders several sizes
+from a single set of shapes. The canvas of a render lives in its context only.
+
+Large renders are split into chunks of consecutive shapes that are generated and
+formatted in parallel, then concatenated in order. Every shape draws from its own
+random stream and the origins are placed in order on the calling thread, so the
+output only depends on the seed and never on the thread count.
+
+PNG and PPM renders of a still wallpaper write no text for the shapes: the rasterizer
+takes their outlines and the colours the palette packs as they are.
 */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include "../include/arena.h"
+#include "../include/color.h"
+#include "../include/fmt.h"
+#include "../include/geometry.h"
+#include "../include/placement.h"
+#include "../include/pool.h"
+#include "../include/presets.h"
+#include "../include/rng.h"
+#include "../include/stats.h"
 #include "../include/strings.h"
+#include "../include/svg.h"
+#include "../include/template.h"
 #include "../include/utils.h"
 
 // some customization options.
 #define SCALE_FACTOR 1.3
-#define DENSITY rand_range(12, 23)
-// HSLA color:
-#define HUE rand_range(0, 360)
-#define SATURATION (int)rand_range(30, 65)
-#define LIGHTNESS(theme) (int)((theme == Lumos) ? rand_range(46, 78) : rand_range(65, 95))
-#define ALPHA(theme) (theme == Lumos) ? 0.72 : 0.8
+#define DENSITY(rng) (uint16_t)rand_range(rng, 12, 23)
+// the colours of each theme, indexed by Theme: lightness, saturation and alpha (see color.h).
+static const PaletteSpec THEME_PALETTES[] = {{46, 78, 30, 65, 0.72f}, {65, 95, 30, 65, 0.8f}};
+// decimals written for hue/alpha and for path coordinates.
+#define COLOR_PRECISION 2
+#define COORD_PRECISION 0
+// minimum distance between two origins, in canvas units (see placement_spacing());
+// it shrinks when more shapes are drawn than fit at this distance.
+#define SPACING 12
+// the most a shape drifts in one frame of an animation: its origin in canvas units,
+// its rotation and hue in degrees.
+#define DRIFT 0.02
+#define SPIN 0.05
+#define HUE_DRIFT 0.2
+// a shape drifts smoothly but is drawn moved in steps from where it was created: canvas units,
+// degrees of rotation and of hue. Its text then stays the same for several frames instead of
+// changing a little in every one, and the frames in between copy it.
+#define DRIFT_STEP 1.0f
+#define SPIN_STEP 0.25f
+#define HUE_STEP 1.0f
 
 // light and dark theme
-typedef enum {Lumos, Noir} Theme;
-#define LUMO str_from("#E5E5E5")
-#define NOIR str_from("#121212")
+#define LUMO STR_LIT("#E5E5E5")
+#define NOIR STR_LIT("#121212")
+
+// canvas size when the caller does not give one.
+#define DEFAULT_WIDTH 1920
+#define DEFAULT_HEIGHT 1080
+// shapes are created on a reference canvas of this size and then fitted to the one rendered,
+// so that every size shows the same wallpaper: origins are stretched along each axis and
+// shapes scaled with the mean side of the canvas.
+#define REFERENCE_WIDTH 1920
+#define REFERENCE_HEIGHT 1080
+// canvas units between the origins and the edges, obtained through trial and error.
+#define PADDING 5
+// placeholders of triogons.preset. The copy in assets/ is built in by tools/presetgen.c;
+// a custom one in preset_dir is compiled once at runtime and reused until it changes.
+#define PRESET_FILE "triogons.preset"
+enum {SLOT_CANVAS_WIDTH, SLOT_CANVAS_HEIGHT, SLOT_THEME, SLOT_TRIOGONS};
+static const StrView PRESET_KEYS[] = {STR_LIT("$CANVAS_WIDTH"), STR_LIT("$CANVAS_HEIGHT"), STR_LIT("$THEME"), STR_LIT("$TRIOGONS")};
+static Template preset;
+static char preset_path[PATH_MAX];
+static pthread_once_t preset_path_once = PTHREAD_ONCE_INIT;
+// taken for writing only while the preset is reloaded, renders hold it for reading.
+static pthread_rwlock_t preset_lock = PTHREAD_RWLOCK_INITIALIZER;
+// every allocation of a render comes from here and is dropped at once when it ends.
+// Each thread has its own so that several wallpapers can be rendered at once.
+static _Thread_local Arena arena;
+
+// rough size of one <path/> tag, used to presize the output.
+#define TRIOGON_SIZE_HINT 256
+// a triogon is three cubic curves of three control points each.
+#define TRIOGON_POINTS 9
+
+// renders with fewer shapes per chunk than this are not worth spreading over threads.
+#define CHUNK_MIN_SHAPES 512
+// chunks per thread, more than one evens out the load.
+#define CHUNKS_PER_THREAD 4
+#define MAX_CHUNKS 256
+// when streaming, shapes go out a window of chunks at a time and no chunk holds more than
+// this, so memory depends on the thread count but not on the density.
+#define CHUNK_MAX_SHAPES 2048
+
+typedef struct TriogonsAnimation TriogonsAnimation;
+
+typedef struct {
+    uint16_t width;
+    uint16_t height;
+    Theme theme;
+    Palette palette;      // the theme's, around the accents of the render if it has some.
+    Point padding;
+    Point stretch;        // from the reference canvas to this one, along each axis.
+    float zoom;           // size of the shapes on this canvas relative to the reference one.
+    Rng rng; // shape i draws from stream i of this generator, the origins from PLACEMENT_STREAM.
+    uint32_t density;
+    Pool* pool;
+    int8_t compact;       // writes the compact form of the paths (see svg.h).
+    int8_t direct;        // hands the shapes to the rasterizer of the sink instead of writing them.
+    PresetSink* sink;     // its chain refers to the output of the chunks instead of copying it.
+    uint32_t chunk_count; // chunks whose output the chain may refer to.
+    const TriogonsAnimation* animation; // NULL for a still wallpaper.
+    const struct TriogonsChunk* set;    // every shape, created beforehand; NULL to create them as they are rendered.
+} TriogonsCtx;
+
+// origins come from a stream no shape uses.
+#define PLACEMENT_STREAM UINT64_MAX
 
-static uint16_t CANVAS_WIDTH = 1920;
-static uint16_t CANVAS_HEIGHT = 1080;
-// common divisor is used to maintain relative scaling for other resolutions.
-// 120 is the common divisor of 1920 x 1080.
-// !It is not necessary to change it for different resolutions.
-#define COMMON_DIVISOR 120
+// A range of consecutive shapes rendered by one task.
+// Chunks are kept between renders so their memory is reused.
+typedef struct TriogonsChunk {
+    const TriogonsCtx* ctx;
+    uint32_t first;
+    uint32_t count;
+    const Point* origins; // origin of each shape of the chunk.
+    ShapeBatch shapes;
+    Hsla* colors;
+    uint32_t colors_capacity;
+    Arena arena; // the chunk's output lives here until the document is written.
+    StrBuilder out;
+    int8_t status;
+} TriogonsChunk;
+
+// what a shape is written as, compared from one frame to the next: its hue, then its points.
+#define TRIOGON_KEYS (1 + 2 * TRIOGON_POINTS)
+// frame numbers in output paths have at least this many digits, so that they sort.
+#define FRAME_DIGITS 4
+// decimals written for the key times of an SMIL animation.
+#define KEY_TIME_PRECISION 5
+
+// How a shape changes from one frame to the next.
+typedef struct {
+    float vx;
+    float vy;
+    float spin;
+    float hue;
+    float dx, dy, turn, shift; // drifted so far, drawn in steps (see DRIFT_STEP).
+} Drift;
+
+// Returns how much of drifted, in whole steps, a shape is drawn moved by.
+static inline float stepped(float drifted, float step) {
+    return roundf(drifted / step) * step;
+}
+
+// A value a shape takes in an SMIL animation: from `frame` on, its fill colour or its
+// path data are the `length` bytes at `offset` in the values of its chunk.
+typedef struct {
+    uint32_t shape;
+    uint32_t frame;
+    uint64_t offset;
+    uint32_t length;
+    uint8_t fill;
+} Keyframe;
+
+// The shapes of an animation drawn by one task, kept from one frame to the next.
+typedef struct {
+    TriogonsChunk chunk;  // the shapes as drawn in the current frame, its arena is unused.
+    const TriogonsAnimation* animation;
+    float* base;          // points of the shapes before their transform: the x rows, then the y rows.
+    Drift* drift;
+    int64_t* keys;        // TRIOGON_KEYS per shape, as written in the previous frame.
+    // a shape is written as its head, the tag up to the path data, its path data and a fixed
+    // tail; spans[3 * s ...] locate the first two in chunk.out, previous_spans in previous.
+    uint64_t* spans;
+    uint64_t* previous_spans;
+    StrBuilder previous;  // the previous frame; what did not change since is copied from it.
+    StrBuilder values;    // SMIL: every value the shapes take, located by the keyframes.
+    Keyframe* keyframes;
+    uint64_t keyframe_count;
+    uint64_t keyframe_capacity;
+    StrBuilder document;  // SMIL: the animated shapes, once every frame is drawn.
+    uint64_t reformatted;
+} AnimatedChunk;
+
+struct TriogonsAnimation {
+    const Animation* params;
+    AnimatedChunk* chunks;
+    uint32_t chunk_count;
+    uint32_t frame;  // the frame being drawn.
+    int8_t smil;     // the frames make one animated document rather than a document each.
+};
+
+static _Thread_local TriogonsChunk chunks[MAX_CHUNKS];
+// origins of the shapes of a window, kept between renders like the chunks.
+static _Thread_local Placement placement;
+static _Thread_local Point* origins;
+static _Thread_local uint32_t origins_capacity;
+
+// frees what a thread kept between renders when it exits.
+static pthread_key_t thread_state;
+static pthread_once_t thread_state_once = PTHREAD_ONCE_INIT;
+
+static void release_thread_state(void* unused) {
+    (void)unused;
+    arena_free(&arena);
+    placement_free(&placement);
+    free(origins);
+    origins = NULL;
+    origins_capacity = 0;
+    for (uint32_t c = 0; c < MAX_CHUNKS; c++) {
+        geom_batch_free(&chunks[c].shapes);
+        free(chunks[c].colors);
+        arena_free(&chunks[c].arena);
+        chunks[c] = (TriogonsChunk){0};
+    }
+}
+
+static void create_thread_state(void) {
+    pthread_key_create(&thread_state, release_thread_state);
+}
+
+// the tables of the theme palettes, built once and shared by every render.
+static Palette palettes[sizeof(THEME_PALETTES) / sizeof(THEME_PALETTES[0])];
+static int8_t palettes_status;
+static pthread_once_t palettes_once = PTHREAD_ONCE_INIT;
+
+static void build_palettes(void) {
+    for (size_t t = 0; t < sizeof(palettes) / sizeof(palettes[0]); t++) {
+        if (palette_init(&palettes[t], THEME_PALETTES[t]) != 0) palettes_status = -1;
+    }
+}
+
+// Makes room for a color per shape the batch of the chunk has room for.
+static int8_t reserve_colors(TriogonsChunk* chunk) {
+    if (chunk->shapes.capacity <= chunk->colors_capacity) return 0;
+    Hsla* grown = (Hsla*)realloc(chunk->colors, chunk->shapes.capacity * sizeof(Hsla));
+    if (grown == NULL) {
+        DEBUG_PRINT("err! reserve_colors(): failed to allocate memory for colors.\n");
+        return -1;
+    }
+    chunk->colors = grown;
+    chunk->colors_capacity = chunk->shapes.capacity;
+    return 0;
+}
 
 /**
- * @brief Creates a triogon SVG path based on the given origin point.
+ * @brief Adds a triogon based on the given origin point to the batch.
  *
  * A triogon is created using three control points. This function initializes
- * the control points, applies random transformations, and constructs an SVG path tag.
+ * the control points and draws the random transformations and color applied to it,
+ * on the reference canvas; fit_shapes() then maps it onto the canvas rendered.
  *
- * @param origin: The origin point where the triogon starts.
- * @param theme: whether to use light or dark theme
- * @return A string containing the SVG path for the triogon.
+ * @param chunk: chunk the triogon is added to.
+ * @param rng: random number generator of this triogon.
+ * @param origin: The origin point where the triogon starts, on the reference canvas.
+ * @return 0 on success, -1 on failure.
  */
-static String create_triogon(Point origin, Theme theme) {
-    int C[3][6]; // to store the control points of beziere curve.
+static int8_t create_triogon(TriogonsChunk* chunk, Rng* rng, Point origin) {
+    ShapeBatch* shapes = &chunk->shapes;
+    float C[3][6]; // to store the control points of beziere curve, relative to origin.
 
     // Range for positioning and control point adjustments.
     // The shape's fundamental character can be modified by changing these values.
@@ -56,91 +291,809 @@ static String create_triogon(Point origin, Theme theme) {
     const Point anchor_range = {2, 8};
     const Point shift = {6.5, 10};
 
+    // all the entropy of the outline is drawn in two batches.
+    float pos[4], anchor[12];
+    rng_fill_range(rng, pos, 4, pos_range.x, pos_range.y);
+    rng_fill_range(rng, anchor, 12, anchor_range.x, anchor_range.y);
+
     // creating the shape with entropy.
-    C[2][4] = origin.x;
-    C[2][5] = origin.y;
-    C[0][4] = origin.x + shift.x + rand_range(pos_range.x, pos_range.y);
-    C[0][5] = origin.y + shift.y + rand_range(pos_range.x, pos_range.y);
-    C[1][4] = origin.x - shift.x + rand_range(pos_range.x, pos_range.y);
-    C[1][5] = origin.y + shift.y + rand_range(pos_range.x, pos_range.y);
-
-    C[0][0] = origin.x + rand_range(anchor_range.x, anchor_range.y);
-    C[0][1] = origin.y - rand_range(anchor_range.x, anchor_range.y);
-    C[0][2] = C[0][4] + rand_range(anchor_range.x, anchor_range.y);
-    C[0][3] = C[0][5] - rand_range(anchor_range.x, anchor_range.y);
-
-    C[1][0] = C[0][4] - rand_range(anchor_range.x, anchor_range.y);
-    C[1][1] = C[0][5] + rand_range(anchor_range.x, anchor_range.y);
-    C[1][2] = C[1][4] + rand_range(anchor_range.x, anchor_range.y);
-    C[1][3] = C[1][5] + rand_range(anchor_range.x, anchor_range.y);
-
-    C[2][0] = C[1][4] - rand_range(anchor_range.x, anchor_range.y);
-    C[2][1] = C[1][5] - rand_range(anchor_range.x, anchor_range.y);
-    C[2][2] = C[2][4] - rand_range(anchor_range.x, anchor_range.y);
-    C[2][3] = C[2][5] + rand_range(anchor_range.x, anchor_range.y);
-
-    // more entropy using transformations.
-    const float scale = rand_range(CANVAS_HEIGHT, CANVAS_WIDTH) / COMMON_DIVISOR * SCALE_FACTOR;
-    transform_rotate(3, 6, C, rand_range(0, 360));
-    transform_scale(3, 6, C, scale);
-
-    // now we need to make an svg <path/> attribute with the data we have. 
-    String color = str_compose("hsla(%f,%d\%,%d\%,%f)", HUE, SATURATION, LIGHTNESS(theme), ALPHA(theme));
-    String d = str_compose("\"M %d,%d C %d,%d %d,%d %d,%d C %d,%d %d,%d %d,%d C %d,%d %d,%d %d,%d Z\"", 
-            C[2][4], C[2][5],
-            C[0][0], C[0][1], C[0][2], C[0][3], C[0][4], C[0][5],
-            C[1][0], C[1][1], C[1][2], C[1][3], C[1][4], C[1][5],
-            C[2][0], C[2][1], C[2][2], C[2][3], C[2][4], C[2][5]
-        );
-    String path = str_compose("<path style=\"fill:%s;stroke:none;fill-opacity:1\" d=%s/>", color.str, d.str);
-
-    str_free(&color);
-    str_free(&d);
-
-    return path;
+    C[2][4] = 0;
+    C[2][5] = 0;
+    C[0][4] = shift.x + pos[0];
+    C[0][5] = shift.y + pos[1];
+    C[1][4] = -shift.x + pos[2];
+    C[1][5] = shift.y + pos[3];
+
+    C[0][0] = anchor[0];
+    C[0][1] = -anchor[1];
+    C[0][2] = C[0][4] + anchor[2];
+    C[0][3] = C[0][5] - anchor[3];
+
+    C[1][0] = C[0][4] - anchor[4];
+    C[1][1] = C[0][5] + anchor[5];
+    C[1][2] = C[1][4] + anchor[6];
+    C[1][3] = C[1][5] + anchor[7];
+
+    C[2][0] = C[1][4] - anchor[8];
+    C[2][1] = C[1][5] - anchor[9];
+    C[2][2] = C[2][4] - anchor[10];
+    C[2][3] = C[2][5] + anchor[11];
+
+    int64_t s = geom_batch_push(shapes);
+    if (s == -1) return -1;
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            GEOM_X(shapes, s, i * 3 + j) = C[i][j * 2];
+            GEOM_Y(shapes, s, i * 3 + j) = C[i][j * 2 + 1];
+        }
+    }
+
+    // more entropy using transformations, applied to the whole batch at once.
+    shapes->scale[s] = rand_range(rng, REFERENCE_HEIGHT, REFERENCE_WIDTH) / COMMON_DIVISOR * SCALE_FACTOR;
+    shapes->angle[s] = rand_range(rng, 0, 360);
+    shapes->tx[s] = origin.x;
+    shapes->ty[s] = origin.y;
+
+    if (reserve_colors(chunk) != 0) return -1;
+    // the color components are drawn in this exact order so a seed keeps producing the same image.
+    chunk->colors[s] = palette_draw(&chunk->ctx->palette, rng);
+    return 0;
+}
+
+// Maps the shapes of a batch, as created on the reference canvas, onto the canvas of ctx.
+static void fit_shapes(ShapeBatch* shapes, const TriogonsCtx* ctx) {
+    for (uint32_t s = 0; s < shapes->count; s++) {
+        shapes->tx[s] *= ctx->stretch.x;
+        shapes->ty[s] *= ctx->stretch.y;
+        shapes->scale[s] *= ctx->zoom;
+    }
+}
+
+// Copies the shapes of the chunk's range from the set they were created in.
+static int8_t copy_shapes(TriogonsChunk* chunk, const TriogonsChunk* set) {
+    ShapeBatch* shapes = &chunk->shapes;
+    const uint32_t first = chunk->first, count = chunk->count;
+    if (geom_batch_reserve(shapes, count) != 0 || reserve_colors(chunk) != 0) return -1;
+    for (uint16_t p = 0; p < TRIOGON_POINTS; p++) {
+        memcpy(&GEOM_X(shapes, 0, p), &GEOM_X(&set->shapes, first, p), count * sizeof(float));
+        memcpy(&GEOM_Y(shapes, 0, p), &GEOM_Y(&set->shapes, first, p), count * sizeof(float));
+    }
+    memcpy(shapes->angle, set->shapes.angle + first, count * sizeof(float));
+    memcpy(shapes->scale, set->shapes.scale + first, count * sizeof(float));
+    memcpy(shapes->tx, set->shapes.tx + first, count * sizeof(float));
+    memcpy(shapes->ty, set->shapes.ty + first, count * sizeof(float));
+    memcpy(chunk->colors, set->colors + first, count * sizeof(Hsla));
+    shapes->count = count;
+    return 0;
+}
+
+// Starts the SVG path of a triogon of ctx, written to out.
+static SvgPath triogon_path(const TriogonsCtx* ctx, StrBuilder* out) {
+    return (SvgPath){.out = out, .coord_precision = COORD_PRECISION, .color_precision = COLOR_PRECISION,
+        .compact = ctx->compact, .opacity = ctx->palette.spec.alpha, .palette = &ctx->palette};
+}
+
+// Appends the path data of transformed triogon s, up to closing it.
+static int8_t emit_outline(SvgPath* path, const ShapeBatch* shapes, uint32_t s) {
+    if (svg_path_move(path, GEOM_X(shapes, s, 8), GEOM_Y(shapes, s, 8)) != 0) return -1;
+    for (int i = 0; i < 3; i++) {
+        if (svg_path_cubic(path,
+                    GEOM_X(shapes, s, i * 3), GEOM_Y(shapes, s, i * 3),
+                    GEOM_X(shapes, s, i * 3 + 1), GEOM_Y(shapes, s, i * 3 + 1),
+                    GEOM_X(shapes, s, i * 3 + 2), GEOM_Y(shapes, s, i * 3 + 2)) != 0) return -1;
+    }
+    return 0;
 }
 
 /**
- * @brief Generates a complete SVG file with multiple triogons based on a preset template.
+ * @brief Appends the SVG <path/> tag of a transformed triogon.
  *
- * @param width Define the width of the image.
- * @param height Define the height of the image.
- * @param theme The visual theme (Lumos or Noir).
+ * @param chunk: chunk holding the triogon; the tag goes to its output.
+ * @param s: index of the triogon in the chunk.
+ * @return 0 on success, -1 on failure.
  */
-void triogons(uint16_t width, uint16_t height, Theme theme) {
-    String file = str_from(NULL);
-    if (read_file_content("./assets/triogons.preset", &file) != 0) {
+static int8_t emit_triogon(TriogonsChunk* chunk, uint32_t s) {
+    SvgPath path = triogon_path(chunk->ctx, &chunk->out);
+    if (svg_path_begin(&path, chunk->colors[s]) != 0) return -1;
+    if (emit_outline(&path, &chunk->shapes, s) != 0) return -1;
+    return svg_path_close(&path);
+}
+
+// Generates, transforms and formats the shapes of one chunk. Runs on any thread.
+static void render_chunk(void* arg) {
+    TriogonsChunk* chunk = arg;
+    const TriogonsCtx* ctx = chunk->ctx;
+    Arena* previous = str_use_arena(&chunk->arena);
+
+    chunk->status = -1;
+    chunk->out = str_builder_new(ctx->direct ? 0 : chunk->count * TRIOGON_SIZE_HINT);
+    if (chunk->shapes.points == 0) geom_batch_init(&chunk->shapes, TRIOGON_POINTS, chunk->count);
+    geom_batch_clear(&chunk->shapes);
+
+    {
+        STATS_SCOPE(STAT_GEOMETRY);
+        if (ctx->set != NULL) {
+            if (copy_shapes(chunk, ctx->set) != 0) goto done;
+        } else {
+            for (uint32_t i = 0; i < chunk->count; i++) {
+                Rng rng;
+                rng_stream(&ctx->rng, chunk->first + i, &rng);
+                if (create_triogon(chunk, &rng, chunk->origins[i]) != 0) goto done;
+            }
+        }
+        fit_shapes(&chunk->shapes, ctx);
+        geom_batch_transform(&chunk->shapes);
+    }
+    if (!ctx->direct) {
+        STATS_SCOPE(STAT_FORMAT);
+        for (uint32_t s = 0; s < chunk->shapes.count; s++) {
+            if (emit_triogon(chunk, s) != 0) goto done;
+        }
+    }
+    chunk->status = 0;
+
+done:
+    str_use_arena(previous);
+}
+
+// Number of chunks `density` shapes are split into.
+static uint32_t count_chunks(uint32_t density, Pool* pool) {
+    uint32_t chunk_count = 1;
+    if (pool != NULL) {
+        chunk_count = pool->thread_count * CHUNKS_PER_THREAD;
+        if (chunk_count > density / CHUNK_MIN_SHAPES) chunk_count = density / CHUNK_MIN_SHAPES;
+        if (chunk_count > MAX_CHUNKS) chunk_count = MAX_CHUNKS;
+        if (chunk_count == 0) chunk_count = 1;
+    }
+    return chunk_count;
+}
+
+// Places the next `count` origins into `origins`. Every origin depends on the ones
+// before it, so they are placed before the chunks start. Returns 0 on success and -1 on failure.
+static int8_t place_origins(uint32_t count) {
+    if (count > origins_capacity) {
+        Point* grown = (Point*)realloc(origins, count * sizeof(Point));
+        if (grown == NULL) {
+            DEBUG_PRINT("err! place_origins(): failed to allocate memory for %u origins.\n", count);
+            return -1;
+        }
+        origins = grown;
+        origins_capacity = count;
+    }
+    STATS_SCOPE(STAT_GEOMETRY);
+    for (uint32_t i = 0; i < count; i++) origins[i] = placement_next(&placement);
+    return 0;
+}
+
+// Starts placing the origins of `density` shapes on the reference canvas, from the stream no shape uses.
+static int8_t begin_placement(const TriogonsCtx* ctx, uint32_t density) {
+    Rng placement_rng;
+    rng_stream(&ctx->rng, PLACEMENT_STREAM, &placement_rng);
+    const Point padding = {(float)REFERENCE_WIDTH / COMMON_DIVISOR * PADDING, (float)REFERENCE_HEIGHT / COMMON_DIVISOR * PADDING};
+    const Point end = {REFERENCE_WIDTH - padding.x, REFERENCE_HEIGHT - padding.y};
+    return placement_begin(&placement, &placement_rng, padding, end, placement_spacing(REFERENCE_WIDTH, REFERENCE_HEIGHT, SPACING), density);
+}
+
+// Renders shapes first .. first + count - 1 into the sink's chain, over the pool's threads
+// when there are enough of them. The chain refers to the output of the chunks, which stays
+// valid until their arenas are reset.
+static int8_t render_window(TriogonsCtx* ctx, uint32_t first, uint32_t count, uint32_t chunk_count, Pool* pool) {
+    if (chunk_count > ctx->chunk_count) ctx->chunk_count = chunk_count;
+    if (ctx->set == NULL && place_origins(count) != 0) return -1;
+
+    // contiguous ranges, the first count % chunk_count chunks take one extra shape.
+    const Point* next_origin = origins;
+    for (uint32_t c = 0; c < chunk_count; c++) {
+        chunks[c].ctx = ctx;
+        chunks[c].first = first;
+        chunks[c].count = count / chunk_count + (c < count % chunk_count);
+        chunks[c].origins = next_origin;
+        first += chunks[c].count;
+        next_origin += chunks[c].count;
+        if (chunk_count == 1 || pool_submit(pool, render_chunk, &chunks[c]) != 0) render_chunk(&chunks[c]);
+    }
+    if (chunk_count > 1) pool_wait(pool);
+
+    for (uint32_t c = 0; c < chunk_count; c++) {
+        if (chunks[c].status != 0 || str_chain_append_ref(&ctx->sink->chain, str_builder_view(&chunks[c].out)) != 0) return -1;
+    }
+    return 0;
+}
+
+// Renders `density` shapes into the sink. Shape i always draws from stream i,
+// so the document is the same however the shapes are split into windows and chunks.
+static int8_t render_triogons(TriogonsCtx* ctx, uint32_t density, Pool* pool) {
+    if (ctx->set == NULL && begin_placement(ctx, density) != 0) return -1;
+
+    const uint32_t chunk_count = count_chunks(density, pool);
+    if (!preset_sink_streams(ctx->sink) || density / chunk_count <= CHUNK_MAX_SHAPES) {
+        return render_window(ctx, 0, density, chunk_count, pool);
+    }
+
+    const uint32_t window = chunk_count * CHUNK_MAX_SHAPES;
+    for (uint32_t first = 0; first < density; first += window) {
+        const uint32_t count = (density - first < window) ? density - first : window;
+        if (render_window(ctx, first, count, count_chunks(count, pool), pool) != 0 || preset_sink_flush(ctx->sink) != 0) {
+            return -1;
+        }
+        for (uint32_t c = 0; c < ctx->chunk_count; c++) arena_reset(&chunks[c].arena);
+    }
+    return 0;
+}
+
+// Creates the shapes of an animated chunk and how they drift, and keeps their points as created.
+static int8_t create_animated(AnimatedChunk* a) {
+    TriogonsChunk* chunk = &a->chunk;
+    const TriogonsCtx* ctx = chunk->ctx;
+    const uint32_t count = chunk->count;
+    if (geom_batch_init(&chunk->shapes, TRIOGON_POINTS, count) != 0) return -1;
+    a->base = (float*)malloc((uint64_t)2 * TRIOGON_POINTS * count * sizeof(float));
+    a->drift = (Drift*)malloc(count * sizeof(Drift));
+    a->keys = (int64_t*)malloc((uint64_t)count * TRIOGON_KEYS * sizeof(int64_t));
+    a->spans = (uint64_t*)malloc((uint64_t)3 * count * sizeof(uint64_t));
+    a->previous_spans = (uint64_t*)malloc((uint64_t)3 * count * sizeof(uint64_t));
+    if (a->base == NULL || a->drift == NULL || a->keys == NULL || a->spans == NULL || a->previous_spans == NULL) {
+        DEBUG_PRINT("err! create_animated(): failed to allocate memory for %u shapes.\n", count);
+        return -1;
+    }
+
+    const float unit = placement_spacing(ctx->width, ctx->height, 1);
+    for (uint32_t i = 0; i < count; i++) {
+        Rng rng;
+        rng_stream(&ctx->rng, chunk->first + i, &rng);
+        if (create_triogon(chunk, &rng, chunk->origins[i]) != 0) return -1;
+        // drawn after the shape, so that the first frame is the still wallpaper.
+        const float vx = rand_range(&rng, -DRIFT, DRIFT) * unit;
+        const float vy = rand_range(&rng, -DRIFT, DRIFT) * unit;
+        const float spin = rand_range(&rng, -SPIN, SPIN);
+        a->drift[i] = (Drift){vx, vy, spin, rand_range(&rng, -HUE_DRIFT, HUE_DRIFT), 0, 0, 0, 0};
+    }
+    fit_shapes(&chunk->shapes, ctx);
+    for (uint16_t p = 0; p < TRIOGON_POINTS; p++) {
+        memcpy(a->base + (uint64_t)p * count, &GEOM_X(&chunk->shapes, 0, p), count * sizeof(float));
+        memcpy(a->base + (uint64_t)(TRIOGON_POINTS + p) * count, &GEOM_Y(&chunk->shapes, 0, p), count * sizeof(float));
+    }
+    return 0;
+}
+
+// Moves the shapes of an animated chunk one frame further when `move`, then transforms them.
+static void advance_animated(AnimatedChunk* a, int8_t move) {
+    ShapeBatch* shapes = &a->chunk.shapes;
+    const TriogonsCtx* ctx = a->chunk.ctx;
+    const uint32_t count = a->chunk.count;
+    const Point end = {ctx->width - ctx->padding.x, ctx->height - ctx->padding.y};
+    for (uint32_t s = 0; move && s < count; s++) {
+        Drift* d = &a->drift[s];
+        // what is drawn moves by the change of the stepped drift; origins bounce off the padding
+        // where they really are.
+        const float was_x = stepped(d->dx, DRIFT_STEP), was_y = stepped(d->dy, DRIFT_STEP);
+        d->dx += d->vx;
+        const float x = shapes->tx[s] - was_x + d->dx;
+        if (x < ctx->padding.x || x > end.x) {
+            d->vx = -d->vx;
+            d->dx += 2 * d->vx;
+        }
+        d->dy += d->vy;
+        const float y = shapes->ty[s] - was_y + d->dy;
+        if (y < ctx->padding.y || y > end.y) {
+            d->vy = -d->vy;
+            d->dy += 2 * d->vy;
+        }
+        shapes->tx[s] += stepped(d->dx, DRIFT_STEP) - was_x;
+        shapes->ty[s] += stepped(d->dy, DRIFT_STEP) - was_y;
+
+        const float was_turn = stepped(d->turn, SPIN_STEP), was_shift = stepped(d->shift, HUE_STEP);
+        d->turn += d->spin;
+        d->shift += d->hue;
+        shapes->angle[s] = fmodf(shapes->angle[s] + stepped(d->turn, SPIN_STEP) - was_turn + 360, 360);
+        a->chunk.colors[s].h = fmodf(a->chunk.colors[s].h + stepped(d->shift, HUE_STEP) - was_shift + 360, 360);
+    }
+    // the transform works in place, so it starts over from the points as created.
+    for (uint16_t p = 0; p < TRIOGON_POINTS; p++) {
+        memcpy(&GEOM_X(shapes, 0, p), a->base + (uint64_t)p * count, count * sizeof(float));
+        memcpy(&GEOM_Y(shapes, 0, p), a->base + (uint64_t)(TRIOGON_POINTS + p) * count, count * sizeof(float));
+    }
+    geom_batch_transform(shapes);
+}
+
+// Records that shape s takes a new fill colour, or path data, from the current frame on.
+static int8_t add_keyframe(AnimatedChunk* a, uint32_t s, uint8_t fill) {
+    if (a->keyframe_count == a->keyframe_capacity) {
+        const uint64_t capacity = (a->keyframe_capacity != 0) ? a->keyframe_capacity * 2 : 2 * a->chunk.count;
+        Keyframe* grown = (Keyframe*)realloc(a->keyframes, capacity * sizeof(Keyframe));
+        if (grown == NULL) {
+            DEBUG_PRINT("err! add_keyframe(): failed to allocate memory for %lu keyframes.\n", capacity);
+            return -1;
+        }
+        a->keyframes = grown;
+        a->keyframe_capacity = capacity;
+    }
+    const uint64_t offset = a->values.length;
+    SvgPath path = triogon_path(a->chunk.ctx, &a->values);
+    const StrView close = path.compact ? STR_LIT("z") : STR_LIT(" Z");
+    const int8_t written = fill ? svg_path_fill(&path, a->chunk.colors[s]) :
+        (emit_outline(&path, &a->chunk.shapes, s) == 0) ? str_builder_append(&a->values, close) : -1;
+    if (written != 0) return -1;
+    a->keyframes[a->keyframe_count++] = (Keyframe){s, a->animation->frame, offset, (uint32_t)(a->values.length - offset), fill};
+    return 0;
+}
+
+// Appends the bytes from begin to end of `from`.
+static int8_t copy_span(StrBuilder* out, const StrBuilder* from, uint64_t begin, uint64_t end) {
+    return str_builder_append_n(out, from->str + begin, end - begin);
+}
+
+// Formats the fill colour and the path data of the shapes that changed since the previous
+// frame and copies the rest from it, into chunk.out; an SMIL animation only writes its
+// first frame and records the changes of the next ones as keyframes.
+static int8_t format_animated(AnimatedChunk* a) {
+    TriogonsChunk* chunk = &a->chunk;
+    const ShapeBatch* shapes = &chunk->shapes;
+    const uint32_t frame = a->animation->frame;
+    const int8_t whole = !a->animation->smil || frame == 0;
+    if (whole) {
+        const StrBuilder out = chunk->out;
+        chunk->out = a->previous;
+        a->previous = out;
+        uint64_t* spans = a->spans;
+        a->spans = a->previous_spans;
+        a->previous_spans = spans;
+        chunk->out.length = 0;
+        if (str_builder_reserve(&chunk->out, chunk->count * TRIOGON_SIZE_HINT) != 0) return -1;
+        chunk->out.str[0] = '\0';
+    }
+
+    for (uint32_t s = 0; s < chunk->count; s++) {
+        int64_t keys[TRIOGON_KEYS];
+        keys[0] = fmt_fixed_key(chunk->colors[s].h, COLOR_PRECISION);
+        for (uint16_t p = 0; p < TRIOGON_POINTS; p++) {
+            keys[1 + 2 * p] = fmt_fixed_key(GEOM_X(shapes, s, p), COORD_PRECISION);
+            keys[2 + 2 * p] = fmt_fixed_key(GEOM_Y(shapes, s, p), COORD_PRECISION);
+        }
+        int64_t* written = a->keys + (uint64_t)s * TRIOGON_KEYS;
+        const int8_t fill = frame == 0 || keys[0] != written[0];
+        const int8_t outline = frame == 0 || memcmp(keys + 1, written + 1, 2 * TRIOGON_POINTS * sizeof(int64_t)) != 0;
+        memcpy(written, keys, sizeof(keys));
+        a->reformatted += fill || outline;
+
+        if (a->animation->smil) {
+            if (fill && add_keyframe(a, s, 1) != 0) return -1;
+            if (outline && add_keyframe(a, s, 0) != 0) return -1;
+        }
+        if (!whole) continue;
+        SvgPath path = triogon_path(chunk->ctx, &chunk->out);
+        uint64_t* span = a->spans + (uint64_t)3 * s;
+        const uint64_t* was = a->previous_spans + (uint64_t)3 * s;
+        span[0] = chunk->out.length;
+        if ((fill ? svg_path_begin(&path, chunk->colors[s]) : copy_span(&chunk->out, &a->previous, was[0], was[1])) != 0) return -1;
+        span[1] = chunk->out.length;
+        if ((outline ? emit_outline(&path, shapes, s) : copy_span(&chunk->out, &a->previous, was[1], was[2])) != 0) return -1;
+        span[2] = chunk->out.length;
+        if (svg_path_close(&path) != 0) return -1;
+    }
+    return 0;
+}
+
+// Draws the current frame of an animated chunk. Runs on any thread.
+static void animate_chunk(void* arg) {
+    AnimatedChunk* a = arg;
+    const uint32_t frame = a->animation->frame;
+    // the shapes outlive the frame, they are kept on the heap.
+    Arena* previous = str_use_arena(NULL);
+    a->chunk.status = -1;
+    {
+        STATS_SCOPE(STAT_GEOMETRY);
+        if (frame == 0 && create_animated(a) != 0) goto done;
+        advance_animated(a, frame != 0);
+    }
+    {
+        STATS_SCOPE(STAT_FORMAT);
+        if (format_animated(a) != 0) goto done;
+    }
+    a->chunk.status = 0;
+
+done:
+    str_use_arena(previous);
+}
+
+// Writes the shapes of an animated chunk into its document once every frame is drawn: each
+// shape as in the first frame, with an SMIL <animate/> of its path data and one of its fill
+// colour when they change. Runs on any thread.
+static void assemble_chunk(void* arg) {
+    AnimatedChunk* a = arg;
+    TriogonsChunk* chunk = &a->chunk;
+    const Animation* params = a->animation->params;
+    const double seconds = (double)params->frames / params->fps;
+    Arena* previous = str_use_arena(NULL);
+    STATS_SCOPE(STAT_FORMAT);
+    chunk->status = -1;
+
+    // the keyframes are in frame order; counting them per shape sorts them by shape and keeps that order.
+    uint64_t* ends = (uint64_t*)calloc(chunk->count + 1, sizeof(uint64_t));
+    uint64_t* order = (uint64_t*)malloc(a->keyframe_count * sizeof(uint64_t));
+    StrBuilder key_times = {0}, values = {0};
+    if (ends == NULL || order == NULL) {
+        DEBUG_PRINT("err! assemble_chunk(): failed to allocate memory for %lu keyframes.\n", a->keyframe_count);
+        goto done;
+    }
+    for (uint64_t k = 0; k < a->keyframe_count; k++) ends[a->keyframes[k].shape + 1]++;
+    for (uint32_t s = 0; s < chunk->count; s++) ends[s + 1] += ends[s];
+    // afterwards ends[s] is where the keyframes of shape s end.
+    for (uint64_t k = 0; k < a->keyframe_count; k++) order[ends[a->keyframes[k].shape]++] = k;
+
+    uint64_t begin = 0;
+    for (uint32_t s = 0; s < chunk->count; s++) {
+        SvgPath path = triogon_path(chunk->ctx, &a->document);
+        const uint64_t* span = a->spans + (uint64_t)3 * s;
+        if (copy_span(&a->document, &chunk->out, span[0], span[2]) != 0) goto done;
+        // the first frame has one keyframe of each.
+        if (ends[s] - begin == 2) {
+            if (svg_path_close(&path) != 0) goto done;
+            begin = ends[s];
+            continue;
+        }
+        if (svg_path_close_open(&path) != 0) goto done;
+        for (uint8_t fill = 0; fill < 2; fill++) {
+            key_times.length = values.length = 0;
+            uint32_t changes = 0;
+            for (uint64_t k = begin; k < ends[s]; k++) {
+                const Keyframe* kf = &a->keyframes[order[k]];
+                if (kf->fill != fill) continue;
+                if (changes++ != 0 && (str_builder_append(&key_times, STR_LIT(";")) != 0 || str_builder_append(&values, STR_LIT(";")) != 0)) goto done;
+                if (str_builder_append_fixed(&key_times, (double)kf->frame / params->frames, KEY_TIME_PRECISION) != 0 ||
+                    str_builder_append_n(&values, a->values.str + kf->offset, kf->length) != 0) goto done;
+            }
+            if (changes > 1 && svg_animate(&a->document, fill ? STR_LIT("fill") : STR_LIT("d"), str_builder_view(&key_times), str_builder_view(&values), seconds) != 0) goto done;
+        }
+        if (svg_path_end(&path) != 0) goto done;
+        begin = ends[s];
+    }
+    chunk->status = 0;
+
+done:
+    free(ends);
+    free(order);
+    str_builder_free(&key_times);
+    str_builder_free(&values);
+    str_use_arena(previous);
+}
+
+// Runs task on every chunk of the animation, over the pool's threads when there are several.
+// Returns 0 if it succeeded on all of them and -1 otherwise.
+static int8_t run_animated(PoolTask task, const TriogonsAnimation* animation, Pool* pool) {
+    for (uint32_t c = 0; c < animation->chunk_count; c++) {
+        if (animation->chunk_count == 1 || pool_submit(pool, task, &animation->chunks[c]) != 0) task(&animation->chunks[c]);
+    }
+    if (animation->chunk_count > 1) pool_wait(pool);
+    for (uint32_t c = 0; c < animation->chunk_count; c++) {
+        if (animation->chunks[c].chunk.status != 0) return -1;
+    }
+    return 0;
+}
+
+// Splices the shapes of the animation into the sink's chain: those of the current frame,
+// or the animated ones of an SMIL animation.
+static int8_t splice_animation(const TriogonsCtx* ctx) {
+    const TriogonsAnimation* animation = ctx->animation;
+    for (uint32_t c = 0; c < animation->chunk_count; c++) {
+        const StrBuilder* part = animation->smil ? &animation->chunks[c].document : &animation->chunks[c].chunk.out;
+        if (part->length != 0 && str_chain_append_ref(&ctx->sink->chain, str_builder_view(part)) != 0) return -1;
+    }
+    return 0;
+}
+
+static void free_animated(AnimatedChunk* a) {
+    geom_batch_free(&a->chunk.shapes);
+    free(a->chunk.colors);
+    str_builder_free(&a->chunk.out);
+    free(a->base);
+    free(a->drift);
+    free(a->keys);
+    free(a->spans);
+    free(a->previous_spans);
+    str_builder_free(&a->previous);
+    str_builder_free(&a->values);
+    free(a->keyframes);
+    str_builder_free(&a->document);
+    *a = (AnimatedChunk){0};
+}
+
+// Adds the shapes of every chunk to the raster, as transformed and with the colours the palette packs.
+static int8_t splice_triogons(Raster* r, void* arg) {
+    const TriogonsCtx* ctx = arg;
+    for (uint32_t c = 0; c < ctx->chunk_count; c++) {
+        const TriogonsChunk* chunk = &chunks[c];
+        const ShapeBatch* shapes = &chunk->shapes;
+        for (uint32_t s = 0; s < shapes->count; s++) {
+            // from the last point, as emit_outline() moves to it.
+            float x[TRIOGON_POINTS + 1], y[TRIOGON_POINTS + 1];
+            x[0] = GEOM_X(shapes, s, TRIOGON_POINTS - 1);
+            y[0] = GEOM_Y(shapes, s, TRIOGON_POINTS - 1);
+            for (uint16_t p = 0; p < TRIOGON_POINTS; p++) {
+                x[p + 1] = GEOM_X(shapes, s, p);
+                y[p + 1] = GEOM_Y(shapes, s, p);
+            }
+            const Rgba color = palette_rgba(&ctx->palette, chunk->colors[s], COLOR_PRECISION);
+            if (raster_fill_cubics(r, x, y, TRIOGON_POINTS / 3, color) != 0) return -1;
+        }
+    }
+    return 0;
+}
+
+static int8_t fill_slot(StrBuilder* out, uint16_t slot, void* ctx) {
+    TriogonsCtx* tc = ctx;
+    switch (slot) {
+        case SLOT_CANVAS_WIDTH: return str_builder_append_int(out, tc->width);
+        case SLOT_CANVAS_HEIGHT: return str_builder_append_int(out, tc->height);
+        case SLOT_THEME: return str_builder_append(out, (tc->theme == Noir) ? NOIR : LUMO);
+        case SLOT_TRIOGONS: {
+            // a bitmap of a still wallpaper is drawn from the shapes, no text is written for them.
+            if (tc->animation == NULL && !preset_sink_streams(tc->sink)) {
+                tc->direct = 1;
+                if (render_triogons(tc, tc->density, tc->pool) != 0) return -1;
+                preset_sink_splice(tc->sink, splice_triogons, tc);
+                return 0;
+            }
+            // compact paths share their fill-opacity through a group; out is the text of the chain,
+            // so the end of the group follows the shapes the chain refers to.
+            if (tc->compact && svg_group_begin(out, tc->palette.spec.alpha, COLOR_PRECISION) != 0) return -1;
+            const int8_t status = (tc->animation != NULL) ? splice_animation(tc) : render_triogons(tc, tc->density, tc->pool);
+            if (status != 0) return -1;
+            return tc->compact ? svg_group_end(out) : 0;
+        }
+    }
+    return -1;
+}
+
+// render_builtin(), calling fill_slot() for each placeholder of the built-in preset.
+#include "gen/triogons.preset.h"
+
+static void build_preset_path(void) {
+    snprintf(preset_path, sizeof(preset_path), "%s/" PRESET_FILE, preset_dir);
+}
+
+// The render only depends on params and the preset, custom or built in.
+int8_t triogons_content(const RenderParams* params, uint64_t* hash) {
+    if (preset_dir != NULL) pthread_once(&preset_path_once, build_preset_path);
+    if (preset_content_hash("triogons", (preset_dir != NULL) ? preset_path : NULL, BUILTIN_PRESET_HASH, hash) != 0) return -1;
+    if (params->accent_count == 0) return 0;
+    // the order of the accents matters, shapes pick them by index.
+    char text[128];
+    int n = snprintf(text, sizeof(text), "%016llx", (unsigned long long)*hash);
+    for (uint8_t i = 0; i < params->accent_count && n > 0 && n < (int)sizeof(text); i++) {
+        n += snprintf(text + n, sizeof(text) - n, " %08x", (unsigned)params->accents[i]);
+    }
+    if (n <= 0 || n >= (int)sizeof(text)) return -1;
+    *hash = str_hash((StrView){text, (uint64_t)n});
+    return 0;
+}
+
+// Holds the custom preset for reading, when there is one, until the documents are written.
+// Returns 0 on success and -1 on failure.
+static int8_t acquire_preset(int8_t custom) {
+    if (!custom) return 0;
+    pthread_once(&preset_path_once, build_preset_path);
+    if (template_acquire(&preset, &preset_lock, preset_path, PRESET_KEYS, sizeof(PRESET_KEYS) / sizeof(PRESET_KEYS[0])) != 0) {
         DEBUG_PRINT("Err: triogons(): error while accessing file\n");
-        return;
+        return -1;
     }
+    return 0;
+}
 
-    if (height != 0 && width != 0) {
-        CANVAS_HEIGHT = height;
-        CANVAS_WIDTH = width;
+// Sets up the render of params; the density is drawn when params leave it to the preset.
+// Returns 0 on success and -1 if the palettes cannot be built.
+static int8_t init_ctx(TriogonsCtx* ctx, const RenderParams* params) {
+    pthread_once(&palettes_once, build_palettes);
+    if (palettes_status != 0) {
+        DEBUG_PRINT("Err: triogons(): failed to build the palettes\n");
+        return -1;
     }
-    const uint8_t padding_fac = 5; // this is obtained through trial and error.
-    Point padding = {
-        (float)CANVAS_WIDTH / COMMON_DIVISOR * padding_fac,
-        (float)CANVAS_HEIGHT / COMMON_DIVISOR * padding_fac
+    const int8_t sized = params->height != 0 && params->width != 0;
+    *ctx = (TriogonsCtx){
+        .width = sized ? params->width : DEFAULT_WIDTH,
+        .height = sized ? params->height : DEFAULT_HEIGHT,
+        .theme = params->theme,
+        .pool = params->pool,
+        .compact = params->compact
     };
-    Point origin;
-    String tmp = str_compose("%d", CANVAS_HEIGHT);
-    str_replace_all(&file, str_from("$CANVAS_HEIGHT"), tmp);
-    str_free(&tmp);
-    tmp = str_compose("%d", CANVAS_WIDTH);
-    str_replace_all(&file, str_from("$CANVAS_WIDTH"), tmp);
-    str_free(&tmp);
-
-    size_t pos = str_replace_next(&file, 0, str_from("$THEME"), (theme == Noir) ? NOIR : LUMO);
-    for (uint16_t i = 0; i < DENSITY; i++) {
-        origin = rand_point(padding, (Point){CANVAS_WIDTH - padding.x, CANVAS_HEIGHT - padding.y});
-        tmp = create_triogon(origin, theme);
-        str_replace_next(&file, pos, str_from("$TRIOGONS"), str_from("$TRIOGONS\n$TRIOGONS"));
-        pos = str_replace_next(&file, pos, str_from("$TRIOGONS"), tmp);
-        str_free(&tmp);
-    }
-    str_replace_next(&file, pos, str_from("$TRIOGONS"), str_from(""));
-
-    write_to_file("out.svg", file);
-    str_free(&file);
+    ctx->padding = (Point){(float)ctx->width / COMMON_DIVISOR * PADDING, (float)ctx->height / COMMON_DIVISOR * PADDING};
+    ctx->stretch = (Point){(float)ctx->width / REFERENCE_WIDTH, (float)ctx->height / REFERENCE_HEIGHT};
+    ctx->zoom = ((float)ctx->width + ctx->height) / (REFERENCE_WIDTH + REFERENCE_HEIGHT);
+    rng_seed(&ctx->rng, params->seed);
+    ctx->density = (params->density != 0) ? params->density : DENSITY(&ctx->rng);
+    palette_accented(&ctx->palette, &palettes[ctx->theme], params->accents, params->accent_count);
+    return 0;
+}
+
+// Fills the custom preset, or the built-in one, into params->path.
+// Returns 0 on success and -1 on failure.
+static int8_t render_document(TriogonsCtx* ctx, const RenderParams* params, int8_t custom) {
+    // only the small slots are copied into the chain, the literal text stays in the
+    // mapped preset and the shapes in the chunks until they are written.
+    PresetSink sink;
+    if (preset_sink_open(&sink, params) != 0) return -1;
+    ctx->sink = &sink;
+    int8_t spliced;
+    {
+        STATS_SCOPE(STAT_SPLICE);
+        spliced = custom ? template_render_chain(&preset, &sink.chain, fill_slot, ctx) : render_builtin(&sink.chain, ctx);
+    }
+    if (spliced != 0) DEBUG_PRINT("Err: triogons(): failed to render the preset\n");
+    return preset_sink_close(&sink, params, spliced);
+}
+
+/**
+ * @brief Generates a complete SVG file with multiple triogons based on a preset template.
+ *
+ * @param params Canvas size, theme, seed, density (0 picks a random one) and the
+ *               pool to render on (NULL renders on the calling thread).
+ *               A seed always gives the same image, whatever the thread count.
+ */
+int8_t triogons(const RenderParams* params) {
+    STATS_SCOPE(STAT_RENDER);
+    TriogonsCtx ctx;
+    if (init_ctx(&ctx, params) != 0) return -1;
+    const int8_t custom = preset_dir != NULL;
+    if (acquire_preset(custom) != 0) return -1;
+
+    pthread_once(&thread_state_once, create_thread_state);
+    pthread_setspecific(thread_state, &arena);
+
+    Arena* previous = str_use_arena(&arena);
+    const int8_t status = render_document(&ctx, params, custom);
+    for (uint32_t c = 0; c < ctx.chunk_count; c++) arena_reset(&chunks[c].arena);
+    if (custom) pthread_rwlock_unlock(&preset_lock);
+    str_use_arena(previous);
+    arena_reset(&arena);
+    return status;
+}
+
+/**
+ * @brief Renders the wallpaper of params at several sizes from one geometry pass.
+ *
+ * The shapes are created once on the reference canvas, then every size is rendered
+ * from them, fitted to its canvas, the same as triogons() renders that size.
+ *
+ * @param params Theme, seed, density and pool as for triogons(); its size and path are not used.
+ * @param sizes Canvas size and output path of each render.
+ * @param count Number of sizes.
+ * @return 0 if every size was rendered, -1 otherwise.
+ */
+int8_t triogons_sizes(const RenderParams* params, const RenderSize sizes[], uint16_t count) {
+    STATS_SCOPE(STAT_RENDER);
+    TriogonsCtx ctx;
+    if (init_ctx(&ctx, params) != 0) return -1;
+    const int8_t custom = preset_dir != NULL;
+    if (acquire_preset(custom) != 0) return -1;
+    pthread_once(&thread_state_once, create_thread_state);
+    pthread_setspecific(thread_state, &arena);
+
+    // the set holds every shape at once, the renders only stream their output.
+    int8_t status = -1;
+    TriogonsChunk set = {.ctx = &ctx, .count = ctx.density};
+    {
+        STATS_SCOPE(STAT_GEOMETRY);
+        if (geom_batch_init(&set.shapes, TRIOGON_POINTS, ctx.density) != 0 || begin_placement(&ctx, ctx.density) != 0) goto done;
+        for (uint32_t i = 0; i < ctx.density; i++) {
+            Rng rng;
+            rng_stream(&ctx.rng, i, &rng);
+            if (create_triogon(&set, &rng, placement_next(&placement)) != 0) goto done;
+        }
+    }
+
+    status = 0;
+    Arena* previous = str_use_arena(&arena);
+    for (uint16_t k = 0; k < count; k++) {
+        RenderParams sized = *params;
+        sized.width = sizes[k].width;
+        sized.height = sizes[k].height;
+        sized.path = sizes[k].path;
+        TriogonsCtx fitted;
+        if (init_ctx(&fitted, &sized) != 0) {
+            status = -1;
+            continue;
+        }
+        fitted.set = &set;
+        if (render_document(&fitted, &sized, custom) != 0) status = -1;
+        for (uint32_t c = 0; c < fitted.chunk_count; c++) arena_reset(&chunks[c].arena);
+        arena_reset(&arena);
+    }
+    str_use_arena(previous);
+
+done:
+    geom_batch_free(&set.shapes);
+    free(set.colors);
+    if (custom) pthread_rwlock_unlock(&preset_lock);
+    return status;
+}
+
+/**
+ * @brief Renders an animation of drifting triogons, see presets.h.
+ *
+ * Every shape is created once, as triogons() would, and kept with its control points
+ * as created; each frame moves it, transforms it from them and formats again only
+ * its fill colour or its path data when they are written differently than before.
+ *
+ * @param params Same as for triogons(); params->path may hold ANIMATION_FRAME_KEY.
+ * @param animation Number of frames and frame rate.
+ * @param report Filled with the frames drawn, the shapes formatted again and the time taken.
+ */
+int8_t triogons_animate(const RenderParams* params, const Animation* animation, AnimationReport* report) {
+    STATS_SCOPE(STAT_RENDER);
+    *report = (AnimationReport){0};
+    if (animation->frames == 0 || animation->fps == 0) {
+        DEBUG_PRINT("Err: triogons_animate(): an animation needs frames and a frame rate\n");
+        return -1;
+    }
+    TriogonsCtx ctx;
+    if (init_ctx(&ctx, params) != 0) return -1;
+    const int8_t custom = preset_dir != NULL;
+    if (acquire_preset(custom) != 0) return -1;
+
+    // a document per frame when the path has a place for the frame number.
+    const char* key = (params->path != NULL) ? strstr(params->path, ANIMATION_FRAME_KEY) : NULL;
+    TriogonsAnimation animated = {animation, NULL, count_chunks(ctx.density, params->pool), 0, key == NULL};
+    ctx.animation = &animated;
+    int digits = 1;
+    for (uint32_t n = animation->frames - 1; n >= 10; n /= 10) digits++;
+    if (digits < FRAME_DIGITS) digits = FRAME_DIGITS;
+    char path[PATH_MAX];
+    RenderParams frame = *params;
+    frame.path = path;
+
+    pthread_once(&thread_state_once, create_thread_state);
+    pthread_setspecific(thread_state, &arena);
+    Arena* previous = str_use_arena(&arena);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int8_t status = -1;
+    animated.chunks = (AnimatedChunk*)calloc(animated.chunk_count, sizeof(AnimatedChunk));
+    if (animated.chunks == NULL || begin_placement(&ctx, ctx.density) != 0 || place_origins(ctx.density) != 0) {
+        DEBUG_PRINT("Err: triogons_animate(): failed to place %u shapes\n", ctx.density);
+        goto done;
+    }
+    // contiguous ranges, the first density % chunk_count chunks take one extra shape.
+    for (uint32_t c = 0, first = 0; c < animated.chunk_count; c++) {
+        AnimatedChunk* a = &animated.chunks[c];
+        a->animation = &animated;
+        a->chunk.ctx = &ctx;
+        a->chunk.first = first;
+        a->chunk.count = ctx.density / animated.chunk_count + (c < ctx.density % animated.chunk_count);
+        a->chunk.origins = origins + first;
+        first += a->chunk.count;
+    }
+
+    for (animated.frame = 0; animated.frame < animation->frames; animated.frame++) {
+        if (run_animated(animate_chunk, &animated, params->pool) != 0) goto done;
+        report->frames++;
+        report->shapes += ctx.density;
+        if (animated.smil) continue;
+
+        const int length = snprintf(path, sizeof(path), "%.*s%0*u%s", (int)(key - params->path), params->path,
+            digits, animated.frame, key + strlen(ANIMATION_FRAME_KEY));
+        if (length < 0 || length >= (int)sizeof(path)) {
+            DEBUG_PRINT("Err: triogons_animate(): output path too long\n");
+            goto done;
+        }
+        if (make_parents(path) != 0) goto done;
+        const int8_t written = render_document(&ctx, &frame, custom);
+        arena_reset(&arena);
+        if (written != 0) goto done;
+    }
+    if (animated.smil && (run_animated(assemble_chunk, &animated, params->pool) != 0 || render_document(&ctx, params, custom) != 0)) goto done;
+    status = 0;
+
+done:
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    report->seconds = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+    for (uint32_t c = 0; animated.chunks != NULL && c < animated.chunk_count; c++) {
+        report->reformatted += animated.chunks[c].reformatted;
+        free_animated(&animated.chunks[c]);
+    }
+    free(animated.chunks);
+    if (custom) pthread_rwlock_unlock(&preset_lock);
+    str_use_arena(previous);
+    arena_reset(&arena);
+    return status;
 }
@@ -0,0 +1,141 @@
+/*
+Build time compiler of presets: turns a .preset file into a C header that renders it
+without reading the file or searching for placeholders.
+
+    presetgen assets/triogons.preset obj/gen/triogons.preset.h
+
+Literal text becomes string literals referenced by the output chain, and every
+placeholder, a '$' followed by an identifier, becomes a direct call to the
+preset's fill_slot() with the constant SLOT_<IDENTIFIER IN UPPER CASE>, so the
+compiler can inline the fill and drop its switch. The generated header must be
+included after those constants and fill_slot() are defined. It also defines
+BUILTIN_PRESET_HASH, the str_hash() of the preset, which render caches key on.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <ctype.h>
+
+// literal text is split into one string literal per source line.
+static void emit_literal(FILE* out, const char* text, size_t length) {
+    if (length == 0) return;
+    fprintf(out, "    if (str_chain_append_ref(chain, STR_LIT(\n        \"");
+    for (size_t i = 0; i < length; i++) {
+        const unsigned char c = text[i];
+        switch (c) {
+            case '\n':
+                fputs((i + 1 < length) ? "\\n\"\n        \"" : "\\n", out);
+                break;
+            case '"': fputs("\\\"", out); break;
+            case '\\': fputs("\\\\", out); break;
+            case '?': fputs("\\?", out); break; // no trigraphs.
+            case '\t': fputs("\\t", out); break;
+            case '\r': fputs("\\r", out); break;
+            default:
+                // octal escapes end after three digits, unlike hex ones.
+                if (isprint(c)) fputc(c, out);
+                else fprintf(out, "\\%03o", c);
+        }
+    }
+    fprintf(out, "\")) != 0) return -1;\n");
+}
+
+static int is_ident(unsigned char c, int first) {
+    return isalpha(c) || c == '_' || (!first && isdigit(c));
+}
+
+// 64-bit FNV-1a, the same as str_hash() in lib/strings.c.
+static uint64_t hash_text(const char* text, size_t length) {
+    uint64_t hash = 0xcbf29ce484222325;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)text[i];
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
+
+static int generate(FILE* out, const char* name, const char* text, size_t length) {
+    fprintf(out,
+        "/*\n"
+        "Generated by tools/presetgen.c from %s, do not edit.\n"
+        "Include it after the SLOT_* constants and fill_slot() of its preset.\n"
+        "*/\n\n"
+        "// str_hash() of the built-in copy of the preset.\n"
+        "#define BUILTIN_PRESET_HASH 0x%016llxULL\n\n"
+        "// Renders the built-in copy of the preset into chain and ends it: the literal text\n"
+        "// is referenced, the placeholders are filled in document order.\n"
+        "// Returns 0 on success and -1 on failure.\n"
+        "static inline int8_t render_builtin(StrChain* chain, void* ctx) {\n",
+        name, (unsigned long long)hash_text(text, length));
+
+    size_t literal_from = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (text[i] != '$' || i + 1 >= length || !is_ident(text[i + 1], 1)) continue;
+        emit_literal(out, text + literal_from, i - literal_from);
+
+        size_t end = i + 1;
+        while (end < length && is_ident(text[end], 0)) end++;
+        fprintf(out, "    if (fill_slot(&chain->text, SLOT_");
+        for (size_t k = i + 1; k < end; k++) fputc(toupper((unsigned char)text[k]), out);
+        fprintf(out, ", ctx) != 0) return -1;\n");
+
+        literal_from = end;
+        i = end - 1;
+    }
+    emit_literal(out, text + literal_from, length - literal_from);
+    fprintf(out, "    return str_chain_end(chain);\n}\n");
+    return ferror(out) ? -1 : 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s PRESET HEADER\n", argv[0]);
+        return 1;
+    }
+
+    FILE* in = fopen(argv[1], "rb");
+    if (in == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    char* text = NULL;
+    size_t length = 0, capacity = 0, n;
+    do {
+        if (length == capacity) {
+            capacity = (capacity == 0) ? 4096 : capacity * 2;
+            char* grown = realloc(text, capacity);
+            if (grown == NULL) {
+                fprintf(stderr, "%s: out of memory\n", argv[0]);
+                free(text);
+                fclose(in);
+                return 1;
+            }
+            text = grown;
+        }
+        n = fread(text + length, 1, capacity - length, in);
+        length += n;
+    } while (n != 0);
+    const int failed_read = ferror(in);
+    fclose(in);
+    if (failed_read) {
+        perror(argv[1]);
+        free(text);
+        return 1;
+    }
+
+    FILE* out = fopen(argv[2], "w");
+    if (out == NULL) {
+        perror(argv[2]);
+        free(text);
+        return 1;
+    }
+    int status = generate(out, argv[1], text, length);
+    if (fclose(out) != 0) status = -1;
+    free(text);
+    if (status != 0) {
+        fprintf(stderr, "%s: failed to write %s\n", argv[0], argv[2]);
+        remove(argv[2]);
+        return 1;
+    }
+    return 0;
+}